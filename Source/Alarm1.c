@@ -3,33 +3,96 @@
 #include <stdio.h> 
 #include <stdbool.h> 
 #include <string.h> 
+#include <stddef.h> 
 #include <math.h> 
 #include <avr/io.h> 
 #include <avr/interrupt.h> 
 #include <avr/eeprom.h> 
 #include <avr/portpins.h> 
 #include <avr/pgmspace.h> 
+#include <util/crc16.h> 
+
+#ifndef APP_COROUTINES
+#define APP_COROUTINES 0 // 1 runs four of the polling tasks as co-routines
+#endif
+
+#if APP_COROUTINES
+/* The co-routines share the idle task's stack, which frees four task stacks
+   and TCBs in the heap (about 370 bytes, see the co-routine section below).
+   Some of it goes on a bigger link receive ring and a screen buffer that
+   only sends the characters that changed. */
+#define LINK_RX_SIZE 256
+#define LCD_BUFFERED 1
+#endif
 #include "lcd.h"
 #include "ds3231.h"
 #include "i2c_master.h"
 #include "usart_ATmega1284.h"
+#include "link.h"
+#include "telemetry.h"
+#include "linkmon.h"
+#include "bus.h"
+#include "fsm.h"
  
 //FreeRTOS include files 
 #include "FreeRTOS.h" 
 #include "task.h" 
+#include "queue.h"
 #include "croutine.h" 
+#include "timers.h"
+#include "events.h"
+#include "clockstate.h"
+#include "alarm.h"
+#include "settings.h"
+#include "snooze.h"
+#include "i2cbus.h"
+#include "rtcalarm.h"
+#include "temperature.h"
+#include "periodic.h"
+#include "stacks.h"
+#include "runstats.h"
+#include "trace.h"
+#include "console.h"
+
+#ifndef APP_EVENTS
+#define APP_EVENTS 1 // 0 runs the original fixed-period polling tasks
+#endif
+
+#ifndef APP_SYNC_SM
+#define APP_SYNC_SM 0 // 1 runs the polling core's state machines from one task
+#endif
+
+#if APP_EVENTS && (APP_COROUTINES || APP_SYNC_SM)
+#error "APP_COROUTINES and APP_SYNC_SM replace tasks of the polling core, build with APP_EVENTS=0"
+#endif
+#if APP_COROUTINES && APP_SYNC_SM
+#error "Pick one of APP_COROUTINES and APP_SYNC_SM"
+#endif
+
+#if APP_EVENTS
+/* Buttons pressed in the event being handled (see UI_Run) */
+unsigned char uiPressed = 0;
+#define LEFT (uiPressed & 0x04) // Button 1 - SA
+#define RIGHT (uiPressed & 0x08) // Button 2 - cancel
+#define UP (uiPressed & 0x10) // Button 3  - SA minute / snooze
+#define DOWN (uiPressed & 0x20) // Button 4 - hourMode / SA hour 
+#else
 
 #define LEFT (!(PINA & 0x04)) // Button 1 - SA
 #define RIGHT (!(PINA & 0x08)) // Button 2 - cancel
-#define UP (!(PINA & 0x10)) // Button 3  - SA minute
+#define UP (!(PINA & 0x10)) // Button 3  - SA minute / snooze
 #define DOWN (!(PINA & 0x20)) // Button 4 - hourMode / SA hour 
+#endif
 
-enum DisplayTimeState {DTInit, DTDisplay, DTIdle, DTWaitHrB, DTHrSwap, DTToST, DTToSA} displayTime_state;
-enum SetAlarmState {SAInit, SAIdle, SASetAla, SADisplay, SAHrInc, SAMinInc, SASaveAla, SAToDT} setAlarm_state;
-enum SetTimeState {STInit, STIdle, STSetTime, STDisplay, STHrInc, STMinInc, STSaveTime, STToDT} setTime_state;
-enum LEDPWMState {LPInit, LPOff, LPOn, LPReset} LEDPWM_state;
-enum AlarmOnState {AOInit, AOCheck, AOSendFlag, AOWaitSignal, AOReset} alarmOn_state;
-enum SpeakerOnState {SInit, SOff, SOn, SReset} speakerOn_state;
+enum DisplayTimeState {DTInit, DTDisplay, DTIdle, DTWaitHrB, DTHrSwap, DTToST, DTToSA, DTSnooze, DTStates};
+enum SetAlarmState {SAInit, SAIdle, SASetAla, SADisplay, SAHrInc, SAMinInc, SASaveAla, SAToDT, SAStates};
+enum SetTimeState {STInit, STIdle, STSetTime, STDisplay, STHrInc, STMinInc, STSaveTime, STToDT, STStates};
+enum LEDPWMState {LPInit, LPOff, LPOn, LPReset, LPSnooze, LPStates};
+enum AlarmOnState {AOInit, AOCheck, AOSendFlag, AOWaitSignal, AOReset, AOSnooze, AOResume, AOStates};
+enum SpeakerOnState {SInit, SOff, SOn, SReset, SSnooze, SStates};
+
+/* States of the machines above, stepped by FSM_Tick (fsm.h) */
+unsigned char displayTime_state, setAlarm_state, setTime_state, LEDPWM_state, alarmOn_state, speakerOn_state;
 
 /* 0x01 DTAdmin 
    0x02 SAAdmin 
@@ -37,32 +100,34 @@ enum SpeakerOnState {SInit, SOff, SOn, SReset} speakerOn_state;
 */
 unsigned char Admin = 0x01; 
 
-unsigned char hourMode = 0; // 0 is 12 hour mode | 1 is 24 hour mode
-uint8_t ampm; // 1 is PM | 0 is AM
-
-/* DS3231 variables */
+/* DS3231 variables. The time and the set alarm the machines go by are in
+   clockState (clockstate.h). */
 uint8_t hr, min, sec, year, mnth, day, dt;
-uint8_t hrdec, mindec, secdec, yeardec, mnthdec, daydec, dtdec;
-
-// The set alarm
-uint8_t alarmSetHour = 0x0F;   
-uint8_t alarmSetMin = 0x0F; 
-unsigned char alarmSetAMPM = 0; 
-unsigned char alarmIsSet = 0; // display on main time time until alarm
+uint8_t yeardec, mnthdec, daydec, dtdec;
 
+/* Alarm and time being set, hour 0-23 */
 uint8_t alarmHour = 12;
 uint8_t alarmMin = 0;
-unsigned char alarmAMPM = 1;
 
 uint8_t timeHour = 12;
 uint8_t timeMin	= 0;
-unsigned timeAMPM = 1;
 
 unsigned char minTimer = 0; // Refreshes display every 60s
+#define DT_REFRESH 5 // DisplayTime ticks between redraws
 
 unsigned char alarmOnFlag = 0; // If flag == 1, the alarm is on
-unsigned int alarmCheck; // Convert alarm setting to minutes for easier alarm checking
-unsigned int hourSum; // Convert current time to minutes to check against alarm
+unsigned char alarmOffSignal = 0; // Set when every sleeper has reported being up
+
+/* FSR telemetry from the sensors, kept per node in busNodes[] for tuning
+   the press threshold */
+#ifndef FSR_FORWARD
+#define FSR_FORWARD 0 // 1 forwards every sample to USART1 as text
+#endif
+#ifndef FSR_BATCH
+#define FSR_BATCH 32 // most samples a frame carries, as on the sensor
+#endif
+struct LinkFrame linkFrame;
+uint16_t fsrSamples[FSR_BATCH];
 /*
 const double G = 392;
 const double A = 440;
@@ -73,6 +138,7 @@ const double C = 261.63;
 */
 
 int i = 0; // song counter
+unsigned char alarmMelody; // of the alarm that rang
 double alarmSong[40] = {392, 440, 392, 349.23, 
 						329.63, 349.23, 392, 392, 
 						293.67, 329.63, 349.23, 349.23, 
@@ -81,27 +147,145 @@ double alarmSong[40] = {392, 440, 392, 349.23,
 						329.63, 349.23, 392, 392,
 						293.67, 293.67, 392, 392,
 						329.63, 261.63, 261.63, 261.63};
+double alarmBeep[4] = {880, 0, 880, 0};
+
+/* Melodies an alarm can play (struct Alarm melody) */
+struct Melody {
+	const double *notes;
+	unsigned char length;
+};
+
+const struct Melody alarmMelodies[] = {{alarmSong, 40}, {alarmBeep, 4}};
+#define ALARM_MELODIES (sizeof(alarmMelodies) / sizeof(alarmMelodies[0]))
+
+static struct I2CClient i2cTime, i2cSetTime;
 
 void UpdateTime() {
 	
+	struct ClockState *c;
+	unsigned int next;
+	if(!I2CBus_Acquire(&i2cTime)) {
+		return; // keep the last time, the next pass reads it again
+	}
 	/* Time variables */
 	ds3231_get(&hr,&min,&sec,&year,&mnth,&dt,&day);
-	if(hourMode == 0) { // 12 hour
-		ampm = hr;
-		ampm &= 0x20; // ampm bit
-		ampm = (ampm>>5);
-		hrdec = bcd2dec(hr & 0x1F);
+	if(hr & 0x40) { // Alarm 1 holds 24 hours and the chip only matches the same layout
+		ds3231_setHr(1, hr);
+	}
+	I2CBus_Release(&i2cTime);
+	c = ClockState_Begin();
+	if(hr & 0x40) { // 12 hour register, as the DS3231 was left by older builds
+		c->hour = Clock_Hour24(bcd2dec(hr & 0x1F), (hr & 0x20) >> 5);
 	}
-	else if(hourMode == 1) { // 24 hour
-		hrdec = bcd2dec(hr & 0x3F);
+	else { // 24 hour
+		c->hour = bcd2dec(hr & 0x3F);
 	}
-	secdec = bcd2dec(sec);
-	mindec = bcd2dec(min);
+	c->second = bcd2dec(sec);
+	c->minute = bcd2dec(min);
+	c->weekday = (day >= 1 && day <= 7) ? day - 1 : 0; // DS3231 counts 1-7 from Sunday
+	Alarm_Update(c);
+	next = c->alarmNext;
+	ClockState_End();
+	RtcAlarm_Sync(next);
 	yeardec = bcd2dec(year);
 	mnthdec = bcd2dec(mnth);
 	dtdec = bcd2dec(dt);
 }
 
+void FSR_Record(struct BusNode *node, const struct LinkFrame *frame) {
+	
+	unsigned char count = Telemetry_Decode(frame->payload, frame->len, fsrSamples, FSR_BATCH);
+	unsigned char n;
+	if(!count) {
+		return;
+	}
+	if(node->fsrFrames) {
+		node->fsrMissed += (unsigned char)(frame->payload[0] - node->fsrSeq - 1);
+	}
+	node->fsrSeq = frame->payload[0];
+	node->fsrFrames++;
+	for(n = 0; n < count; n++) {
+		if(fsrSamples[n] < node->fsrMin) {
+			node->fsrMin = fsrSamples[n];
+		}
+		if(fsrSamples[n] > node->fsrMax) {
+			node->fsrMax = fsrSamples[n];
+		}
+#if FSR_FORWARD
+		char line[12];
+		snprintf(line, sizeof(line), "%u %u\n", frame->addr, fsrSamples[n]);
+		for(char *c = line; *c; c++) {
+			USART_Send(*c, 1);
+		}
+#endif
+	}
+	node->fsrLast = fsrSamples[count - 1];
+}
+
+// Snoozes the alarm from the UP button or a short press on a bed sensor,
+// only while it sounds
+static void App_Snooze() {
+	
+	if(speakerOn_state == SOn) {
+		Snooze_Start();
+	}
+}
+
+// Drains frames received from the sensors
+void Link_Service() {
+	
+	struct BusNode *node;
+	while(Link_Poll(&linkFrame)) {
+		node = Bus_Route(&linkFrame);
+		switch(linkFrame.type) {
+			case LINK_ALARM_OFF:
+				if(node && node->alarm == BARinging) {
+					node->alarm = BAUp;
+				}
+				if(!Bus_Ringing()) { // Last one out of bed
+					alarmOffSignal = 1;
+					Event_Post(EV_SLEEPER_UP, 0);
+				}
+			break;
+			case LINK_SNOOZE:
+				if(node && node->alarm == BARinging) {
+					App_Snooze();
+				}
+			break;
+			case LINK_FSR_FRAME:
+				if(node) {
+					FSR_Record(node, &linkFrame);
+				}
+			break;
+			case LINK_PONG:
+				LinkMon_Pong(linkFrame.payload, linkFrame.len);
+			break;
+			default:
+			break;
+		}
+	}
+}
+
+void Link_Tick() {
+	
+	static unsigned char linkShown;
+	Link_Service();
+	Bus_Tick();
+#if !LINK_BUS
+	LinkMon_Tick(); // On the bus the polls double as the heartbeat
+#endif
+	if(linkDegraded != linkShown) {
+		linkShown = linkDegraded;
+		Event_Post(EV_RENDER, 0);
+	}
+#if configGENERATE_RUN_TIME_STATS == 1
+	RunStats_Tick();
+#endif
+#if CONSOLE_USART
+	Console_Tick(); // The USART1 console rides on the link poll
+#endif
+}
+
 void set_PWM(double frequency) {
 	
 	// Keeps track of the currently set frequency
@@ -132,6 +316,9 @@ void DisplayTime_Init(){
 	
 	displayTime_state = DTInit;
 	Admin = 0x01; // Start as admin
+	I2CBus_Client(&i2cTime, "UpdateTime");
+	I2CBus_Client(&i2cRtcAlarm, "RtcAlarm");
+	I2CBus_Client(&i2cTemp, "Temp");
 	
 }
 
@@ -144,6 +331,7 @@ void SetAlarm_Init() {
 void SetTime_Init() {
 	
 	setTime_state = STInit;
+	I2CBus_Client(&i2cSetTime, "SetTime");
 }
 
 void LEDPWM_Init() {
@@ -170,812 +358,1074 @@ void SpeakerOn_Init() {
 	set_PWM(392);
 }
 
+/* Guards shared by the state machines */
+static unsigned char Only_Left() {
+	
+	return LEFT && !(RIGHT || UP || DOWN);
+}
+
+static unsigned char Only_Right() {
+	
+	return RIGHT && !(LEFT || UP || DOWN);
+}
+
+static unsigned char Only_Up() {
+	
+	return UP && !(LEFT || RIGHT || DOWN);
+}
+
+static unsigned char Only_Down() {
+	
+	return DOWN && !(LEFT || RIGHT || UP);
+}
+
+static unsigned char Down_Released() {
+	
+	return !DOWN;
+}
+
+static unsigned char DT_HasAdmin() { // Admin has been returned to DT
+	
+	return Admin == 0x01;
+}
+
+static unsigned char SA_HasAdmin() { // and the button that gave it is up
+	
+	return Admin == 0x02 && !LEFT;
+}
+
+static unsigned char ST_HasAdmin() {
+	
+	return Admin == 0x04 && !DOWN;
+}
+
+static unsigned char DT_Refresh() { // Refresh the display after 1 second
+	
+	return minTimer >= DT_REFRESH;
+}
+
+static unsigned char Alarm_On() {
+	
+	return alarmOnFlag;
+}
+
+static unsigned char Alarm_Off() {
+	
+	return !alarmOnFlag;
+}
+
+static unsigned char Alarm_Near() { // Turn "on" alarm its lead before
+	
+	struct ClockState now;
+	ClockState_Read(&now);
+	return Alarm_Left(&now) <= now.alarmLead;
+}
+
+static unsigned char Alarm_Time() { // Turn "on" alarm on alarm time
+	
+	struct ClockState now;
+	ClockState_Read(&now);
+	return Alarm_Left(&now) == 0;
+}
+
+static unsigned char Flag_Sent() {
+	
+	return USART_HasTransmitted(0);
+}
+
+static unsigned char Sleeper_Up() {
+	
+	return alarmOffSignal;
+}
+
+static unsigned char Snooze_Over() {
+	
+	return !Snooze_Active();
+}
+
+enum AppGuard {GOnlyLeft, GOnlyRight, GOnlyUp, GOnlyDown, GDownReleased, GDTHasAdmin, GSAHasAdmin,
+	GSTHasAdmin, GDTRefresh, GAlarmOn, GAlarmOff, GAlarmNear, GAlarmTime, GFlagSent, GSleeperUp,
+	GSnoozed, GSnoozeOver, GGuards};
+
+static const FSMGuard appGuards[] PROGMEM = {
+	Only_Left, Only_Right, Only_Up, Only_Down, Down_Released, DT_HasAdmin, SA_HasAdmin,
+	ST_HasAdmin, DT_Refresh, Alarm_On, Alarm_Off, Alarm_Near, Alarm_Time, Flag_Sent, Sleeper_Up,
+	Snooze_Active, Snooze_Over,
+};
+
+#ifdef HOST_SIM
+static const char *const appGuardNames[GGuards] = {
+	"LEFT", "RIGHT", "UP", "DOWN", "!DOWN", "DT admin", "SA admin",
+	"ST admin", "refresh", "alarm on", "alarm off", "alarm near", "alarm time", "flag sent", "sleeper up",
+	"snoozed", "snooze over",
+};
+#define APP_FSM_NAMES(name, states) , name, states, appGuardNames, GGuards
+#else
+#define APP_FSM_NAMES(name, states)
+#endif
+
+/* Actions shared by the state machines */
+static void Redraw_Count() {
+	
+	minTimer++;
+}
+
+// Shows hour:minute at column, with AM or PM after it in 12 hour mode
+static void Time_Display(unsigned char column, uint8_t hour, uint8_t minute, unsigned char hourMode) {
+	
+	unsigned char pm;
+	hour = Clock_ShowHour(hour, hourMode, &pm);
+	SLCD_WriteData(column, (hour / 10) + '0');
+	SLCD_WriteData(column + 1, (hour % 10) + '0');
+	SLCD_WriteData(column + 2, ':');
+	SLCD_WriteData(column + 3, (minute / 10) + '0');
+	SLCD_WriteData(column + 4, (minute % 10) + '0');
+	if(hourMode == 0) {
+		LCD_DisplayString(column + 5, pm ? "PM" : "AM");
+	}
+}
+
+// Shows an hour and minute being set under title
+static void Setting_Display(char *title, uint8_t hour, uint8_t minute) {
+	
+	eventStats.redraws++;
+	LCD_ClearScreen();
+	LCD_DisplayString(1, title);
+	Time_Display(17, hour, minute, ClockState_HourMode());
+}
+
+static void Hour_Inc(uint8_t *hour) {
+	
+	(*hour)++;
+	if(*hour >= 24) {
+		*hour = 0;
+	}
+}
+
+static void Min_Inc(uint8_t *minute) {
+	
+	(*minute)++;
+	if(*minute >= 60) {
+		*minute = 0;
+	}
+}
+
 /* Display the current time, day, and date
-   Can switch between 12 hour and 24 hour mode 
+   Can switch between 12 hour and 24 hour mode
    Can give admin to the set alarm state and set time state  */
-void DisplayTime_Tick() {
+static void DT_Display() {
 	
-	// Transitions
-	switch(displayTime_state) {
-		
-		case DTInit:
-			displayTime_state = DTDisplay; 
+	struct ClockState now;
+	uint8_t hour;
+	unsigned char pm;
+	int16_t temp;
+	char tempText[TEMP_TEXT];
+	minTimer = 0; // Reset the minute timer
+	eventStats.redraws++;
+	UpdateTime();
+	Temp_Poll();
+	ClockState_Read(&now);
+	LCD_ClearScreen();
+	hour = Clock_ShowHour(now.hour, now.hourMode, &pm);
+	SLCD_WriteData(1,(hour / 10) + '0'); // Display time
+	SLCD_WriteData(2, (hour % 10) + '0');
+	SLCD_WriteData(3, ':');
+	SLCD_WriteData(4, (now.minute / 10) + '0');
+	SLCD_WriteData(5, (now.minute % 10) + '0');
+	SLCD_WriteData(6, ':');
+	SLCD_WriteData(7, (now.second / 10) + '0');
+	SLCD_WriteData(8, (now.second % 10) + '0');
+	if(now.hourMode == 0) {
+		LCD_DisplayString(9, pm ? "PM" : "AM");
+	}
+	if(linkDegraded) { // Sensor link is missing heartbeats
+		LCD_DisplayString(12, "LINK!");
+	}
+	else if((temp = Temp_Get()) != TEMP_NONE) {
+		Temp_Format(temp, tempText);
+		LCD_DisplayString(11, tempText);
+	}
+	if(now.alarmMinute != ALARM_NONE) {
+		LCD_DisplayString(17, "Alarm ");
+		Time_Display(23, now.alarmMinute / 60, now.alarmMinute % 60, now.hourMode);
+	}
+	/* DISPLAY DATE FUNCTIONALITY
+	SLCD_WriteData(17, (mnthdec / 10) + '0');
+	SLCD_WriteData(18, (mnthdec % 10) + '0');
+	SLCD_WriteData(19, '/');
+	SLCD_WriteData(20, (dtdec / 10) + '0');
+	SLCD_WriteData(21, (dtdec % 10) + '0');
+	LCD_DisplayString(22, "/20");
+	SLCD_WriteData(25, (yeardec / 10) + '0');
+	SLCD_WriteData(26, (yeardec % 10) + '0');
+	switch(day) {
+		case 1:
+			LCD_DisplayString(28, "SUN");
 		break;
-		
-		case DTDisplay:
-			displayTime_state = DTIdle;
+		case 2:
+			LCD_DisplayString(28, "MON");
 		break;
-		
-		case DTIdle:
-			if(LEFT && !(RIGHT || UP || DOWN)) { // Admin to SA
-				displayTime_state = DTToSA;
-			}
-			else if(DOWN && !(LEFT || RIGHT || UP)) { // change hour mode
-				displayTime_state = DTWaitHrB;
-			}
-			else if(RIGHT && !(LEFT || UP || DOWN)) { // Admin to ST
-				displayTime_state = DTToST;
-			}
-			else if(minTimer >= 5) { // Refresh the display after 1 second
-				displayTime_state = DTDisplay; 
-			}
-			else { // Do nothing
-				displayTime_state = DTIdle;
-			}
+		case 3:
+			LCD_DisplayString(28, "TUE");
 		break;
-		
-		case DTWaitHrB:
-			if(DOWN) {
-				displayTime_state = DTWaitHrB;
-			}
-			else {
-				displayTime_state = DTHrSwap;
-			}
+		case 4:
+			LCD_DisplayString(28, "WED");
 		break;
-		
-		case DTHrSwap:
-			displayTime_state = DTIdle;
+		case 5:
+			LCD_DisplayString(28, "THU");
 		break;
-		
-		case DTToST: 
-			if(Admin == 0x01) { // If admin has been returned from ST
-				displayTime_state = DTDisplay;
-			}
-			else {
-				displayTime_state = DTToST;
-			}
+		case 6:
+			LCD_DisplayString(28, "FRI");
 		break;
-		
-		case DTToSA:
-			if(Admin == 0x01) { // If admin has been returned from SA
-				displayTime_state = DTDisplay;
-			}
-			else {
-				displayTime_state = DTToSA;
-			}
+		case 7:
+			LCD_DisplayString(28, "SAT");
 		break;
-		
 		default:
-			displayTime_state = DTInit;
+			LCD_DisplayString(28, "broke");
 		break;
 	}
+	*/
+}
+
+static void DT_HrSwap() { // Change the hour mode, only how hours are shown
 	
-	// Actions
-	switch(displayTime_state) {
-		
-		case DTInit:
-		break;
-		
-		case DTDisplay:
-			minTimer = 0; // Reset the minute timer
-			UpdateTime();
-			LCD_ClearScreen();
-			SLCD_WriteData(1,(hrdec / 10) + '0'); // Display time
-			SLCD_WriteData(2, (hrdec % 10) + '0');
-			SLCD_WriteData(3, ':');
-			SLCD_WriteData(4, (mindec / 10) + '0'); 
-			SLCD_WriteData(5, (mindec % 10) + '0'); 
-			SLCD_WriteData(6, ':');
-			SLCD_WriteData(7, (secdec / 10) + '0');
-			SLCD_WriteData(8, (secdec % 10) + '0');
-			if((hourMode == 0) && (ampm == 1)) {
-				LCD_DisplayString(9, "PM");
-			}
-			else if((hourMode == 0) && (ampm == 0)){
-				LCD_DisplayString(9, "AM");
-			}
-			if(alarmIsSet) {
-				LCD_DisplayString(17, "Alarm ");
-				if(hourMode == 0) {
-					if(alarmSetHour >= 13) {
-						SLCD_WriteData(23, ((alarmSetHour - 12) / 10) + '0');
-						SLCD_WriteData(24, ((alarmSetHour - 12) % 10) + '0');
-					}
-					else {
-						SLCD_WriteData(23, (alarmSetHour / 10) + '0');
-						SLCD_WriteData(24, (alarmSetHour % 10) + '0');
-					}
-					SLCD_WriteData(25, ':');
-					SLCD_WriteData(26, (alarmSetMin / 10) + '0');
-					SLCD_WriteData(27, (alarmSetMin % 10) + '0');
-					if(alarmSetAMPM) {
-						LCD_DisplayString(28, "PM");
-					}
-					else {
-						LCD_DisplayString(28, "AM");
-					}
-				}
-				else {
-					if(alarmSetAMPM) {
-						SLCD_WriteData(23, ((alarmSetHour + 12) / 10) + '0');
-						SLCD_WriteData(24, ((alarmSetHour + 12) % 10) + '0');					
-					}
-					else {
-						SLCD_WriteData(23, (alarmSetHour / 10) + '0');
-						SLCD_WriteData(24, (alarmSetHour % 10) + '0');						
-					}
-
-					SLCD_WriteData(25, ':');
-					SLCD_WriteData(26, (alarmSetMin / 10) + '0');
-					SLCD_WriteData(27, (alarmSetMin % 10) + '0');					
-				}
-			}
-			/* DISPLAY DATE FUNCTIONALITY
-			SLCD_WriteData(17, (mnthdec / 10) + '0');
-			SLCD_WriteData(18, (mnthdec % 10) + '0'); 
-			SLCD_WriteData(19, '/');
-			SLCD_WriteData(20, (dtdec / 10) + '0');
-			SLCD_WriteData(21, (dtdec % 10) + '0');
-			LCD_DisplayString(22, "/20");
-			SLCD_WriteData(25, (yeardec / 10) + '0');
-			SLCD_WriteData(26, (yeardec % 10) + '0');
-			switch(day) {
-				case 1:
-					LCD_DisplayString(28, "SUN");
-				break;
-				case 2:
-					LCD_DisplayString(28, "MON");
-				break;
-				case 3:
-					LCD_DisplayString(28, "TUE");
-				break;
-				case 4:
-					LCD_DisplayString(28, "WED");
-				break;
-				case 5:
-					LCD_DisplayString(28, "THU");
-				break;
-				case 6:
-					LCD_DisplayString(28, "FRI");
-				break;
-				case 7:
-					LCD_DisplayString(28, "SAT");
-				break;
-				default:
-					LCD_DisplayString(28, "broke");
-				break;
-			}
-			*/			
-		break;
-		
-		case DTIdle: // Wait for a button press
-			minTimer++;
-		break;
-		
-		case DTWaitHrB:
-			minTimer++;
-		break;
-		
-		case DTHrSwap: // Change the hour mode
-			minTimer++;
-			if(hourMode == 0) { // 12 to 24
-				hourMode = 1;
-				ds3231_setHr(hourMode, hr);
-				if(alarmSetHour > 12) {
-					alarmSetHour -= 12;
-				}
-			}
-			else if(hourMode == 1) { 
-				hourMode = 0;
-				ds3231_setHr(hourMode, hr);
-				if(alarmSetAMPM) {
-					alarmSetHour += 12;
-				}
-			}
-		break;	
-				
-		case DTToST: // Give admin to ST
-			if(Admin == 0x01) {
-				Admin = 0x04;
-			}
-			minTimer++;
-		break;
-		
-		case DTToSA: // Give admin to SA
-			if(Admin == 0x01) {
-				Admin = 0x02;
-			}
-			minTimer++;
-		break;
-		
-		default:
-			Admin = 0x01;
-		break;
-	}
-		
+	struct ClockState *c;
+	minTimer++;
+	c = ClockState_Begin();
+	c->hourMode = !c->hourMode;
+	ClockState_End();
+	Settings_Changed();
 }
 
-/* Display an alarm to be set
-   Button 1 - Set Alarm displayed
-   Button 2 - Cancel
-   Button 3 - Increase minute
-   Button 4 - Increase hour
-*/
-void SetAlarm_Tick() {
+static void DT_ToST() { // Give admin to ST
 	
-	// Transitions
-	switch(setAlarm_state) {
-		
-		case SAInit:
-			setAlarm_state = SAIdle;
-		break;
-		
-		case SAIdle: // Wait for admin
-			if(Admin != 0x02) {
-				setAlarm_state = SAIdle;
-			}
-			else if(Admin == 0x02 && !LEFT)	{ // Button unpressed
-				setAlarm_state = SADisplay;
-			}
-		break;
-		
-		case SADisplay: // Output current alarm setting time
-			setAlarm_state = SASetAla;
-		break;
-		
-		case SASetAla: // Wait for button inputs
-			if(LEFT && !(RIGHT || UP || DOWN)) { // Save alarm
-				setAlarm_state = SASaveAla;
-			}
-			else if(RIGHT && !(LEFT || UP || DOWN)) { // Cancel alarm
-				setAlarm_state = SAToDT;
-			}
-			else if(UP && !(LEFT || RIGHT || DOWN)) { // Increase minutes
-				setAlarm_state = SAMinInc;
-			}
-			else if(DOWN && !(LEFT || RIGHT || UP)) { // Increase hours
-				setAlarm_state = SAHrInc;
-			}
-		break;
-		
-		case SASaveAla: // Save alarm
-			setAlarm_state = SAToDT;
-		break;
-		
-		case SAToDT: // Return admin to DT
-			setAlarm_state = SAIdle;
-		break;
-		
-		case SAMinInc: // Inc minutes
-			setAlarm_state = SADisplay;
-		break;
-		
-		case SAHrInc: // Inc hours
-			setAlarm_state = SADisplay;
-		break;
-		
-		default:
-			setAlarm_state = SAInit;
-		break;
+	if(Admin == 0x01) {
+		Admin = 0x04;
 	}
+	minTimer++;
+}
+
+static void DT_ToSA() { // Give admin to SA
 	
-	// Actions
-	switch(setAlarm_state) {
-		
-		case SAInit:
-		break;
-		
-		case SAIdle: // Waiting for admin
-		break;
-		
-		case SADisplay: // Display current alarm setting
-			LCD_ClearScreen();
-			LCD_DisplayString(1, "Set Alarm");
-			if(hourMode == 0 && alarmHour >= 13) {
-				SLCD_WriteData(17,((alarmHour - 12) / 10) + '0'); // Display time
-				SLCD_WriteData(18, ((alarmHour - 12) % 10) + '0');				
-			}
-			else {
-				SLCD_WriteData(17,(alarmHour / 10) + '0'); // Display time
-				SLCD_WriteData(18, (alarmHour % 10) + '0');				
-			}
-			SLCD_WriteData(19, ':');
-			SLCD_WriteData(20, (alarmMin / 10) + '0'); 
-			SLCD_WriteData(21, (alarmMin % 10) + '0'); 
-			if((hourMode == 0) && (alarmAMPM == 1)) {
-				LCD_DisplayString(22, "PM");
-			}
-			else if((hourMode == 0) && (alarmAMPM == 0)){
-				LCD_DisplayString(22, "AM");
-			}			
-		break;
-		
-		case SASetAla: // Wait for input
-		break;
-		
-		case SAHrInc: // Inc hours
-			alarmHour++;
-			if(hourMode == 0) { // 12 hour mode settings
-				if(alarmHour > 24) {
-					alarmHour = 1;
-				}
-				if(alarmHour >= 12 && alarmHour < 24) {
-					alarmAMPM = 1;
-				}
-				else {
-					alarmAMPM = 0;
-				}
-				
-			}
-			else if(hourMode == 1 && alarmHour >= 24) { // 24 hour mode settings
-				alarmHour = 0;
-			}
-		break;
-		
-		case SAMinInc: // Inc mins
-			alarmMin++;
-			if(alarmMin >= 60) {
-				alarmMin = 0;
-			}
-		break;
-		
-		case SASaveAla:
-			alarmSetHour = alarmHour;
-			alarmSetMin = alarmMin;
-			alarmSetAMPM = alarmAMPM;
-			alarmIsSet = 1;
-		break;
-		
-		case SAToDT:
-			alarmHour = 12; // Reset Set Alarm variables
-			alarmMin = 0;
-			alarmAMPM = 1;
-			if(Admin == 0x02) {
-				Admin = 0x01;
-			}
-		break;
-		
-		default:
-		break;
+	if(Admin == 0x01) {
+		Admin = 0x02;
 	}
+	minTimer++;
 }
 
-/* Display a time to be set
-   Button 1 - Set Time displayed
+static void DT_Snooze() {
+	
+	App_Snooze();
+	minTimer++;
+}
+
+static const struct FSMTransition displayTimeTransitions[] PROGMEM = {
+	{DTInit, FSM_ALWAYS, DTDisplay},
+	{DTDisplay, FSM_ALWAYS, DTIdle},
+	{DTIdle, GOnlyLeft, DTToSA}, // Admin to SA
+	{DTIdle, GOnlyDown, DTWaitHrB}, // change hour mode
+	{DTIdle, GOnlyRight, DTToST}, // Admin to ST
+	{DTIdle, GOnlyUp, DTSnooze},
+	{DTIdle, GDTRefresh, DTDisplay},
+	{DTWaitHrB, GDownReleased, DTHrSwap},
+	{DTHrSwap, FSM_ALWAYS, DTIdle},
+	{DTToST, GDTHasAdmin, DTDisplay},
+	{DTToSA, GDTHasAdmin, DTDisplay},
+	{DTSnooze, FSM_ALWAYS, DTIdle},
+	FSM_END_ROW,
+};
+
+static const unsigned char displayTimeFirst[DTStates] PROGMEM = {0, 1, 2, 7, 8, 9, 10, 11};
+
+static const FSMAction displayTimeActions[DTStates] PROGMEM = {
+	0, DT_Display, Redraw_Count, Redraw_Count, DT_HrSwap, DT_ToST, DT_ToSA, DT_Snooze,
+};
+
+#ifdef HOST_SIM
+static const char *const displayTimeNames[DTStates] = {
+	"DTInit", "DTDisplay", "DTIdle", "DTWaitHrB", "DTHrSwap", "DTToST", "DTToSA", "DTSnooze",
+};
+#endif
+
+const struct FSM displayTimeFSM PROGMEM = {
+	displayTimeTransitions, displayTimeFirst, displayTimeActions, appGuards, DTStates
+	APP_FSM_NAMES("DisplayTime", displayTimeNames)
+};
+
+void DisplayTime_Tick() {
+	
+	FSM_Tick(&displayTimeFSM, &displayTime_state);
+	LCD_Flush();
+}
+
+/* Display an alarm to be set
+   Button 1 - Set Alarm displayed
    Button 2 - Cancel
    Button 3 - Increase minute
    Button 4 - Increase hour
 */
-void SetTime_Tick() {
+static void SA_Display() { // Display current alarm setting
 	
-// Transitions
-	switch(setTime_state) {
+	Setting_Display("Set Alarm", alarmHour, alarmMin);
+}
+
+static void SA_HrInc() {
 	
-		case STInit:
-			setTime_state = STIdle;
-		break;
+	Hour_Inc(&alarmHour);
+}
+
+static void SA_MinInc() {
 	
-		case STIdle: // Wait for admin
-			if(Admin != 0x04) {
-				setTime_state = STIdle;
-			}
-			else if(Admin == 0x04 && !DOWN)	{ // Button unpressed
-			setTime_state = STDisplay;
-			}
-		break;
+	Min_Inc(&alarmMin);
+}
+
+static void SA_Save() {
 	
-		case STDisplay: // Output current time setting time
-			setTime_state = STSetTime;
-		break;
+	Alarm_Set(0, alarmHour * 60U + alarmMin, ALARM_ONCE, ALARM_NEAR, 0, 0); // The buttons set alarm 0, for everyone
+	Settings_Changed();
+}
+
+static void SA_ToDT() {
 	
-		case STSetTime: // Wait for button inputs
-			if(LEFT && !(RIGHT || UP || DOWN)) { // Save time
-				setTime_state = STSaveTime;
-			}
-			else if(RIGHT && !(LEFT || UP || DOWN)) { // Cancel time
-				setTime_state = STToDT;
-			}
-			else if(UP && !(LEFT || RIGHT || DOWN)) { // Increase minutes
-				setTime_state = STMinInc;
-			}
-			else if(DOWN && !(LEFT || RIGHT || UP)) { // Increase hours
-				setTime_state = STHrInc;
-			}
-		break;
+	alarmHour = 12; // Reset Set Alarm variables
+	alarmMin = 0;
+	if(Admin == 0x02) {
+		Admin = 0x01;
+	}
+}
+
+static const struct FSMTransition setAlarmTransitions[] PROGMEM = {
+	{SAInit, FSM_ALWAYS, SAIdle},
+	{SAIdle, GSAHasAdmin, SADisplay}, // Wait for admin
+	{SASetAla, GOnlyLeft, SASaveAla}, // Save alarm
+	{SASetAla, GOnlyRight, SAToDT}, // Cancel alarm
+	{SASetAla, GOnlyUp, SAMinInc},
+	{SASetAla, GOnlyDown, SAHrInc},
+	{SADisplay, FSM_ALWAYS, SASetAla},
+	{SAHrInc, FSM_ALWAYS, SADisplay},
+	{SAMinInc, FSM_ALWAYS, SADisplay},
+	{SASaveAla, FSM_ALWAYS, SAToDT},
+	{SAToDT, FSM_ALWAYS, SAIdle}, // Return admin to DT
+	FSM_END_ROW,
+};
+
+static const unsigned char setAlarmFirst[SAStates] PROGMEM = {0, 1, 2, 6, 7, 8, 9, 10};
+
+static const FSMAction setAlarmActions[SAStates] PROGMEM = {
+	0, 0, 0, SA_Display, SA_HrInc, SA_MinInc, SA_Save, SA_ToDT,
+};
+
+#ifdef HOST_SIM
+static const char *const setAlarmNames[SAStates] = {
+	"SAInit", "SAIdle", "SASetAla", "SADisplay", "SAHrInc", "SAMinInc", "SASaveAla", "SAToDT",
+};
+#endif
+
+const struct FSM setAlarmFSM PROGMEM = {
+	setAlarmTransitions, setAlarmFirst, setAlarmActions, appGuards, SAStates
+	APP_FSM_NAMES("SetAlarm", setAlarmNames)
+};
+
+void SetAlarm_Tick() {
 	
-		case STSaveTime: // Save time
-			setTime_state = STToDT;
-		break;
+	FSM_Tick(&setAlarmFSM, &setAlarm_state);
+	LCD_Flush();
+}
+
+/* Display a time to be set
+   Button 1 - Set Time displayed
+   Button 2 - Cancel
+   Button 3 - Increase minute
+   Button 4 - Increase hour
+*/
+static void ST_Display() { // display current set time
 	
-		case STToDT: // Return admin to DT
-			setTime_state = STIdle;
-		break;
+	Setting_Display("Set Time", timeHour, timeMin);
+}
+
+static void ST_HrInc() {
 	
-		case STMinInc: // Inc minutes
-			setTime_state = STDisplay;
-		break;
+	Hour_Inc(&timeHour);
+}
+
+static void ST_MinInc() {
 	
-		case STHrInc: // Inc hours
-			setTime_state = STDisplay;
-		break;
+	Min_Inc(&timeMin);
+}
+
+static void ST_Save() { // call set time function from ds32131.h
 	
-		default:
-			setTime_state = STInit;
-		break;
-		
-	}	
+	struct ClockState *c;
+	if(!I2CBus_Acquire(&i2cSetTime)) {
+		return;
+	}
+	ds3231_setTime(dec2bcd(timeHour), dec2bcd(timeMin), 0, 0, 1); // The DS3231 counts 24 hours
+	I2CBus_Release(&i2cSetTime);
+	c = ClockState_Begin();
+	c->hour = timeHour;
+	c->minute = timeMin;
+	c->second = 0;
+	Alarm_Reschedule(c); // Alarms ring next counting from the new time
+	ClockState_End();
+}
+
+static void ST_ToDT() {
 	
-	// Actions
-	switch(setTime_state) {
+	timeHour = 12; // Reset Set time variables
+	timeMin = 0;
+	if(Admin == 0x04) {
+		Admin = 0x01;
+	}
+}
+
+static const struct FSMTransition setTimeTransitions[] PROGMEM = {
+	{STInit, FSM_ALWAYS, STIdle},
+	{STIdle, GSTHasAdmin, STDisplay}, // Wait for admin
+	{STSetTime, GOnlyLeft, STSaveTime}, // Save time
+	{STSetTime, GOnlyRight, STToDT}, // Cancel time
+	{STSetTime, GOnlyUp, STMinInc},
+	{STSetTime, GOnlyDown, STHrInc},
+	{STDisplay, FSM_ALWAYS, STSetTime},
+	{STHrInc, FSM_ALWAYS, STDisplay},
+	{STMinInc, FSM_ALWAYS, STDisplay},
+	{STSaveTime, FSM_ALWAYS, STToDT},
+	{STToDT, FSM_ALWAYS, STIdle}, // Return admin to DT
+	FSM_END_ROW,
+};
+
+static const unsigned char setTimeFirst[STStates] PROGMEM = {0, 1, 2, 6, 7, 8, 9, 10};
+
+static const FSMAction setTimeActions[STStates] PROGMEM = {
+	0, 0, 0, ST_Display, ST_HrInc, ST_MinInc, ST_Save, ST_ToDT,
+};
+
+#ifdef HOST_SIM
+static const char *const setTimeNames[STStates] = {
+	"STInit", "STIdle", "STSetTime", "STDisplay", "STHrInc", "STMinInc", "STSaveTime", "STToDT",
+};
+#endif
+
+const struct FSM setTimeFSM PROGMEM = {
+	setTimeTransitions, setTimeFirst, setTimeActions, appGuards, STStates
+	APP_FSM_NAMES("SetTime", setTimeNames)
+};
+
+void SetTime_Tick() {
 	
-		case STInit:
-		break;
-		
-		case STIdle: // wait for admin
-		break;
-		
-		case STDisplay: // display current set time
-			LCD_ClearScreen();
-			LCD_DisplayString(1, "Set Time");
-			if(hourMode == 0 && timeHour >= 13) {
-				SLCD_WriteData(17,((timeHour - 12) / 10) + '0'); // Display time
-				SLCD_WriteData(18, ((timeHour - 12) % 10) + '0');
-			}
-			else {
-				SLCD_WriteData(17,(timeHour / 10) + '0'); // Display time
-				SLCD_WriteData(18, (timeHour % 10) + '0');
-			}
-			SLCD_WriteData(19, ':');
-			SLCD_WriteData(20, (timeMin / 10) + '0');
-			SLCD_WriteData(21, (timeMin % 10) + '0');
-			if((hourMode == 0) && (timeAMPM == 1)) {
-				LCD_DisplayString(22, "PM");
-			}
-			else if((hourMode == 0) && (timeAMPM == 0)){
-				LCD_DisplayString(22, "AM");
-			}
-		break;
-		
-		case STSetTime: // wait for input
-		break;
-		
-		case STSaveTime: // call set time function from ds32131.h
-			if(hourMode == 0 && timeHour >= 13) {
-				timeHour -= 12;
-			}
-			timeHour = dec2bcd(timeHour);
-			timeMin = dec2bcd(timeMin);
-			ds3231_setTime(timeHour, timeMin, 0, timeAMPM, hourMode);
-		break;
-		
-		case STToDT:
-			timeHour = 12; // Reset Set time variables
-			timeMin = 0;
-			timeAMPM = 1;
-			if(Admin == 0x04) {
-				Admin = 0x01;
-			}
-		break;
-		
-		case STMinInc:
-			timeMin++;
-			if(timeMin >= 60) {
-				timeMin = 0;
-			}
-		break;
-		
-		case STHrInc:
-			timeHour++;
-			if(hourMode == 0) { // 12 hour mode settings
-				if(timeHour > 24) {
-					timeHour = 1;
-				}
-				if(timeHour >= 12 && timeHour < 24) {
-					timeAMPM = 1;
-				}
-				else {
-					timeAMPM = 0;
-				}
-				
-			}
-			else if(hourMode == 1 && timeHour >= 24) { // 24 hour mode settings
-				timeHour = 0;
-			}
-		break;
-		
-		default:
-			setTime_state = STInit;
-		break;	
+	FSM_Tick(&setTimeFSM, &setTime_state);
+	LCD_Flush();
+}
+
+// Turns light on and off
+static void LP_Brighten() {
+	
+	if(OCR0A < 255) { // LED gets to max brightness
+		OCR0A++;
 	}
+	PORTB |= 0x20;
+}
+
+static void LP_Dark() {
 	
+	OCR0A = 0;
+	PORTB &= 0xDF;
+}
+
+static const struct FSMTransition LEDPWMTransitions[] PROGMEM = {
+	{LPInit, FSM_ALWAYS, LPOff},
+	{LPOff, GAlarmOn, LPOn},
+	{LPOn, GAlarmOff, LPReset},
+	{LPOn, GSnoozed, LPSnooze},
+	{LPReset, FSM_ALWAYS, LPOff},
+	{LPSnooze, GAlarmOff, LPReset},
+	{LPSnooze, GSnoozeOver, LPOn}, // Ramps up from dark again
+	FSM_END_ROW,
+};
+
+static const unsigned char LEDPWMFirst[LPStates] PROGMEM = {0, 1, 2, 4, 5};
+
+static const FSMAction LEDPWMActions[LPStates] PROGMEM = {0, 0, LP_Brighten, LP_Dark, LP_Dark};
+
+#ifdef HOST_SIM
+static const char *const LEDPWMNames[LPStates] = {"LPInit", "LPOff", "LPOn", "LPReset", "LPSnooze"};
+#endif
+
+const struct FSM LEDPWMFSM PROGMEM = {
+	LEDPWMTransitions, LEDPWMFirst, LEDPWMActions, appGuards, LPStates
+	APP_FSM_NAMES("LEDPWM", LEDPWMNames)
 };
 
-// Turns light on and off
 void LEDPWM_Tick() {
 	
-	// Transitions
-	switch(LEDPWM_state) {
-		
-		case LPInit:
-			LEDPWM_state = LPOff;
-		break;
-		
-		case LPOff:
-			if(alarmOnFlag) {
-				LEDPWM_state = LPOn;
-			}
-			else {
-				LEDPWM_state = LPOff;
-			}
-		break;
-		
-		case LPOn:
-			if(!alarmOnFlag) {
-				LEDPWM_state = LPReset;
-			}
-			else {
-				LEDPWM_state = LPOn;
-			}
-		break;
-		
-		case LPReset:
-			LEDPWM_state = LPOff;
-		break;
-		
-		default:
-			LEDPWM_state = LPInit;
-		break;
+	FSM_Tick(&LEDPWMFSM, &LEDPWM_state);
+}
+
+static void AO_Ring() {
+	
+	unsigned char id = Alarm_Start();
+	alarmOnFlag = 1;
+	alarmOffSignal = 0;
+	alarmMelody = (id < ALARM_MAX) ? alarms[id].melody : 0;
+	Bus_Ring((id < ALARM_MAX) ? alarms[id].sleepers : 0);
+	LinkMon_Activity();
+}
+
+static void AO_Watch() {
+	
+	LinkMon_Activity(); // Watch the link closely while the alarm sounds
+}
+
+static void AO_Snooze() {
+	
+	Bus_Snooze();
+}
+
+static void AO_Resume() {
+	
+	Bus_Resume();
+	LinkMon_Activity();
+}
+
+static void AO_Reset() {
+	
+	Snooze_Cancel(); // Up during a snooze
+	Alarm_Done();
+	Settings_Changed(); // A one-off alarm is off now; a repeating one writes nothing
+	alarmOnFlag = 0;
+	alarmOffSignal = 0;
+	Bus_Quiet();
+}
+
+static const struct FSMTransition alarmOnTransitions[] PROGMEM = {
+	{AOInit, FSM_ALWAYS, AOCheck},
+	{AOCheck, GAlarmNear, AOSendFlag},
+	{AOSendFlag, GFlagSent, AOWaitSignal},
+	{AOWaitSignal, GSleeperUp, AOReset},
+	{AOWaitSignal, GSnoozed, AOSnooze},
+	{AOReset, FSM_ALWAYS, AOCheck},
+	{AOSnooze, GSleeperUp, AOReset},
+	{AOSnooze, GSnoozeOver, AOResume},
+	{AOResume, FSM_ALWAYS, AOWaitSignal},
+	FSM_END_ROW,
+};
+
+static const unsigned char alarmOnFirst[AOStates] PROGMEM = {0, 1, 2, 3, 5, 6, 8};
+
+static const FSMAction alarmOnActions[AOStates] PROGMEM = {0, 0, AO_Ring, AO_Watch, AO_Reset, AO_Snooze, AO_Resume};
+
+#ifdef HOST_SIM
+static const char *const alarmOnNames[AOStates] = {
+	"AOInit", "AOCheck", "AOSendFlag", "AOWaitSignal", "AOReset", "AOSnooze", "AOResume",
+};
+#endif
+
+const struct FSM alarmOnFSM PROGMEM = {
+	alarmOnTransitions, alarmOnFirst, alarmOnActions, appGuards, AOStates
+	APP_FSM_NAMES("AlarmOn", alarmOnNames)
+};
+
+void AlarmOn_Tick() {
+	
+	FSM_Tick(&alarmOnFSM, &alarmOn_state);
+}
+
+static void Speaker_Silent() {
+	
+	set_PWM(0);
+}
+
+static void Speaker_Play() {
+	
+	const struct Melody *m = &alarmMelodies[(alarmMelody < ALARM_MELODIES) ? alarmMelody : 0];
+	if(i >= m->length) {
+		i = 0;
 	}
+	set_PWM(m->notes[i]);
+	i++;
+}
+
+static const struct FSMTransition speakerOnTransitions[] PROGMEM = {
+	{SInit, FSM_ALWAYS, SOff},
+	{SOff, GAlarmTime, SOn},
+	{SOn, GAlarmOff, SOff},
+	{SOn, GSnoozed, SSnooze},
+	{SReset, FSM_ALWAYS, SOff},
+	{SSnooze, GAlarmOff, SOff},
+	{SSnooze, GSnoozeOver, SOn}, // The song goes on where it stopped
+	FSM_END_ROW,
+};
+
+static const unsigned char speakerOnFirst[SStates] PROGMEM = {0, 1, 2, 4, 5};
+
+static const FSMAction speakerOnActions[SStates] PROGMEM = {0, Speaker_Silent, Speaker_Play, Speaker_Silent, Speaker_Silent};
+
+#ifdef HOST_SIM
+static const char *const speakerOnNames[SStates] = {"SInit", "SOff", "SOn", "SReset", "SSnooze"};
+#endif
+
+const struct FSM speakerOnFSM PROGMEM = {
+	speakerOnTransitions, speakerOnFirst, speakerOnActions, appGuards, SStates
+	APP_FSM_NAMES("SpeakerOn", speakerOnNames)
+};
+
+void SpeakerOn_Tick() {
 	
-	// Actions
-	switch(LEDPWM_state) {
-		
-		case LPInit:
-		break;
-		
-		case LPOff:
-		break;
-		
-		case LPOn:
-			if(OCR0A < 255) { // LED gets to max brightness
-			OCR0A++;
-			}
-			PORTB |= 0x20;
-		break;
-		
-		case LPReset:
-			OCR0A = 0;
-			PORTB &= 0xDF;
-		break;
-		
-		default:
-		break;
+	FSM_Tick(&speakerOnFSM, &speakerOn_state);
+}
+
+#ifdef HOST_SIM
+/* For Host/fsmgraph.c */
+const struct FSM *const appFSMs[] = {
+	&displayTimeFSM, &setAlarmFSM, &setTimeFSM, &LEDPWMFSM, &alarmOnFSM, &speakerOnFSM, 0,
+};
+#endif
+
+#if APP_EVENTS
+/* Event-driven core: EventTask runs every state machine. The UI machines
+   run on a button press or repeat (events.h) or a redraw, the alarm
+   machines once a second, and the LED ramp and the song at their own rate
+   only while the alarm is on and not snoozed. A silent speaker waits for
+   the DS3231's alarm interrupt once the alarm is in it (rtcalarm.h), and
+   still looks once a minute in case the edge's event was lost. */
+#define UI_MAX_ROUNDS 8
+#define LED_STEP 200 // ms per LED brightness step
+#define SONG_STEP 500 // ms per note
+#define LED_RAMPING (LEDPWM_state != LPOff && LEDPWM_state != LPSnooze)
+#define SONG_PLAYING (speakerOn_state != SOff && speakerOn_state != SSnooze)
+
+static portTickType appSecondAt, appLedAt, appSongAt;
+static unsigned char appAlarmLook; // seconds to the next look for an armed alarm
+
+// Ticks the UI machines until none of them moves. The press is only seen
+// by the first round, so a held button acts once.
+void UI_Run(unsigned char pressed) {
+	
+	unsigned char n;
+	unsigned char dt, sa, st;
+	uiPressed = pressed;
+	for(n = 0; n < UI_MAX_ROUNDS; n++) {
+		dt = displayTime_state;
+		sa = setAlarm_state;
+		st = setTime_state;
+		DisplayTime_Tick();
+		SetAlarm_Tick();
+		SetTime_Tick();
+		uiPressed = 0;
+		if(dt == displayTime_state && sa == setAlarm_state && st == setTime_state) {
+			break;
+		}
 	}
 }
 
-void AlarmOn_Tick() {
+// ms until a job last run at 'last' is due again, 0 if it is due now
+static portTickType App_Left(portTickType now, portTickType last, portTickType period) {
+	
+	portTickType gone = now - last;
+	return (gone >= period) ? 0 : period - gone;
+}
 
-	unsigned char alarmOffSignal = 0; // If signal == 1, turn the alarm off
-	// Transitions
-	switch(alarmOn_state) {
-		
-		case AOInit:
-			alarmOn_state = AOCheck;
+void App_Init() {
+	
+	portTickType now = xTaskGetTickCount();
+	DisplayTime_Init();
+	SetAlarm_Init();
+	SetTime_Init();
+	LEDPWM_Init();
+	AlarmOn_Init();
+	SpeakerOn_Init();
+	appSecondAt = now - 1000; // Draw straight away
+	appLedAt = now;
+	appSongAt = now;
+}
+
+void App_Dispatch(const struct Event *ev) {
+	
+	switch(ev->type) {
+		case EV_BUTTON:
+			UI_Run(ev->arg);
 		break;
-		
-		case AOCheck:
-			if((hourMode == 0) && (alarmSetHour == 24 || ((ampm == 1) && (hrdec < 12)))) { // 12 hour mode at midnight or after 1pm
-					hourSum = (hrdec * 60) + mindec + 720;
-			}
-			else if ((hourMode == 1) && (alarmSetHour == 24)){ // 24 hour mode at midnight
-					hourSum = mindec + 1440;
-			}
-			else {
-					hourSum = (hrdec * 60) + mindec;
+		case EV_REPEAT: // A held UP or DOWN steps while an alarm or time is being set
+			if(Admin != 0x01) {
+				UI_Run(ev->arg);
 			}
-			alarmCheck = (alarmSetHour * 60) + alarmSetMin;
-			if(((alarmCheck - hourSum) <= 10)) { // Turn "on" alarm 10 minutes before
-				// FIX FOR EDGE CASE ALARM AT MIDNIGHT
-				alarmOnFlag = 1;
-				alarmOn_state = AOSendFlag;
-			}		
 		break;
-		
-		case AOSendFlag:
-			if(USART_HasTransmitted(0)) {
-				alarmOn_state = AOWaitSignal;
-			}
-			else {
-				alarmOn_state = AOSendFlag;
-			}
+		case EV_RENDER:
+			minTimer = DT_REFRESH;
+			UI_Run(0);
 		break;
-		
-		case AOWaitSignal:
-			if(USART_HasReceived(0)) {
-				alarmOffSignal = USART_Receive(0);
-				USART_Flush(0);
-				//alarmOn_state = AOReset;	
-				if(alarmOffSignal) {
-					alarmOn_state = AOReset;
-				}
-			}
-			else {
-				alarmOn_state = AOWaitSignal;
-			}
+		case EV_SLEEPER_UP:
+			AlarmOn_Tick();
 		break;
-		
-		case AOReset:
-			alarmOn_state = AOCheck;
+		case EV_ALARM: // Alarm 1 matched, so the time has come
+			UpdateTime();
+			AlarmOn_Tick();
+			SpeakerOn_Tick();
+			appSongAt = xTaskGetTickCount();
 		break;
-		
 		default:
-			alarmOn_state = AOInit;
 		break;
 	}
+}
+
+// Runs the periodic work that is due
+void App_Due() {
 	
-	// Actions
-	switch(alarmOn_state) {
-		
-		case AOInit:
-		break;
-		
-		case AOCheck:
-		break;
-		
-		case AOSendFlag:
-			if(USART_IsSendReady(0)) {
-				USART_Send(0x01, 0);
-			}
-		break;
-		
-		case AOWaitSignal:
-		break;
-		
-		case AOReset:
-			alarmSetHour = 0x0F;
-			alarmSetMin = 0x0F;
-			alarmSetAMPM = 0;
-			alarmOnFlag = 0;
-			alarmIsSet = 0;
-			alarmOffSignal = 0;		
-		break;
-		
-		default:
-		break;
+	portTickType now = xTaskGetTickCount();
+	if(!App_Left(now, appSecondAt, 1000)) {
+		appSecondAt += 1000;
+		minTimer = DT_REFRESH;
+		UI_Run(0);
+		AlarmOn_Tick();
+		if(!LED_RAMPING) { // Idle machines only look for the alarm or the snooze end
+			LEDPWM_Tick();
+			appLedAt = now;
+		}
+		if(appAlarmLook) {
+			appAlarmLook--;
+		}
+		if(speakerOn_state == SSnooze || (speakerOn_state == SOff && (!RtcAlarm_Armed() || !appAlarmLook))) { // Else EV_ALARM starts it
+			SpeakerOn_Tick();
+			appSongAt = now;
+			appAlarmLook = 60; // The ring guard holds for a minute, so this cannot miss it
+		}
+	}
+	if(LED_RAMPING && !App_Left(now, appLedAt, LED_STEP)) {
+		LEDPWM_Tick();
+		appLedAt = now;
+	}
+	if(SONG_PLAYING && !App_Left(now, appSongAt, SONG_STEP)) {
+		SpeakerOn_Tick();
+		appSongAt = now;
 	}
 }
 
-void SpeakerOn_Tick() {
+// How long EventTask can block before App_Due has work
+portTickType App_Timeout() {
 	
-	// Transitions
-	switch(speakerOn_state) {
-		
-		case SInit:
-			speakerOn_state = SOff;
-		break;
-		
-		case SOff:
-			
-			if((hourMode == 0) && (alarmSetHour == 24 || ((ampm == 1) && (hrdec < 12)))) { // 12 hour mode at midnight or after 1pm
-				hourSum = (hrdec * 60) + mindec + 720;
-			}
-			else if ((hourMode == 1) && (alarmSetHour == 24)){ // 24 hour mode at midnight
-				hourSum = mindec + 1440;
-			}
-			else {
-				hourSum = (hrdec * 60) + mindec;
-			}
-			alarmCheck = (alarmSetHour * 60) + alarmSetMin;
-			
-			if(alarmCheck == hourSum) { // Turn "on" alarm on alarm time
-				speakerOn_state = SOn;
-			}
-			else {
-				speakerOn_state = SOff;
-			}
-		break;
-		
-		case SOn:
-			if(!alarmOnFlag) {
-				speakerOn_state = SOff;
-			}
-			else {
-				speakerOn_state = SOn;
-			}
-		break;
-		
-		case SReset:
-			speakerOn_state = SOff;
-		break;
-		
-		default:
-			speakerOn_state = SInit;
-		break;
-		
+	portTickType now = xTaskGetTickCount();
+	portTickType wait = App_Left(now, appSecondAt, 1000);
+	portTickType left;
+	if(LED_RAMPING && (left = App_Left(now, appLedAt, LED_STEP)) < wait) {
+		wait = left;
 	}
-		
-	// Actions
-	switch(speakerOn_state) {
+	if(SONG_PLAYING && (left = App_Left(now, appSongAt, SONG_STEP)) < wait) {
+		wait = left;
+	}
+	return wait;
+}
+
+void EventTask() {
 	
-		case SInit:
-		break;
-		
-		case SOff:
-			set_PWM(0);
-		break;
-		
-		case SOn:
-			set_PWM(alarmSong[i]);
-			if(i >= 40) {
-				i = 0;
-			}
-			else {
-				i++;
-			}
-		break;
-		
-		case SReset:
-			set_PWM(0);
-		break;	
-		
-		default:
-			set_PWM(0);
-		break;
+	struct Event ev;
+	App_Init();
+	for(;;) {
+		if(xQueueReceive(eventQueue, &ev, App_Timeout()) == pdTRUE) {
+			App_Dispatch(&ev);
+		}
+		App_Due();
+		eventStats.wakeups++;
 	}
 }
 
+#else
+#define DT_PERIOD 200 // ms between ticks of each polled state machine
+#define SA_PERIOD 50
+#define ST_PERIOD 50
+#define LP_PERIOD 200
+#define AO_PERIOD 1000
+#define SO_PERIOD 500
+
+#if !APP_SYNC_SM
 void DisplayTimeTask() {
 	
+	static struct Periodic periodic;
 	DisplayTime_Init();
+	Periodic_Init(&periodic, "DisplayTimeTask", DT_PERIOD);
 	for(;;) {
 		DisplayTime_Tick();
-		vTaskDelay(200);
+		Periodic_Wait(&periodic);
 	}
 }
 
+#if APP_COROUTINES
+/* SetAlarm, SetTime, LEDPWM and SpeakerOn never block, so they run as
+   co-routines from the idle hook. uxIndex picks the state machine. Each
+   one costs a 26 byte control block instead of a 33 byte TCB and an 85 byte
+   stack (AVR sizes, 8 character task names), so the four save 368 bytes
+   of heap. The co-routine lists in croutine.c take 58 bytes of .bss, already
+   linked in unless the build drops unused sections. appHeapFree shows what
+   is left once everything is created; configTOTAL_HEAP_SIZE can come down
+   by that much. */
+static const struct {
+	const char *name;
+	void (*init)();
+	void (*tick)();
+	portTickType period;
+} appCoRoutines[] = {
+	{"SetAlarm", SetAlarm_Init, SetAlarm_Tick, SA_PERIOD},
+	{"SetTime", SetTime_Init, SetTime_Tick, ST_PERIOD},
+	{"LEDPWM", LEDPWM_Init, LEDPWM_Tick, LP_PERIOD},
+	{"SpeakerOn", SpeakerOn_Init, SpeakerOn_Tick, SO_PERIOD},
+};
+#define APP_COROUTINE_COUNT (sizeof(appCoRoutines) / sizeof(appCoRoutines[0]))
+
+static struct Periodic appCoPeriodic[APP_COROUTINE_COUNT];
+
+void AppCoRoutine(xCoRoutineHandle xHandle, unsigned portBASE_TYPE uxIndex) {
+	
+	portTickType delay; // Not kept across crDELAY, only used just before it
+	crSTART(xHandle);
+	appCoRoutines[uxIndex].init();
+	Periodic_Init(&appCoPeriodic[uxIndex], appCoRoutines[uxIndex].name, appCoRoutines[uxIndex].period);
+	for(;;) {
+		appCoRoutines[uxIndex].tick();
+		delay = Periodic_Delay(&appCoPeriodic[uxIndex], xTaskGetTickCount());
+		crDELAY(xHandle, delay);
+	}
+	crEND();
+}
+#else
 void SetAlarmTask() {
 	
+	static struct Periodic periodic;
 	SetAlarm_Init();
+	Periodic_Init(&periodic, "SetAlarmTask", SA_PERIOD);
 	for(;;) {
 		SetAlarm_Tick();
-		vTaskDelay(50);
+		Periodic_Wait(&periodic);
 	}
 }
 
 void SetTimeTask() {
 	
+	static struct Periodic periodic;
 	SetTime_Init();
+	Periodic_Init(&periodic, "SetTimeTask", ST_PERIOD);
 	for(;;) {
 		SetTime_Tick();
-		vTaskDelay(50);
+		Periodic_Wait(&periodic);
 	}
 }
 
 void LEDPWMTask() {
 	
+	static struct Periodic periodic;
 	LEDPWM_Init();
+	Periodic_Init(&periodic, "LEDPWMTask", LP_PERIOD);
 	for(;;) {
 		LEDPWM_Tick();
-		vTaskDelay(200);
+		Periodic_Wait(&periodic);
 	}
 }
+#endif // APP_COROUTINES
 
 void AlarmOnTask() {
 	
+	static struct Periodic periodic;
 	AlarmOn_Init();
+	Periodic_Init(&periodic, "AlarmOnTask", AO_PERIOD);
 	for(;;) {
 		AlarmOn_Tick();
-		vTaskDelay(1000);
+		Periodic_Wait(&periodic);
 	}	
 }
 
+#if !APP_COROUTINES
 void SpeakerOnTask() {
 	
+	static struct Periodic periodic;
 	SpeakerOn_Init();
+	Periodic_Init(&periodic, "SpeakerOnTask", SO_PERIOD);
 	for(;;) {
 		SpeakerOn_Tick();
-		vTaskDelay(500);
+		Periodic_Wait(&periodic);
 	}	
 }
+#endif
+#endif // !APP_SYNC_SM
+
+#endif // APP_EVENTS
+
+size_t appHeapFree; // heap_1 bytes left once the scheduler has started
+
+void LinkTask_Init() {
+	
+	appHeapFree = xPortGetFreeHeapSize();
+#if INCLUDE_uxTaskGetStackHighWaterMark == 1 && INCLUDE_xTaskGetIdleTaskHandle == 1
+	Stack_Watch(xTaskGetIdleTaskHandle(), "IDLE", configMINIMAL_STACK_SIZE); // Runs the co-routines too
+#endif
+	LinkMon_Init();
+	Bus_Init();
+#if configGENERATE_RUN_TIME_STATS == 1
+	RunStats_Init();
+#endif
+}
+
+#if APP_SYNC_SM
+/* Synchronous state machine engine: one task ticks every state machine
+   from a table, each at its own period, on a shared base period that is
+   the GCD of all of them. The state of each machine stays in its own
+   *_state variable. The machines can no longer preempt one another, so
+   a slow LCD redraw (~37 ms) holds up everything after it in the same
+   pass. Link_Tick, due every 20 ms, would miss a deadline on every
+   redraw whatever its place in the table, so LinkTask stays a task of
+   its own and time slices with this one (see Host/coresim.c -j). Against
+   the seven tasks of the polling core this needs two TCBs and stacks,
+   590 bytes less heap at AVR sizes (85 byte stacks, 33 byte TCBs), for
+   48 bytes of table. */
+struct SyncSM {
+	void (*init)();
+	void (*tick)();
+	unsigned int period; // ms
+	unsigned int elapsedTime; // ms since the last tick
+};
+
+/* Euclid's algorithm unrolled for the preprocessor. Ten steps are enough
+   for any two periods under 144 ms and for every pair here; the check
+   below catches a table that needs more. */
+#define SM_GCD0(a, b) (a)
+#define SM_GCD1(a, b) ((b) == 0 ? (a) : SM_GCD0((b), (a) % (b)))
+#define SM_GCD2(a, b) ((b) == 0 ? (a) : SM_GCD1((b), (a) % (b)))
+#define SM_GCD3(a, b) ((b) == 0 ? (a) : SM_GCD2((b), (a) % (b)))
+#define SM_GCD4(a, b) ((b) == 0 ? (a) : SM_GCD3((b), (a) % (b)))
+#define SM_GCD5(a, b) ((b) == 0 ? (a) : SM_GCD4((b), (a) % (b)))
+#define SM_GCD6(a, b) ((b) == 0 ? (a) : SM_GCD5((b), (a) % (b)))
+#define SM_GCD7(a, b) ((b) == 0 ? (a) : SM_GCD6((b), (a) % (b)))
+#define SM_GCD8(a, b) ((b) == 0 ? (a) : SM_GCD7((b), (a) % (b)))
+#define SM_GCD9(a, b) ((b) == 0 ? (a) : SM_GCD8((b), (a) % (b)))
+#define SM_GCD(a, b) ((b) == 0 ? (a) : SM_GCD9((b), (a) % (b)))
+
+// One name per step keeps each expansion small
+enum {
+	SM_GCD_DT = DT_PERIOD,
+	SM_GCD_SA = SM_GCD(SM_GCD_DT, SA_PERIOD),
+	SM_GCD_ST = SM_GCD(SM_GCD_SA, ST_PERIOD),
+	SM_GCD_LP = SM_GCD(SM_GCD_ST, LP_PERIOD),
+	SM_GCD_AO = SM_GCD(SM_GCD_LP, AO_PERIOD),
+	SM_TICK = SM_GCD(SM_GCD_AO, SO_PERIOD) // 50 ms
+};
+
+typedef char smTickCheck[(DT_PERIOD % SM_TICK == 0 && SA_PERIOD % SM_TICK == 0 &&
+	ST_PERIOD % SM_TICK == 0 && LP_PERIOD % SM_TICK == 0 && AO_PERIOD % SM_TICK == 0 &&
+	SO_PERIOD % SM_TICK == 0) ? 1 : -1];
+
+// Starting each elapsedTime at its period ticks every machine on the first pass
+struct SyncSM syncSMs[] = {
+	{DisplayTime_Init, DisplayTime_Tick, DT_PERIOD, DT_PERIOD},
+	{SetAlarm_Init, SetAlarm_Tick, SA_PERIOD, SA_PERIOD},
+	{SetTime_Init, SetTime_Tick, ST_PERIOD, ST_PERIOD},
+	{LEDPWM_Init, LEDPWM_Tick, LP_PERIOD, LP_PERIOD},
+	{AlarmOn_Init, AlarmOn_Tick, AO_PERIOD, AO_PERIOD},
+	{SpeakerOn_Init, SpeakerOn_Tick, SO_PERIOD, SO_PERIOD},
+};
+#define SYNC_SM_COUNT (sizeof(syncSMs) / sizeof(syncSMs[0]))
+
+void SyncSMTask() {
+	
+	static struct Periodic periodic;
+	unsigned char n;
+	unsigned int skipped = 0; // ms of passes lost to an overrun
+	for(n = 0; n < SYNC_SM_COUNT; n++) {
+		syncSMs[n].init();
+	}
+	Periodic_Init(&periodic, "SyncSMTask", SM_TICK);
+	for(;;) {
+		for(n = 0; n < SYNC_SM_COUNT; n++) {
+			syncSMs[n].elapsedTime += skipped;
+			if(syncSMs[n].elapsedTime >= syncSMs[n].period) {
+				syncSMs[n].tick();
+				syncSMs[n].elapsedTime = 0;
+			}
+			syncSMs[n].elapsedTime += SM_TICK;
+		}
+		skipped = Periodic_Wait(&periodic) * SM_TICK;
+	}
+}
+#endif // APP_SYNC_SM
+
+void LinkTask() {
+	
+	static struct Periodic periodic;
+	LinkTask_Init();
+	Periodic_Init(&periodic, "LinkTask", LINKMON_TICK);
+	for(;;) {
+		Link_Tick();
+		Periodic_Wait(&periodic);
+	}
+}
+
+// Co-routines and the settings write-behind only run when no task is
+// ready, from the idle task
+void vApplicationIdleHook() {
+	
+#if APP_COROUTINES
+	vCoRoutineSchedule();
+#endif
+	Settings_Poll();
+}
+
+/* Stack of each task, in bytes on the AVR. They all used to get
+   configMINIMAL_STACK_SIZE, which is still the default; Host/stacksize
+   works out the -D for each one from the call graph (Host/README.md). */
+#ifndef EVENT_STACK
+#define EVENT_STACK configMINIMAL_STACK_SIZE
+#endif
+#ifndef DT_STACK
+#define DT_STACK configMINIMAL_STACK_SIZE
+#endif
+#ifndef SA_STACK
+#define SA_STACK configMINIMAL_STACK_SIZE
+#endif
+#ifndef ST_STACK
+#define ST_STACK configMINIMAL_STACK_SIZE
+#endif
+#ifndef LP_STACK
+#define LP_STACK configMINIMAL_STACK_SIZE
+#endif
+#ifndef AO_STACK
+#define AO_STACK configMINIMAL_STACK_SIZE
+#endif
+#ifndef SO_STACK
+#define SO_STACK configMINIMAL_STACK_SIZE
+#endif
+#ifndef SYNC_STACK
+#define SYNC_STACK configMINIMAL_STACK_SIZE
+#endif
+#ifndef LINK_STACK
+#define LINK_STACK configMINIMAL_STACK_SIZE
+#endif
+
+void App_Task(pdTASK_CODE code, const char *name, unsigned short depth, unsigned portBASE_TYPE Priority) {
+	
+	xTaskHandle handle = NULL;
+	xTaskCreate(code, (signed portCHAR *)name, depth, NULL, Priority, &handle);
+#if INCLUDE_uxTaskGetStackHighWaterMark == 1
+	Stack_Watch(handle, name, depth);
+#endif
+}
 
 void StartSecPulse(unsigned portBASE_TYPE Priority) {
 	
-	xTaskCreate(DisplayTimeTask, (signed portCHAR *)"DisplayTimeTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL);
-	xTaskCreate(SetAlarmTask, (signed portCHAR *)"SetAlarmTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL);
-	xTaskCreate(SetTimeTask, (signed portCHAR *)"SetTimeTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL);
-	xTaskCreate(LEDPWMTask, (signed portCHAR *)"LEDPWMTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL);	
-	xTaskCreate(AlarmOnTask, (signed portCHAR *)"AlarmOnTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL);
-	xTaskCreate(SpeakerOnTask, (signed portCHAR *)"SpeakerOnTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL);
+#if APP_EVENTS
+	App_Task(EventTask, "EventTask", EVENT_STACK, Priority);
+#elif APP_COROUTINES
+	unsigned char n;
+	App_Task(DisplayTimeTask, "DisplayTimeTask", DT_STACK, Priority);
+	App_Task(AlarmOnTask, "AlarmOnTask", AO_STACK, Priority);
+	for(n = 0; n < APP_COROUTINE_COUNT; n++) {
+		xCoRoutineCreate(AppCoRoutine, 0, n);
+	}
+#elif APP_SYNC_SM
+	App_Task(SyncSMTask, "SyncSMTask", SYNC_STACK, Priority);
+#else
+	App_Task(DisplayTimeTask, "DisplayTimeTask", DT_STACK, Priority);
+	App_Task(SetAlarmTask, "SetAlarmTask", SA_STACK, Priority);
+	App_Task(SetTimeTask, "SetTimeTask", ST_STACK, Priority);
+	App_Task(LEDPWMTask, "LEDPWMTask", LP_STACK, Priority);
+	App_Task(AlarmOnTask, "AlarmOnTask", AO_STACK, Priority);
+	App_Task(SpeakerOnTask, "SpeakerOnTask", SO_STACK, Priority);
+#endif
+	App_Task(LinkTask, "LinkTask", LINK_STACK, Priority);
 }
 
 int main(void) {
@@ -988,8 +1438,17 @@ int main(void) {
 	LCD_init();
 	ds3231_init();	
 	_delay_ms(100);
-	initUSART(0);
-	USART_Flush(0);
+	UpdateTime(); // The alarms in the EEPROM are scheduled from now
+	Settings_Load();
+	I2CBus_Init();
+	Snooze_Init();
+	Link_Init();
+#if FSR_FORWARD || CONSOLE_USART
+	initUSART(1);
+#endif
+#if APP_EVENTS
+	Event_Init();
+#endif
 	
 	/* hour, minute, second, am/pm, year, month, date, day */
 	//ds3231_set(0x12, 0x29, 0x00, 0x01, 0x18, 0x04, 0x23, 0x02);
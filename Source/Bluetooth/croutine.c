@@ -341,6 +341,60 @@ void vCoRoutineSchedule( void )
 }
 /*-----------------------------------------------------------*/
 
+portTickType xCoRoutineGetExpectedIdleTime( void )
+{
+portTickType xReturn = portMAX_DELAY, xPassed;
+unsigned portBASE_TYPE uxPriority;
+corCRCB *pxCRCB;
+
+	/* Used by tickless idle.  Returns the number of ticks until the next
+	co-routine is due, or zero if one is ready to run now.  The co-routine
+	tick count only catches up with the kernel's in vCoRoutineSchedule(), so
+	the ticks since then are taken off. */
+	if( pxCurrentCoRoutine == NULL )
+	{
+		/* No co-routines have been created. */
+		return xReturn;
+	}
+
+	if( listLIST_IS_EMPTY( &xPendingReadyCoRoutineList ) == pdFALSE )
+	{
+		return ( portTickType ) 0;
+	}
+
+	for( uxPriority = 0; uxPriority < configMAX_CO_ROUTINE_PRIORITIES; uxPriority++ )
+	{
+		if( listLIST_IS_EMPTY( &( pxReadyCoRoutineLists[ uxPriority ] ) ) == pdFALSE )
+		{
+			return ( portTickType ) 0;
+		}
+	}
+
+	if( listLIST_IS_EMPTY( pxDelayedCoRoutineList ) == pdFALSE )
+	{
+		pxCRCB = ( corCRCB * ) listGET_OWNER_OF_HEAD_ENTRY( pxDelayedCoRoutineList );
+		xReturn = listGET_LIST_ITEM_VALUE( &( pxCRCB->xGenericListItem ) ) - xCoRoutineTickCount;
+	}
+	else if( listLIST_IS_EMPTY( pxOverflowDelayedCoRoutineList ) == pdFALSE )
+	{
+		/* Nothing is due before the co-routine tick count wraps. */
+		xReturn = ( portTickType ) 0 - xCoRoutineTickCount;
+	}
+
+	xPassed = xTaskGetTickCount() - xLastTickCount;
+	if( xPassed >= xReturn )
+	{
+		xReturn = 0;
+	}
+	else if( xReturn != portMAX_DELAY )
+	{
+		xReturn -= xPassed;
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
 static void prvInitialiseCoRoutineLists( void )
 {
 unsigned portBASE_TYPE uxPriority;
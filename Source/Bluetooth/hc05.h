@@ -0,0 +1,273 @@
+// HC-05 / HC-06 Bluetooth module driver for the bed sensor.
+// Include after usart_ATmega1284.h and link.h.
+//
+// HC05_Tick configures the module with AT commands one step per tick, so
+// boot never blocks the scheduler, then switches USART0 to the fastest
+// rate both ends can run and follows the module's STATE pin.
+
+#ifndef HC05_H
+#define HC05_H
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef HC05_MODEL
+#define HC05_MODEL 5 // 5 = HC-05, 6 = HC-06
+#endif
+#define HC05_NAME "AlarmBed"
+#define HC05_PIN "1234"
+#define HC05_ROLE 0 // 0 slave, 1 master (HC-05 only)
+
+#if HC05_MODEL == 5
+#define HC05_AT_BAUD 38400 // Fixed rate of HC-05 command mode
+#define HC05_EOL "\r\n"
+#else
+#define HC05_AT_BAUD 9600 // HC-06 takes commands at its data rate
+#define HC05_EOL ""
+#endif
+
+#define HC05_TICK 10 // ms between HC05_Tick calls
+#define HC05_BOOT_TIME (800 / HC05_TICK) // Module power-up
+#define HC05_REPLY_TIMEOUT (600 / HC05_TICK)
+#define HC05_RETRIES 3
+#define HC05_STATE_DEBOUNCE 3 // ticks the STATE pin must hold a level
+#define HC05_MAX_ERROR 25 // Highest acceptable baud error, tenths of a percent
+
+/* Module pins on PORTD (PD0/PD1 are USART0) */
+#define HC05_KEY 2 // out: high at power-up selects command mode (HC-05)
+#define HC05_STATE 3 // in: high while a remote device is connected
+#define HC05_PWR 4 // out: high powers the module
+#define HC05_STATE_UP ((PIND & (1 << HC05_STATE)) != 0)
+
+enum HC05State {HCInit, HCBoot, HCSend, HCWaitReply, HCSwitchBaud, HCReady, HCFailed} hc05_state;
+
+/* Data rates the modules accept, fastest first, and the HC-06 AT+BAUD
+   code for each */
+static const unsigned long hc05Bauds[] = {1382400, 921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600};
+static const char hc06BaudCodes[] = "CBA987654";
+
+unsigned char hc05Step; // index of the AT command being sent
+unsigned char hc05Retries;
+unsigned char hc05Timer;
+unsigned char hc05ReplyLen;
+char hc05Reply[24];
+char hc05Command[32];
+unsigned long hc05Baud; // data rate chosen for after setup
+unsigned char hc05LinkUp;
+unsigned char hc05StateCount;
+unsigned int hc05LinkUps;
+unsigned int hc05LinkDowns;
+
+// Fastest module rate USART0 can generate within HC05_MAX_ERROR
+unsigned long HC05_PickBaud() {
+	unsigned char n;
+	for(n = 0; n < sizeof(hc05Bauds) / sizeof(hc05Bauds[0]); n++) {
+		if(USART_BaudError(hc05Bauds[n]) <= HC05_MAX_ERROR) {
+			return hc05Bauds[n];
+		}
+	}
+	return 9600;
+}
+
+// Builds the command for hc05Step. Returns 0 when the script is finished.
+unsigned char HC05_BuildCommand() {
+#if HC05_MODEL == 5
+	switch(hc05Step) {
+		case 0: strcpy(hc05Command, "AT"); break;
+		case 1: strcpy(hc05Command, "AT+NAME=" HC05_NAME); break;
+		case 2: snprintf(hc05Command, sizeof(hc05Command), "AT+ROLE=%d", HC05_ROLE); break;
+		case 3: strcpy(hc05Command, "AT+PSWD=" HC05_PIN); break;
+		case 4: strcpy(hc05Command, "AT+CMODE=1"); break;
+		case 5: snprintf(hc05Command, sizeof(hc05Command), "AT+UART=%lu,0,0", hc05Baud); break;
+		case 6: strcpy(hc05Command, "AT+RESET"); break; // Restart in data mode
+		default: return 0;
+	}
+#else
+	unsigned char n;
+	switch(hc05Step) {
+		case 0: strcpy(hc05Command, "AT"); break;
+		case 1: strcpy(hc05Command, "AT+NAME" HC05_NAME); break;
+		case 2: strcpy(hc05Command, "AT+PIN" HC05_PIN); break;
+		case 3:
+			for(n = 0; hc05Bauds[n] != hc05Baud; n++);
+			snprintf(hc05Command, sizeof(hc05Command), "AT+BAUD%c", hc06BaudCodes[n]);
+		break;
+		default: return 0;
+	}
+#endif
+	strcat(hc05Command, HC05_EOL);
+	return 1;
+}
+
+// Collects reply bytes. Returns 1 once a whole reply is in hc05Reply.
+// The HC-05 ends replies with CRLF; the HC-06 does not, so for it a reply
+// is complete when the line goes quiet.
+unsigned char HC05_ReadReply() {
+	unsigned char data;
+	unsigned char got = 0;
+	while(Link_ReadByte(&data)) {
+		got = 1;
+		if(data == '\n') {
+			return hc05ReplyLen > 0;
+		}
+		if(data != '\r' && hc05ReplyLen < sizeof(hc05Reply) - 1) {
+			hc05Reply[hc05ReplyLen++] = data;
+			hc05Reply[hc05ReplyLen] = 0;
+		}
+	}
+	return (HC05_MODEL == 6) && !got && hc05ReplyLen >= 2;
+}
+
+void HC05_Init() {
+
+	hc05_state = HCInit;
+	DDRD |= (1 << HC05_KEY) | (1 << HC05_PWR);
+	DDRD &= ~(1 << HC05_STATE);
+}
+
+unsigned char HC05_LinkUp() {
+
+	return hc05LinkUp;
+}
+
+void HC05_Tick() {
+
+	// Transitions
+	switch(hc05_state) {
+
+		case HCInit:
+			hc05_state = HCBoot;
+		break;
+
+		case HCBoot:
+			if(hc05Timer >= HC05_BOOT_TIME) {
+				hc05_state = HCSend;
+			}
+			else {
+				hc05_state = HCBoot;
+			}
+		break;
+
+		case HCSend:
+			hc05_state = HCWaitReply;
+		break;
+
+		case HCWaitReply:
+			if(HC05_ReadReply()) {
+				if(strncmp(hc05Reply, "OK", 2) == 0) {
+					hc05Step++;
+					hc05Retries = 0;
+					if(HC05_BuildCommand()) {
+						hc05_state = HCSend;
+					}
+					else { // Script done
+						hc05Timer = 0;
+						hc05_state = HCSwitchBaud;
+					}
+				}
+				else if(++hc05Retries >= HC05_RETRIES) { // ERROR reply
+					hc05_state = HCFailed;
+				}
+				else {
+					hc05_state = HCSend;
+				}
+			}
+			else if(hc05Timer >= HC05_REPLY_TIMEOUT) {
+				hc05_state = (++hc05Retries >= HC05_RETRIES) ? HCFailed : HCSend;
+			}
+			else {
+				hc05_state = HCWaitReply;
+			}
+		break;
+
+		case HCSwitchBaud:
+			if(hc05Timer >= HC05_BOOT_TIME) {
+				hc05_state = HCReady;
+			}
+			else {
+				hc05_state = HCSwitchBaud;
+			}
+		break;
+
+		case HCReady:
+			hc05_state = HCReady;
+		break;
+
+		case HCFailed: // Module may already be set up; carry on at the fallback rate
+			hc05_state = HCFailed;
+		break;
+
+		default:
+			hc05_state = HCInit;
+		break;
+	}
+
+	// Actions
+	switch(hc05_state) {
+
+		case HCInit:
+		break;
+
+		case HCBoot:
+			if(hc05Timer == 0) {
+				PORTD |= (1 << HC05_KEY) | (1 << HC05_PWR); // Power up in command mode
+				USART_SetBaud(HC05_AT_BAUD, 0);
+				hc05Baud = HC05_PickBaud();
+				hc05Step = 0;
+				hc05Retries = 0;
+				HC05_BuildCommand();
+			}
+			hc05Timer++;
+		break;
+
+		case HCSend:
+			hc05Timer = 0;
+			hc05ReplyLen = 0;
+			hc05Reply[0] = 0;
+			for(char *c = hc05Command; *c; c++) {
+				USART_Send(*c, 0);
+			}
+		break;
+
+		case HCWaitReply:
+			hc05Timer++;
+		break;
+
+		case HCSwitchBaud:
+			if(hc05Timer == 0) {
+				PORTD &= ~(1 << HC05_KEY); // Data mode after the reset
+				USART_SetBaud(hc05Baud, 0);
+			}
+			hc05Timer++;
+		break;
+
+		case HCReady:
+		case HCFailed:
+			if(hc05_state == HCFailed && hc05Baud != BAUD_RATE) {
+				PORTD &= ~(1 << HC05_KEY);
+				hc05Baud = BAUD_RATE;
+				USART_SetBaud(hc05Baud, 0);
+			}
+			if(HC05_STATE_UP != hc05LinkUp) { // Follow STATE once it settles
+				if(++hc05StateCount >= HC05_STATE_DEBOUNCE) {
+					hc05LinkUp = !hc05LinkUp;
+					hc05StateCount = 0;
+					if(hc05LinkUp) {
+						hc05LinkUps++;
+					}
+					else {
+						hc05LinkDowns++;
+					}
+				}
+			}
+			else {
+				hc05StateCount = 0;
+			}
+		break;
+
+		default:
+		break;
+	}
+}
+
+#endif // HC05_H
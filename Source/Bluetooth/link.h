@@ -0,0 +1,251 @@
+// Framed messages over USART0 between the clock and the bed sensors.
+// Include after usart_ATmega1284.h. The same file is used by both nodes.
+//
+// Every frame carries the address of the sensor node it is to or from; the
+// clock sends LINK_BROADCAST to reach them all. With LINK_BUS set the nodes
+// share one RS-485 pair: the clock polls each node in turn and a node only
+// talks when answering a poll, so the half-duplex bus never sees two
+// senders.
+
+#ifndef LINK_H
+#define LINK_H
+
+#include <avr/interrupt.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "tracehooks.h"
+
+/* Frame layout: SOF | addr | type | len | payload[len] | crc8(addr .. payload)
+   Any SOF or ESC byte after the SOF is sent as ESC, byte ^ LINK_ESC_XOR, so
+   a SOF on the wire always starts a frame. A frame that is cut short or
+   fails its CRC is dropped and costs no more than itself. */
+#define LINK_SOF 0x7E
+#define LINK_ESC 0x7D
+#define LINK_ESC_XOR 0x20
+#define LINK_MAX_PAYLOAD 100
+#ifndef LINK_RX_SIZE
+#define LINK_RX_SIZE 128 // Must be a power of 2
+#endif
+
+#ifndef LINK_BUS
+#define LINK_BUS 0 // 0: point to point (HC-05), 1: shared RS-485 bus
+#endif
+#define LINK_MAX_NODES 8 // sensor nodes are 1 .. LINK_MAX_NODES
+#define LINK_BROADCAST 0x00 // clock -> every node; also the clock's own ID
+#define LINK_DE 4 // PORTD pin driving the RS-485 transceiver's DE and /RE
+
+/* Message types */
+#define LINK_ALARM_ON 0x01 // clock -> sensor: alarm is sounding
+#define LINK_ALARM_OFF 0x02 // sensor -> clock: sleeper is up
+#define LINK_SNOOZE 0x03 // sensor -> clock: short press, snooze the alarm
+#define LINK_FSR_FRAME 0x10 // sensor -> clock: batch of FSR samples
+#define LINK_PING 0x20 // clock -> sensor: heartbeat, payload is echoed
+#define LINK_PONG 0x21 // sensor -> clock: heartbeat reply
+#define LINK_POLL 0x30 // clock -> sensor: your slot, payload[0] is LINK_POLL_* flags
+#define LINK_IDLE 0x31 // sensor -> clock: answer to a poll with nothing to say
+
+#define LINK_POLL_ALARM 0x01 // this node's alarm is sounding
+
+struct LinkFrame {
+	unsigned char addr;
+	unsigned char type;
+	unsigned char len;
+	unsigned char payload[LINK_MAX_PAYLOAD];
+};
+
+struct LinkStats {
+	unsigned int txFrames;
+	unsigned int rxFrames;
+	unsigned int rxBadCrc;
+	unsigned int rxOverflow;
+};
+
+struct LinkStats linkStats;
+unsigned char linkNodeId = LINK_BROADCAST; // Set by a sensor before Link_Init
+
+static volatile unsigned char linkRxBuf[LINK_RX_SIZE];
+static volatile unsigned char linkRxHead;
+static volatile unsigned char linkRxTail;
+
+enum LinkParseState {LKSof, LKAddr, LKType, LKLen, LKPayload, LKCrc};
+static enum LinkParseState link_state = LKSof;
+static unsigned char linkRxIndex;
+static unsigned char linkRxEscape;
+static unsigned char linkRxCrc;
+
+unsigned char Link_Crc8(unsigned char crc, unsigned char data) {
+	unsigned char b;
+	crc ^= data;
+	for(b = 0; b < 8; b++) { // Polynomial x^8 + x^2 + x + 1
+		crc = (crc & 0x80) ? (unsigned char)((crc << 1) ^ 0x07) : (unsigned char)(crc << 1);
+	}
+	return crc;
+}
+
+// Bytes are moved out of the 2 byte hardware FIFO as they arrive so a
+// long frame is never overrun between polls.
+ISR(USART0_RX_vect) {
+	unsigned char data, next;
+	TRACE_ISR_ENTER(TRACE_ISR_USART0_RX);
+	data = USART_Receive(0);
+	next = (linkRxHead + 1) & (LINK_RX_SIZE - 1);
+	if(next == linkRxTail) {
+		linkStats.rxOverflow++;
+	}
+	else {
+		linkRxBuf[linkRxHead] = data;
+		linkRxHead = next;
+	}
+	TRACE_ISR_EXIT(TRACE_ISR_USART0_RX);
+}
+
+void Link_Init() {
+	initUSART(0);
+	USART_Flush(0);
+	UCSR0B |= (1 << RXCIE0);
+#if LINK_BUS
+	DDRD |= (1 << LINK_DE);
+	PORTD &= ~(1 << LINK_DE); // Listen
+#endif
+}
+
+static void Link_SendByte(unsigned char data) {
+	if(data == LINK_SOF || data == LINK_ESC) {
+		USART_Send(LINK_ESC, 0);
+		data ^= LINK_ESC_XOR;
+	}
+	USART_Send(data, 0);
+}
+
+// Sends one whole frame. The scheduler is held off (interrupts stay on) so
+// frames from two tasks on the same node never interleave.
+void Link_SendTo(unsigned char addr, unsigned char type, const unsigned char *payload, unsigned char len) {
+	unsigned char crc = 0;
+	unsigned char n;
+	vTaskSuspendAll();
+#if LINK_BUS
+	PORTD |= (1 << LINK_DE); // Take the bus
+	UCSR0A |= (1 << TXC0);
+#endif
+	USART_Send(LINK_SOF, 0);
+	Link_SendByte(addr);
+	crc = Link_Crc8(crc, addr);
+	Link_SendByte(type);
+	crc = Link_Crc8(crc, type);
+	Link_SendByte(len);
+	crc = Link_Crc8(crc, len);
+	for(n = 0; n < len; n++) {
+		Link_SendByte(payload[n]);
+		crc = Link_Crc8(crc, payload[n]);
+	}
+	Link_SendByte(crc);
+#if LINK_BUS
+	while(!USART_HasTransmitted(0)); // Last stop bit out before letting go
+	PORTD &= ~(1 << LINK_DE);
+#endif
+	linkStats.txFrames++;
+	xTaskResumeAll();
+}
+
+// Sends from this node: a sensor's own address, or a broadcast from the clock
+void Link_Send(unsigned char type, const unsigned char *payload, unsigned char len) {
+	Link_SendTo(linkNodeId, type, payload, len);
+}
+
+// Takes one raw received byte, bypassing the frame parser. Used while a
+// radio module is being configured and the link carries AT text.
+unsigned char Link_ReadByte(unsigned char *data) {
+	if(linkRxTail == linkRxHead) {
+		return 0;
+	}
+	*data = linkRxBuf[linkRxTail];
+	linkRxTail = (linkRxTail + 1) & (LINK_RX_SIZE - 1);
+	return 1;
+}
+
+// Consumes received bytes. Returns 1 and fills frame when a complete frame
+// with a good CRC is available, otherwise 0. A sensor only sees frames for
+// its own address or LINK_BROADCAST; the clock sees everything.
+unsigned char Link_Poll(struct LinkFrame *frame) {
+	unsigned char data;
+	while(linkRxTail != linkRxHead) {
+		data = linkRxBuf[linkRxTail];
+		linkRxTail = (linkRxTail + 1) & (LINK_RX_SIZE - 1);
+
+		if(data == LINK_SOF) { // Always the start of a new frame
+			if(link_state != LKSof) { // The previous one was cut short
+				linkStats.rxBadCrc++;
+			}
+			link_state = LKAddr;
+			linkRxEscape = 0;
+			continue;
+		}
+		if(link_state == LKSof) {
+			continue;
+		}
+		if(data == LINK_ESC) {
+			linkRxEscape = 1;
+			continue;
+		}
+		if(linkRxEscape) {
+			data ^= LINK_ESC_XOR;
+			linkRxEscape = 0;
+		}
+
+		switch(link_state) {
+
+			case LKSof:
+			break;
+
+			case LKAddr:
+				frame->addr = data;
+				linkRxCrc = Link_Crc8(0, data);
+				link_state = LKType;
+			break;
+
+			case LKType:
+				frame->type = data;
+				linkRxCrc = Link_Crc8(linkRxCrc, data);
+				link_state = LKLen;
+			break;
+
+			case LKLen:
+				if(data > LINK_MAX_PAYLOAD) { // Corrupt length, resync
+					linkStats.rxBadCrc++;
+					link_state = LKSof;
+					break;
+				}
+				frame->len = data;
+				linkRxCrc = Link_Crc8(linkRxCrc, data);
+				linkRxIndex = 0;
+				link_state = data ? LKPayload : LKCrc;
+			break;
+
+			case LKPayload:
+				frame->payload[linkRxIndex++] = data;
+				linkRxCrc = Link_Crc8(linkRxCrc, data);
+				if(linkRxIndex >= frame->len) {
+					link_state = LKCrc;
+				}
+			break;
+
+			case LKCrc:
+				link_state = LKSof;
+				if(data != linkRxCrc) {
+					linkStats.rxBadCrc++;
+				}
+				else if(linkNodeId == LINK_BROADCAST || frame->addr == linkNodeId || frame->addr == LINK_BROADCAST) {
+					linkStats.rxFrames++;
+					return 1;
+				} // Otherwise another node's traffic on the bus
+			break;
+
+			default:
+				link_state = LKSof;
+			break;
+		}
+	}
+	return 0;
+}
+
+#endif // LINK_H
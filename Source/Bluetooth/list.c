@@ -68,6 +68,7 @@
 #include <stdlib.h>
 #include "FreeRTOS.h"
 #include "list.h"
+#include "listwheel.h"
 
 /*-----------------------------------------------------------
  * PUBLIC LIST API documented in list.h
@@ -202,3 +203,143 @@ xList * pxList;
 }
 /*-----------------------------------------------------------*/
 
+
+#if ( configUSE_TIMER_WHEEL == 1 )
+
+/* The digit of xTime at uxLevel, which is the slot that holds items due then. */
+#define listWHEEL_DIGIT( xTime, uxLevel )	( ( unsigned portBASE_TYPE ) ( ( xTime ) >> ( ( uxLevel ) * listWHEEL_SLOT_BITS ) ) & ( listWHEEL_SLOTS - 1U ) )
+
+/*
+ * Ticks from xNow until the wheel next reaches slot uxSlot of level uxLevel.
+ * For level 0 that is when its items are due, for the levels above when its
+ * items are moved down.
+ */
+static portTickType prvWheelSlotDelay( portTickType xNow, unsigned portBASE_TYPE uxLevel, unsigned portBASE_TYPE uxSlot )
+{
+unsigned portBASE_TYPE uxShift = uxLevel * listWHEEL_SLOT_BITS;
+unsigned long ulSteps;
+
+	ulSteps = ( uxSlot - listWHEEL_DIGIT( xNow, uxLevel ) ) & ( listWHEEL_SLOTS - 1U );
+	if( ulSteps == 0UL )
+	{
+		/* The current slot comes round again after a full turn. */
+		ulSteps = listWHEEL_SLOTS;
+	}
+
+	/* The slot starts on a multiple of the level's unit.  For the top level
+	a full turn is the whole tick range, which wraps to the right answer. */
+	return ( portTickType ) ( ( ulSteps << uxShift ) - ( ( unsigned long ) xNow & ( ( 1UL << uxShift ) - 1UL ) ) );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Puts an item in the slot for its due time.  An item that is due at xNow
+ * goes in the current slot of level 0, which is only correct while that slot
+ * is being moved into.
+ */
+static portTickType prvWheelPlace( xListWheel *pxWheel, xListItem *pxNewListItem )
+{
+portTickType xDue = listGET_LIST_ITEM_VALUE( pxNewListItem );
+portTickType xDelay = ( portTickType ) ( xDue - pxWheel->xNow );
+unsigned portBASE_TYPE uxLevel = 0U, uxSlot;
+
+	while( ( uxLevel < ( listWHEEL_LEVELS - 1U ) ) && ( ( xDelay >> ( ( uxLevel + 1U ) * listWHEEL_SLOT_BITS ) ) != ( portTickType ) 0U ) )
+	{
+		uxLevel++;
+	}
+
+	uxSlot = listWHEEL_DIGIT( xDue, uxLevel );
+	vListInsertEnd( &( pxWheel->xSlots[ uxLevel ][ uxSlot ] ), pxNewListItem );
+
+	return prvWheelSlotDelay( pxWheel->xNow, uxLevel, uxSlot );
+}
+/*-----------------------------------------------------------*/
+
+void vListWheelInitialise( xListWheel *pxWheel, portTickType xNow )
+{
+unsigned portBASE_TYPE uxLevel, uxSlot;
+
+	for( uxLevel = 0U; uxLevel < listWHEEL_LEVELS; uxLevel++ )
+	{
+		for( uxSlot = 0U; uxSlot < listWHEEL_SLOTS; uxSlot++ )
+		{
+			vListInitialise( &( pxWheel->xSlots[ uxLevel ][ uxSlot ] ) );
+		}
+	}
+
+	pxWheel->xNow = xNow;
+}
+/*-----------------------------------------------------------*/
+
+portTickType xListWheelInsert( xListWheel *pxWheel, xListItem *pxNewListItem )
+{
+	/* An item due now would wait a full turn of level 0, as its slot has
+	already been passed. */
+	configASSERT( listGET_LIST_ITEM_VALUE( pxNewListItem ) != pxWheel->xNow );
+
+	return prvWheelPlace( pxWheel, pxNewListItem );
+}
+/*-----------------------------------------------------------*/
+
+xList *pxListWheelAdvance( xListWheel *pxWheel )
+{
+portTickType xNow;
+unsigned portBASE_TYPE uxLevel;
+xList *pxSlot;
+xListItem *pxItem;
+
+	xNow = ++( pxWheel->xNow );
+
+	/* Each level whose digit has rolled over to 0 moves the level above it
+	on to its next slot. */
+	for( uxLevel = 1U; ( uxLevel < listWHEEL_LEVELS ) && ( listWHEEL_DIGIT( xNow, uxLevel - 1U ) == 0U ); uxLevel++ )
+	{
+		/* Just counting the levels to move. */
+	}
+
+	/* Empty the slots that have been reached into the levels below, from the
+	top down, so items moved from high up can go on down in the same tick. */
+	while( --uxLevel > 0U )
+	{
+		pxSlot = &( pxWheel->xSlots[ uxLevel ][ listWHEEL_DIGIT( xNow, uxLevel ) ] );
+		while( listLIST_IS_EMPTY( pxSlot ) == pdFALSE )
+		{
+			pxItem = ( xListItem * ) pxSlot->xListEnd.pxNext;
+			vListRemove( pxItem );
+			( void ) prvWheelPlace( pxWheel, pxItem );
+		}
+	}
+
+	return &( pxWheel->xSlots[ 0 ][ listWHEEL_DIGIT( xNow, 0U ) ] );
+}
+/*-----------------------------------------------------------*/
+
+portTickType xListWheelNextEvent( xListWheel *pxWheel )
+{
+portTickType xNext = portMAX_DELAY, xDelay;
+unsigned portBASE_TYPE uxLevel, uxStep, uxSlot;
+
+	for( uxLevel = 0U; uxLevel < listWHEEL_LEVELS; uxLevel++ )
+	{
+		/* The first slot with items after the current one is the soonest on
+		this level, but a level above can still come sooner. */
+		for( uxStep = 1U; uxStep <= listWHEEL_SLOTS; uxStep++ )
+		{
+			uxSlot = ( listWHEEL_DIGIT( pxWheel->xNow, uxLevel ) + uxStep ) & ( listWHEEL_SLOTS - 1U );
+			if( listLIST_IS_EMPTY( &( pxWheel->xSlots[ uxLevel ][ uxSlot ] ) ) == pdFALSE )
+			{
+				xDelay = prvWheelSlotDelay( pxWheel->xNow, uxLevel, uxSlot );
+				if( xDelay < xNext )
+				{
+					xNext = xDelay;
+				}
+				break;
+			}
+		}
+	}
+
+	return xNext;
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configUSE_TIMER_WHEEL */
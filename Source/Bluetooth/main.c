@@ -15,6 +15,11 @@
 #include "task.h" 
 #include "croutine.h" 
 #include "usart_ATmega1284.h"
+#include "link.h"
+#include "telemetry.h"
+#include "hc05.h"
+#include "node.h"
+#include "periodic.h"
 
 void A2D_init() { // FSR reading
 	ADCSRA |= (1 << ADEN) | (1 << ADSC) | (1 << ADATE);
@@ -24,17 +29,63 @@ void A2D_init() { // FSR reading
 	//	    analog to digital conversions.
 }
 
-enum AlarmOffState {AOInit,AOWaitAlarm,AOWaitFSR,AOPress,AOOff} alarmOff_state;
+enum AlarmOffState {AOInit,AOWaitAlarm,AOWaitFSR,AOPress,AOOff,AOSnooze} alarmOff_state;
+enum FSRTelemetryState {FTInit,FTSample,FTSend} fsrTelemetry_state;
+
+#ifndef FSR_SAMPLE_PERIOD
+#define FSR_SAMPLE_PERIOD 50 // ms between FSR samples
+#endif
+#ifndef FSR_BATCH
+#define FSR_BATCH 32 // samples per telemetry frame
+#endif
+#if TELEMETRY_HEADER + 3 * (FSR_BATCH - 1) > LINK_MAX_PAYLOAD
+#error "FSR_BATCH is too large for a worst case frame in LINK_MAX_PAYLOAD"
+#endif
+#define SNOOZE_PRESS 5 // ticks a press must last to snooze, 30 turn the alarm off
 
 unsigned char threeSecCount = 0;
 unsigned char alarmOn = 0;
 
+struct LinkFrame linkFrame;
+
+uint16_t fsrSamples[FSR_BATCH];
+unsigned char fsrCount = 0;
+unsigned char fsrSeq = 0;
+unsigned int fsrFramesSent = 0;
+unsigned char fsrPayload[TELEMETRY_HEADER + 3 * (FSR_BATCH - 1)];
+
 
 void AlarmOff_Init(){
 	
 	alarmOff_state = AOInit;
 }
 
+// Drains frames from the clock
+void Link_Service(){
+	
+	if(!Node_LinkUp()) { // Nothing to talk to until the radio is paired
+		return;
+	}
+	
+	while(Link_Poll(&linkFrame)) {
+		switch(linkFrame.type) {
+			case LINK_ALARM_ON: // check if the alarm is on
+				alarmOn = 1;
+			break;
+			case LINK_PING: // Heartbeat, echo it back
+				Node_Send(LINK_PONG, linkFrame.payload, linkFrame.len);
+			break;
+			case LINK_POLL: // Our slot on the bus
+				if(Node_Polled(&linkFrame)) {
+					alarmOn = 1;
+				}
+			break;
+			default:
+			break;
+		}
+	}
+}
+
 void AlarmOff_Tick(){
 	
 	// Transitions
@@ -45,14 +96,9 @@ void AlarmOff_Tick(){
 		break;
 		
 		case AOWaitAlarm: 
-			if(USART_HasReceived(0)) { // check if the alarm is on
-				alarmOn = USART_Receive(0);
-				USART_Flush(0);
-				//alarmOff_state = AOWaitFSR;
-				if(alarmOn) {
-					alarmOn = 0;
-					alarmOff_state = AOWaitFSR;
-				}
+			if(alarmOn) {
+				alarmOn = 0;
+				alarmOff_state = AOWaitFSR;
 			}
 			else {
 				alarmOff_state = AOWaitAlarm;	
@@ -71,19 +117,34 @@ void AlarmOff_Tick(){
 		case AOPress:
 			
 			if(threeSecCount >= 30) {
+				Node_Send(LINK_ALARM_OFF, 0, 0); // Send off signal to the clock
 				alarmOff_state = AOOff;	
 			}
 			else if (PINA & 0x01){
 				alarmOff_state = AOPress;					
 			}
+			else if(threeSecCount >= SNOOZE_PRESS) { // A short press
+				Node_Send(LINK_SNOOZE, 0, 0);
+				alarmOn = 0; // Only the LINK_ALARM_ON after the snooze counts
+				alarmOff_state = AOSnooze;
+			}
 			else {
 				alarmOff_state = AOWaitFSR;
 			}
 			
 		break;
 		
+		case AOSnooze: // The clock sends LINK_ALARM_ON again when it is over
+			if(alarmOn && Node_Sent()) {
+				alarmOff_state = AOWaitAlarm;
+			}
+			else {
+				alarmOff_state = AOSnooze;
+			}
+		break;
+		
 		case AOOff:
-			if(USART_HasTransmitted(0)) {
+			if(Node_Sent()) {
 				alarmOff_state = AOWaitAlarm;
 			}
 			else {
@@ -118,10 +179,12 @@ void AlarmOff_Tick(){
 		
 		case AOOff:
 			threeSecCount = 0;
-			if(USART_IsSendReady(0)) { // Send off signal through USART
-				USART_Send(0x01, 0);
-				PORTB = 0xFF;
-			}			
+			PORTB = 0xFF;
+		break;
+		
+		case AOSnooze:
+			threeSecCount = 0;
+			PORTB = 0x00;
 		break;
 		
 		default:
@@ -130,19 +193,122 @@ void AlarmOff_Tick(){
 	}
 }
 
+void FSRTelemetry_Init(){
+	
+	fsrTelemetry_state = FTInit;
+}
+
+// Samples the FSR and streams it to the clock one batch at a time
+void FSRTelemetry_Tick(){
+	
+	// Transitions
+	switch(fsrTelemetry_state){
+		
+		case FTInit:
+			fsrTelemetry_state = FTSample;
+		break;
+		
+		case FTSample:
+			if(fsrCount >= FSR_BATCH) {
+				fsrTelemetry_state = FTSend;
+			}
+			else {
+				fsrTelemetry_state = FTSample;
+			}
+		break;
+		
+		case FTSend:
+			fsrTelemetry_state = FTSample;
+		break;
+		
+		default:
+			fsrTelemetry_state = FTInit;
+		break;
+	}
+	
+	// Actions
+	switch(fsrTelemetry_state){
+		
+		case FTInit:
+		break;
+		
+		case FTSample:
+			fsrSamples[fsrCount++] = ADC; // ADC free runs from A2D_init
+		break;
+		
+		case FTSend:
+			if(Node_LinkUp()) { // Batches taken while unpaired are dropped
+				Node_Send(LINK_FSR_FRAME, fsrPayload, Telemetry_Encode(fsrSeq++, fsrSamples, fsrCount, fsrPayload));
+				fsrFramesSent++;
+			}
+			fsrCount = 0;
+		break;
+		
+		default:
+		break;
+	}
+}
+
+void FSRTelemetryTask()
+{
+	static struct Periodic periodic;
+	FSRTelemetry_Init();
+	Periodic_Init(&periodic, "FSRTelemetryTask", FSR_SAMPLE_PERIOD);
+   for(;;)
+   {
+	FSRTelemetry_Tick();
+	Periodic_Wait(&periodic);
+   }
+}
+
+void LinkTask()
+{
+	static struct Periodic periodic;
+	Periodic_Init(&periodic, "LinkTask", NODE_TICK);
+   for(;;)
+   {
+	Link_Service();
+	Periodic_Wait(&periodic);
+   }
+}
+
+void HC05Task()
+{
+	static struct Periodic periodic;
+	HC05_Init();
+	Periodic_Init(&periodic, "HC05Task", HC05_TICK);
+   for(;;)
+   {
+	HC05_Tick();
+	Periodic_Wait(&periodic);
+   }
+}
+
 void AlarmOffTask()
 {
+	static struct Periodic periodic;
 	AlarmOff_Init();
+	Periodic_Init(&periodic, "AlarmOffTask", 100);
    for(;;) 
    { 	
 	AlarmOff_Tick();
-	vTaskDelay(100); 
+	Periodic_Wait(&periodic);
    } 
 }
 
+// Called by the idle task; the sensor has no background work
+void vApplicationIdleHook()
+{
+}
+
 void StartSecPulse(unsigned portBASE_TYPE Priority)
 {
+#if !LINK_BUS
+	xTaskCreate(HC05Task, (signed portCHAR *)"HC05Task", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
+#endif
+	xTaskCreate(LinkTask, (signed portCHAR *)"LinkTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
 	xTaskCreate(AlarmOffTask, (signed portCHAR *)"AlarmOffTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
+	xTaskCreate(FSRTelemetryTask, (signed portCHAR *)"FSRTelemetryTask", configMINIMAL_STACK_SIZE, NULL, Priority, NULL );
 }	
  
 int main(void) 
@@ -151,8 +317,8 @@ int main(void)
 	DDRA = 0x00; PORTA = 0xFF;
    
    A2D_init();
-   initUSART(0);
-   USART_Flush(0);
+   Node_Init();
+   Link_Init();
    //Start Tasks  
    StartSecPulse(1);
     //RunSchedular 
@@ -0,0 +1,121 @@
+// Sensor node identity and bus access (sensor side).
+// Include after link.h and hc05.h.
+//
+// The node ID lives in EEPROM so the same firmware runs on every bed
+// sensor. Node_Send goes straight out on a point to point link; on the
+// shared bus frames wait in a small outbox and Node_Polled hands one over
+// each time the clock polls this node. The alarm flag in each poll also
+// acknowledges LINK_ALARM_OFF: it is answered again until the flag drops.
+
+#ifndef NODE_H
+#define NODE_H
+
+#include <avr/eeprom.h>
+
+#define NODE_TICK 10 // ms between link services; bounds the poll reply time
+#define NODE_OUTBOX 2 // frames waiting for a poll
+
+uint8_t EEMEM eeNodeId = 1; // Program 1 .. LINK_MAX_NODES per sensor
+
+struct NodeStats {
+	unsigned int polls;
+	unsigned int dropped; // frames lost to a full outbox
+};
+
+struct NodeStats nodeStats;
+
+#if LINK_BUS
+static struct LinkFrame nodeOutbox[NODE_OUTBOX];
+static unsigned char nodeOutHead;
+static unsigned char nodeOutCount;
+#endif
+static unsigned char nodeAlarmFlag; // LINK_POLL_ALARM in the last poll
+static unsigned char nodeUpSent; // LINK_ALARM_OFF went out for this alarm
+
+void Node_Init() {
+
+	unsigned char id = eeprom_read_byte(&eeNodeId);
+	if(id == LINK_BROADCAST || id > LINK_MAX_NODES) { // Blank or bad EEPROM
+		id = 1;
+	}
+	linkNodeId = id;
+}
+
+unsigned char Node_LinkUp() {
+
+#if LINK_BUS
+	return 1; // Wired, and polled whether or not anyone is listening
+#else
+	return HC05_LinkUp();
+#endif
+}
+
+void Node_Send(unsigned char type, const unsigned char *payload, unsigned char len) {
+
+#if LINK_BUS
+	struct LinkFrame *frame;
+	taskENTER_CRITICAL(); // Filled by several tasks, emptied by the link task
+	if(nodeOutCount >= NODE_OUTBOX) {
+		nodeStats.dropped++;
+		taskEXIT_CRITICAL();
+		return;
+	}
+	frame = &nodeOutbox[(nodeOutHead + nodeOutCount) % NODE_OUTBOX];
+	frame->addr = linkNodeId;
+	frame->type = type;
+	frame->len = len;
+	if(len) { // Empty frames come with no payload pointer
+		memcpy(frame->payload, payload, len);
+	}
+	nodeOutCount++;
+	taskEXIT_CRITICAL();
+#else
+	Link_Send(type, payload, len);
+#endif
+}
+
+// 1 once everything given to Node_Send has gone out. On the bus that is
+// when the outbox has emptied; a point to point frame goes out in Node_Send.
+unsigned char Node_Sent() {
+
+#if LINK_BUS
+	return !nodeOutCount;
+#else
+	return 1;
+#endif
+}
+
+// Answers a LINK_POLL for this node with the oldest waiting frame, or
+// LINK_IDLE. Returns 1 when the poll reports a newly sounding alarm.
+unsigned char Node_Polled(const struct LinkFrame *poll) {
+
+	unsigned char flags = poll->len ? poll->payload[0] : 0;
+	unsigned char rose = (flags & LINK_POLL_ALARM) && !nodeAlarmFlag;
+	nodeAlarmFlag = flags & LINK_POLL_ALARM;
+	if(!nodeAlarmFlag) {
+		nodeUpSent = 0;
+	}
+	nodeStats.polls++;
+#if LINK_BUS
+	if(nodeOutCount) {
+		struct LinkFrame *frame = &nodeOutbox[nodeOutHead];
+		Link_Send(frame->type, frame->payload, frame->len);
+		if(frame->type == LINK_ALARM_OFF) {
+			nodeUpSent = nodeAlarmFlag;
+		}
+		taskENTER_CRITICAL();
+		nodeOutHead = (nodeOutHead + 1) % NODE_OUTBOX;
+		nodeOutCount--;
+		taskEXIT_CRITICAL();
+	}
+	else if(nodeUpSent && !rose) { // The clock has not heard it yet
+		Link_Send(LINK_ALARM_OFF, 0, 0);
+	}
+	else {
+		Link_Send(LINK_IDLE, 0, 0);
+	}
+#endif
+	return rose;
+}
+
+#endif // NODE_H
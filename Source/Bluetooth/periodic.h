@@ -0,0 +1,76 @@
+// Fixed-rate task loops with deadline overrun counts.
+// Include after the FreeRTOS headers.
+//
+// A loop that does its work and then calls vTaskDelay(period) runs every
+// period plus however long the work took. Periodic_Wait sleeps until the
+// next deadline with vTaskDelayUntil instead, so the rate holds. A pass
+// that is still running at its next deadline has overrun: every deadline
+// it ran past is counted, and the loop picks up at the next deadline
+// still ahead rather than running the missed passes back to back.
+//
+// Each loop registers its struct Periodic in periodicTasks[] so the
+// counts can be read out with the other stats.
+
+#ifndef PERIODIC_H
+#define PERIODIC_H
+
+#define PERIODIC_MAX 8 // loops that can register
+
+struct Periodic {
+	const char *name;
+	portTickType period;
+	portTickType lastWake; // deadline of the pass in progress
+	unsigned int runs;
+	unsigned int overruns; // deadlines missed
+};
+
+struct Periodic *periodicTasks[PERIODIC_MAX];
+unsigned char periodicCount;
+
+void Periodic_Init(struct Periodic *p, const char *name, portTickType period) {
+
+	p->name = name;
+	p->period = period;
+	p->lastWake = xTaskGetTickCount();
+	p->runs = 0;
+	p->overruns = 0;
+	taskENTER_CRITICAL();
+	if(periodicCount < PERIODIC_MAX) {
+		periodicTasks[periodicCount++] = p;
+	}
+	taskEXIT_CRITICAL();
+}
+
+// Counts and skips the deadlines the pass in progress has run past.
+// Returns how many were skipped.
+static portTickType Periodic_Skip(struct Periodic *p, portTickType now) {
+
+	portTickType late = now - p->lastWake;
+	portTickType missed = 0;
+	p->runs++;
+	if(late > p->period) { // Equal is on time: the next pass starts now
+		missed = (late - 1) / p->period;
+		p->overruns += missed;
+		p->lastWake += missed * p->period;
+	}
+	return missed;
+}
+
+// Blocks until the next deadline. Returns the deadlines skipped.
+portTickType Periodic_Wait(struct Periodic *p) {
+
+	portTickType missed = Periodic_Skip(p, xTaskGetTickCount());
+	vTaskDelayUntil(&p->lastWake, p->period);
+	return missed;
+}
+
+// For loops that cannot block in vTaskDelayUntil (co-routines): moves to
+// the next deadline and returns the ticks left until it.
+portTickType Periodic_Delay(struct Periodic *p, portTickType now) {
+
+	Periodic_Skip(p, now);
+	p->lastWake += p->period;
+	return p->lastWake - now;
+}
+
+#endif // PERIODIC_H
@@ -0,0 +1,76 @@
+// FSR telemetry frame payload (LINK_FSR_FRAME). The same file is used by
+// both nodes: the sensor encodes, the clock decodes.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+/* Payload layout:
+   seq | count | first sample (16 bit, little endian) | count-1 deltas
+   Each delta is one signed byte. A step too large for a byte is sent as
+   TELEMETRY_ESCAPE followed by the absolute 16 bit sample. The ADC is
+   10 bit and the FSR changes slowly, so a 32 sample frame is normally
+   35 bytes instead of 64. */
+#define TELEMETRY_ESCAPE 0x80
+#define TELEMETRY_HEADER 4
+
+// Encodes count samples into payload, returns the payload length.
+// payload must hold TELEMETRY_HEADER + 3 * (count - 1) bytes worst case.
+unsigned char Telemetry_Encode(unsigned char seq, const uint16_t *samples, unsigned char count, unsigned char *payload) {
+	unsigned char len = TELEMETRY_HEADER;
+	unsigned char n;
+	int16_t delta;
+
+	payload[0] = seq;
+	payload[1] = count;
+	payload[2] = (unsigned char)(samples[0] & 0xFF);
+	payload[3] = (unsigned char)(samples[0] >> 8);
+	for(n = 1; n < count; n++) {
+		delta = (int16_t)(samples[n] - samples[n - 1]);
+		if(delta >= -127 && delta <= 127) {
+			payload[len++] = (unsigned char)(int8_t)delta;
+		}
+		else {
+			payload[len++] = TELEMETRY_ESCAPE;
+			payload[len++] = (unsigned char)(samples[n] & 0xFF);
+			payload[len++] = (unsigned char)(samples[n] >> 8);
+		}
+	}
+	return len;
+}
+
+// Decodes a payload into samples (at most max of them). Returns the number
+// of samples recovered, 0 if the payload is malformed.
+unsigned char Telemetry_Decode(const unsigned char *payload, unsigned char len, uint16_t *samples, unsigned char max) {
+	unsigned char count, pos, n;
+
+	if(len < TELEMETRY_HEADER) {
+		return 0;
+	}
+	count = payload[1];
+	if(count == 0 || count > max) {
+		return 0;
+	}
+	samples[0] = (uint16_t)payload[2] | ((uint16_t)payload[3] << 8);
+	pos = TELEMETRY_HEADER;
+	for(n = 1; n < count; n++) {
+		if(pos >= len) {
+			return 0;
+		}
+		if(payload[pos] == TELEMETRY_ESCAPE) {
+			if(pos + 2 >= len) {
+				return 0;
+			}
+			samples[n] = (uint16_t)payload[pos + 1] | ((uint16_t)payload[pos + 2] << 8);
+			pos += 3;
+		}
+		else {
+			samples[n] = (uint16_t)(samples[n - 1] + (int8_t)payload[pos]);
+			pos++;
+		}
+	}
+	return count;
+}
+
+#endif // TELEMETRY_H
@@ -0,0 +1,77 @@
+// Kernel trace hooks for the trace recorder in trace.h.
+//
+// FreeRTOSConfig.h turns the recorder on and includes this file at its end:
+//
+//	#define configUSE_TRACE_RECORDER 1
+//	#include "tracehooks.h"
+//
+// so the kernel's trace macros are defined before FreeRTOS.h fills in the
+// empty defaults. Each hook stores one record; tasks and queues are named
+// by a small number the recorder hands out when they are created.
+// Interrupt handlers mark themselves with TRACE_ISR_ENTER/TRACE_ISR_EXIT.
+// With the recorder off every hook here is empty.
+
+#ifndef TRACEHOOKS_H
+#define TRACEHOOKS_H
+
+#ifndef configUSE_TRACE_RECORDER
+#define configUSE_TRACE_RECORDER 0
+#endif
+
+/* Record types. Host/tracedump.c decodes them by number, so only add to
+   the end. */
+enum TraceType {
+	TR_SWITCH, // arg: task switched in
+	TR_TICK,
+	TR_DELAY, // the running task blocks in vTaskDelay or vTaskDelayUntil
+	TR_SEND, // arg: queue
+	TR_SEND_FAILED,
+	TR_RECEIVE,
+	TR_RECEIVE_FAILED,
+	TR_BLOCK_SEND, // the running task waits for space in the queue
+	TR_BLOCK_RECEIVE,
+	TR_ISR_ENTER, // arg: TRACE_ISR_*
+	TR_ISR_EXIT
+};
+
+#define TRACE_ISR_USART0_RX 1
+#define TRACE_ISR_PCINT0 2
+#define TRACE_ISR_TIMER2 3
+#define TRACE_ISR_EE_READY 4
+
+#if configUSE_TRACE_RECORDER == 1
+
+void vTraceRecord(unsigned char type, unsigned char arg);
+void vTraceSwitch(const void *task);
+unsigned char ucTraceObject(const void *object, const char *name);
+
+#define TRACE_ISR_ENTER(isr) vTraceRecord(TR_ISR_ENTER, (isr))
+#define TRACE_ISR_EXIT(isr) vTraceRecord(TR_ISR_EXIT, (isr))
+
+#define traceTASK_CREATE(pxNewTCB) ucTraceObject((pxNewTCB), (const char *)(pxNewTCB)->pcTaskName)
+#define traceTASK_SWITCHED_IN() vTraceSwitch((const void *)pxCurrentTCB)
+#define traceTASK_INCREMENT_TICK(xTickCount) vTraceRecord(TR_TICK, 0)
+#define traceTASK_DELAY() vTraceRecord(TR_DELAY, 0)
+#define traceTASK_DELAY_UNTIL() vTraceRecord(TR_DELAY, 0)
+
+#define traceQUEUE_CREATE(pxNewQueue) ucTraceObject((pxNewQueue), 0)
+#define traceCREATE_MUTEX(pxNewQueue) ucTraceObject((pxNewQueue), 0)
+#define traceQUEUE_SEND(pxQueue) vTraceRecord(TR_SEND, ucTraceObject((pxQueue), 0))
+#define traceQUEUE_SEND_FAILED(pxQueue) vTraceRecord(TR_SEND_FAILED, ucTraceObject((pxQueue), 0))
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) vTraceRecord(TR_SEND, ucTraceObject((pxQueue), 0))
+#define traceQUEUE_SEND_FROM_ISR_FAILED(pxQueue) vTraceRecord(TR_SEND_FAILED, ucTraceObject((pxQueue), 0))
+#define traceQUEUE_RECEIVE(pxQueue) vTraceRecord(TR_RECEIVE, ucTraceObject((pxQueue), 0))
+#define traceQUEUE_RECEIVE_FAILED(pxQueue) vTraceRecord(TR_RECEIVE_FAILED, ucTraceObject((pxQueue), 0))
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) vTraceRecord(TR_RECEIVE, ucTraceObject((pxQueue), 0))
+#define traceQUEUE_RECEIVE_FROM_ISR_FAILED(pxQueue) vTraceRecord(TR_RECEIVE_FAILED, ucTraceObject((pxQueue), 0))
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue) vTraceRecord(TR_BLOCK_SEND, ucTraceObject((pxQueue), 0))
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue) vTraceRecord(TR_BLOCK_RECEIVE, ucTraceObject((pxQueue), 0))
+
+#else
+
+#define TRACE_ISR_ENTER(isr)
+#define TRACE_ISR_EXIT(isr)
+
+#endif // configUSE_TRACE_RECORDER
+
+#endif // TRACEHOOKS_H
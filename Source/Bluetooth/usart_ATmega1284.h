@@ -10,6 +10,75 @@
 #define BAUD_RATE 115200
 #define BAUD_PRESCALE (((F_CPU / (BAUD_RATE * 16UL))) - 1)
 
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Computes the double speed (U2X) divisor for a baud rate
+//Parameter: baud is the rate in bits per second
+//Returns: UBRR value, rounded to the nearest divisor
+unsigned int USART_BaudDivisor(unsigned long baud)
+{
+	unsigned long ubrr = ((F_CPU / 4UL / baud) + 1UL) / 2UL;
+	return (ubrr > 0) ? (unsigned int)(ubrr - 1) : 0;
+}
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Rate error of a baud rate in double speed mode
+//Parameter: baud is the rate in bits per second
+//Returns: Error in tenths of a percent
+unsigned int USART_BaudError(unsigned long baud)
+{
+	unsigned long actual = F_CPU / (8UL * (USART_BaudDivisor(baud) + 1UL));
+	unsigned long diff = (actual > baud) ? actual - baud : baud - actual;
+	return (unsigned int)((diff * 1000UL) / baud);
+}
+
+#ifdef HOST_SIM
+////////////////////////////////////////////////////////////////////////////////
+// Host build: the data register and status flags live in the link simulator
+// (Host/sim_node.c). The functions keep the same names and semantics as the
+// register versions below, including TXC staying set once a byte has gone out.
+unsigned char host_usart_status(unsigned char usartNum);
+void host_usart_write(unsigned char usartNum, unsigned char data);
+unsigned char host_usart_read(unsigned char usartNum);
+void host_usart_baud(unsigned char usartNum, unsigned long baud);
+
+void initUSART(unsigned char usartNum)
+{
+	if (usartNum != 1) {
+		UCSR0B |= (1 << RXEN0)  | (1 << TXEN0);
+	}
+	else {
+		UCSR1B |= (1 << RXEN1)  | (1 << TXEN1);
+	}
+}
+unsigned char USART_IsSendReady(unsigned char usartNum)
+{
+	return host_usart_status(usartNum) & (1 << UDRE0);
+}
+unsigned char USART_HasTransmitted(unsigned char usartNum)
+{
+	return host_usart_status(usartNum) & (1 << TXC0);
+}
+unsigned char USART_HasReceived(unsigned char usartNum)
+{
+	return host_usart_status(usartNum) & (1 << RXC0);
+}
+void USART_Flush(unsigned char usartNum)
+{
+	while (host_usart_status(usartNum) & (1 << RXC0)) { host_usart_read(usartNum); }
+}
+void USART_Send(unsigned char sendMe, unsigned char usartNum)
+{
+	host_usart_write(usartNum, sendMe);
+}
+unsigned char USART_Receive(unsigned char usartNum)
+{
+	return host_usart_read(usartNum);
+}
+void USART_SetBaud(unsigned long baud, unsigned char usartNum)
+{
+	host_usart_baud(usartNum, baud);
+}
+#else
+
 ////////////////////////////////////////////////////////////////////////////////
 //Functionality - Initializes TX and RX on PORT D
 //Parameter: usartNum specifies which USART is being initialized
@@ -112,5 +181,29 @@ unsigned char USART_Receive(unsigned char usartNum)
 		return UDR1;
 	}
 }
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Changes the baud rate, switching to double speed mode for
+//			 a smaller rounding error at 8MHz
+//Parameter: baud is the new rate in bits per second
+//			 usartNum specifies which USART is changed
+//Returns: None
+void USART_SetBaud(unsigned long baud, unsigned char usartNum)
+{
+	unsigned int ubrr = USART_BaudDivisor(baud);
+	if (usartNum != 1) {
+		while ( !(UCSR0A & (1 << UDRE0)) ); // Let a byte in progress finish
+		UCSR0A |= (1 << U2X0);
+		UBRR0H = (ubrr >> 8);
+		UBRR0L = ubrr;
+	}
+	else {
+		while ( !(UCSR1A & (1 << UDRE1)) );
+		UCSR1A |= (1 << U2X1);
+		UBRR1H = (ubrr >> 8);
+		UBRR1L = ubrr;
+	}
+}
+
+#endif /* HOST_SIM */
 
 #endif /* USART_ATMEGA1284_H_ */
\ No newline at end of file
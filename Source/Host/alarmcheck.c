@@ -0,0 +1,382 @@
+/* Alarm schedule check
+   Loads a host build of the clock (Alarm1.c built with HOST_SIM, as for
+   coresim) and runs the alarm code of alarm.h over every minute of the
+   day, in 12 and in 24 hour mode, through the same calls the state
+   machines make: the time goes into the DS3231 stand-in in that mode's
+   register layout and UpdateTime reads it back, the alarm is set with
+   Alarm_Set, and Alarm_Left gives the minutes left to the alarm
+   clockState publishes, which the AlarmOn and SpeakerOn guards compare
+   with its lead and 0.
+
+     hours    every time shows as 1-12 AM/PM or 0-23, and reads back
+     set      an alarm set at any minute rings at its next occurrence,
+              tomorrow if it has gone by today: 1440 x 1440 pairs
+     day      an alarm set at midnight counts down through the day and,
+              once gone by without ringing, waits for the next day
+     days     an alarm for one day of the week, set on any day, waits
+              for that day, Saturday to Sunday included
+     table    a week, minute by minute, of all ALARM_MAX alarms being set,
+              cleared, started and finished at random: alarmOrder holds
+              every alarm that is on, sorted by next time, each next time
+              is the first from now on, and the alarm published is the
+              one whose lead starts it first; after every UpdateTime the
+              DS3231's Alarm 1 holds the published alarm's next time in
+              day of the week mode, with its interrupt on, or is off, and
+              the chip pulls INT/SQW low when the time gets there, also
+              when it was left in the 12 hour layout
+
+   For every alarm it also counts the minutes the near and ring guards
+   hold, which must be 11 and 1 whatever the alarm, midnight included.
+   Prints a line per check and the first mismatches; exits 1 on any.
+   Build with  gcc -O2 -o alarmcheck Host/alarmcheck.c -ldl
+   and run     alarmcheck clock.so */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <dlfcn.h>
+
+#define DAY 1440U
+#define WEEK (7U * DAY)
+#define NONE 0xFFFF
+#define NO_ID 0xFF
+#define NEAR 10 // ALARM_NEAR
+#define EVERY_DAY 0x7F
+#define MAX_ALARMS 16 // ALARM_MAX
+#define LEAD_MAX 60 // ALARM_LEAD_MAX
+#define SHOW_ERRORS 5
+#define RTC_INT 0x40 // PINA, the DS3231's alarm output (sim_node.c)
+#define RTC_KEEP 2 // SIM_RTC_KEEP, the hour register stays in the layout it is in
+
+/* The clock's struct ClockState (clockstate.h) */
+struct ClockState {
+	uint8_t hour, minute, second, weekday;
+	unsigned char hourMode, alarmId, alarmLead;
+	unsigned int alarmMinute, alarmNext;
+};
+
+/* The clock's struct Alarm (alarm.h) */
+struct Alarm {
+	unsigned int minute;
+	unsigned char days, lead, melody, sleepers, on;
+	unsigned int next;
+};
+
+static void (*setTime)(uint8_t, uint8_t, uint8_t, unsigned char);
+static void (*setDay)(uint8_t);
+static void (*updateTime)(void);
+static void (*alarmSet)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char);
+static unsigned char (*alarmStart)(void);
+static void (*alarmDone)(void);
+static unsigned int (*alarmLeft)(const struct ClockState *);
+static uint8_t (*showHour)(uint8_t, unsigned char, unsigned char *);
+static uint8_t (*hour24)(uint8_t, unsigned char);
+static void (*rtcAlarm1)(uint8_t *, uint8_t *);
+static volatile uint8_t *pina;
+static struct ClockState *clockState;
+static struct Alarm *alarms;
+static unsigned char *alarmOrder, *alarmCount;
+static unsigned long errors;
+static unsigned long seed = 1;
+
+static void *Sym(void *so, const char *name) {
+	void *p = dlsym(so, name);
+	if(!p) {
+		fprintf(stderr, "alarmcheck: missing symbol %s\n", name);
+		exit(2);
+	}
+	return p;
+}
+
+static void Mismatch(const char *check, unsigned mode, unsigned alarm, unsigned now, unsigned got, unsigned want) {
+	if(errors++ < SHOW_ERRORS) {
+		fprintf(stderr, "alarmcheck: %s, %u hour mode, alarm %02u:%02u at %02u:%02u: got %u, want %u\n",
+			check, mode ? 24 : 12, alarm / 60, alarm % 60, now / 60, now % 60, got, want);
+	}
+}
+
+// Sets the DS3231 to minute of the day and has the clock read it
+static void Now(unsigned minute, unsigned mode) {
+	setTime(minute / 60, minute % 60, 0, mode);
+	updateTime();
+}
+
+static void Report(const char *check, unsigned long cases, unsigned long before) {
+	printf("%-6s %8lu cases  %s\n", check, cases, errors == before ? "ok" : "FAILED");
+}
+
+static void Hours(void) {
+	unsigned long before = errors;
+	unsigned mode, n, shown;
+	unsigned char pm;
+	for(mode = 0; mode < 2; mode++) {
+		clockState->hourMode = mode;
+		for(n = 0; n < DAY; n++) {
+			shown = showHour(n / 60, mode, &pm);
+			if(mode ? shown != n / 60 : (shown < 1 || shown > 12 || pm != (n >= 720) || hour24(shown, pm) != n / 60)) {
+				Mismatch("hours, shown", mode, 0, n, shown, n / 60);
+			}
+			Now(n, mode);
+			if(clockState->hour * 60U + clockState->minute != n) {
+				Mismatch("hours, read back", mode, 0, n, clockState->hour * 60U + clockState->minute, n);
+			}
+		}
+	}
+	Report("hours", 2UL * DAY, before);
+}
+
+static void Set(void) {
+	unsigned long before = errors;
+	unsigned mode, a, n, left, want, near, ring;
+	for(mode = 0; mode < 2; mode++) {
+		clockState->hourMode = mode;
+		for(a = 0; a < DAY; a++) {
+			near = ring = 0;
+			for(n = 0; n < DAY; n++) {
+				Now(n, mode);
+				alarmSet(0, a, EVERY_DAY, NEAR, 0, 0);
+				left = alarmLeft(clockState);
+				want = (a + DAY - n) % DAY;
+				if(left != want) {
+					Mismatch("set", mode, a, n, left, want);
+				}
+				near += left <= NEAR;
+				ring += left == 0;
+			}
+			if(near != NEAR + 1 || ring != 1) {
+				Mismatch("set, minutes near", mode, a, 0, near, NEAR + 1);
+			}
+		}
+	}
+	Report("set", 2UL * DAY * DAY, before);
+}
+
+static void Day(void) {
+	unsigned long before = errors;
+	unsigned mode, a, n, left, want;
+	for(mode = 0; mode < 2; mode++) {
+		clockState->hourMode = mode;
+		for(a = 0; a < DAY; a++) {
+			Now(0, mode);
+			alarmSet(0, a, EVERY_DAY, NEAR, 0, 0);
+			for(n = 0; n < DAY; n++) {
+				Now(n, mode);
+				left = alarmLeft(clockState);
+				want = n <= a ? a - n : DAY - (n - a);
+				if(left != want) {
+					Mismatch("day", mode, a, n, left, want);
+				}
+			}
+		}
+	}
+	Report("day", 2UL * DAY * DAY, before);
+}
+
+static void Days(void) {
+	static const unsigned times[] = {0, 5, 719, 720, 1435, DAY - 1};
+	unsigned long before = errors, cases = 0;
+	unsigned mode, today, day, k, n, left;
+	long want;
+	for(mode = 0; mode < 2; mode++) {
+		clockState->hourMode = mode;
+		for(today = 0; today < 7; today++) {
+			setDay(today + 1);
+			for(day = 0; day < 7; day++) {
+				for(k = 0; k < sizeof(times) / sizeof(times[0]); k++) {
+					for(n = 0; n < DAY; n++) {
+						Now(n, mode);
+						alarmSet(0, times[k], 1 << day, NEAR, 0, 0);
+						left = alarmLeft(clockState);
+						want = ((day + 7 - today) % 7) * (long)DAY + times[k] - n;
+						if(want < 0) {
+							want += WEEK;
+						}
+						if(left != want) {
+							Mismatch("days", mode, times[k] + day * DAY, n + today * DAY, left, want);
+						}
+						cases++;
+					}
+				}
+			}
+		}
+	}
+	setDay(1);
+	alarmSet(0, NONE, 0, 0, 0, 0);
+	if(alarmLeft(clockState) != NONE) {
+		Mismatch("days, cleared", 0, 0, 0, alarmLeft(clockState), NONE);
+	}
+	Report("days", cases, before);
+}
+
+static unsigned Random(unsigned range) {
+	seed = seed * 1103515245UL + 12345UL;
+	return (seed >> 16) % range;
+}
+
+// Minutes from minute 'now' of the week to the next time alarm a rings,
+// the nearest of its days
+static unsigned Until(const struct Alarm *a, unsigned now) {
+	unsigned day, at, best = NONE;
+	for(day = 0; day < 7; day++) {
+		if(((a->days ? a->days : EVERY_DAY) >> day) & 1) {
+			at = (day * DAY + a->minute + WEEK - now) % WEEK;
+			if(at < best) {
+				best = at;
+			}
+		}
+	}
+	return best;
+}
+
+// Sets the DS3231 to minute of the week and has the clock read it
+static void NowInWeek(unsigned minute, unsigned mode) {
+	setDay(minute / DAY + 1);
+	Now(minute % DAY, mode);
+}
+
+// Checks the table against minute 'now' of the week
+static void TableCheck(unsigned mode, unsigned now) {
+	unsigned n, id, on = 0, seen = 0, left;
+	long start, best = 0x7FFFFFFFL;
+	for(id = 0; id < MAX_ALARMS; id++) {
+		if(!alarms[id].on) {
+			continue;
+		}
+		on++;
+		left = (alarms[id].next + WEEK - now) % WEEK;
+		if(left != Until(&alarms[id], now)) {
+			Mismatch("table, next time", mode, alarms[id].minute, now % DAY, left, Until(&alarms[id], now));
+		}
+		start = (long)left - alarms[id].lead;
+		if(start < best) {
+			best = start;
+		}
+	}
+	for(n = 0; n < *alarmCount; n++) {
+		seen |= 1U << alarmOrder[n];
+		if(n && alarms[alarmOrder[n]].next < alarms[alarmOrder[n - 1]].next) {
+			Mismatch("table, order", mode, alarms[alarmOrder[n]].minute, now % DAY, n, 0);
+		}
+	}
+	for(id = 0; id < MAX_ALARMS; id++) {
+		if(alarms[id].on != ((seen >> id) & 1)) {
+			Mismatch("table, listed", mode, alarms[id].minute, now % DAY, (seen >> id) & 1, alarms[id].on);
+		}
+	}
+	if(*alarmCount != on) {
+		Mismatch("table, count", mode, 0, now % DAY, *alarmCount, on);
+	}
+	if(on ? clockState->alarmId >= MAX_ALARMS || (long)alarmLeft(clockState) - clockState->alarmLead != best :
+		clockState->alarmId != NO_ID) {
+		Mismatch("table, published", mode, clockState->alarmMinute % DAY, now % DAY, alarmLeft(clockState),
+			on ? (unsigned)(best + clockState->alarmLead) : NONE);
+	}
+}
+
+static unsigned Bcd(uint8_t b) {
+	return (b >> 4) * 10 + (b & 0x0F);
+}
+
+// Alarm 1 holds the published alarm, as UpdateTime left it
+static void RtcCheck(unsigned mode, unsigned now) {
+	uint8_t regs[4], control;
+	unsigned at, next = clockState->alarmNext;
+	rtcAlarm1(regs, &control);
+	if(next == NONE) {
+		if(control & 0x01) {
+			Mismatch("table, DS3231 alarm off", mode, 0, now % DAY, 1, 0);
+		}
+		return;
+	}
+	at = ((regs[3] & 0x07) - 1) * DAY + Bcd(regs[2]) * 60 + Bcd(regs[1]);
+	if(!(control & 0x01) || regs[0] != 0 || (regs[3] & 0xC0) != 0x40 || at != next) {
+		Mismatch("table, DS3231 alarm", mode, clockState->alarmMinute % DAY, now % DAY, at, next);
+	}
+}
+
+// The chip reaches minute 'now' of the week and raises its alarm if Alarm
+// 1 holds it, before UpdateTime reads the time
+static void RingCheck(unsigned mode, unsigned now) {
+	uint8_t regs[4], control;
+	rtcAlarm1(regs, &control);
+	setDay(now / DAY + 1);
+	setTime((now % DAY) / 60, now % 60, 0, RTC_KEEP);
+	if((control & 0x01) && ((regs[3] & 0x07) - 1) * DAY + Bcd(regs[2]) * 60 + Bcd(regs[1]) == now && (*pina & RTC_INT)) {
+		Mismatch("table, DS3231 alarm raised", mode, clockState->alarmMinute % DAY, now % DAY, 0, 1);
+	}
+	updateTime();
+}
+
+static void Table(void) {
+	unsigned long before = errors, cases = 0;
+	unsigned mode, t, id, ringing;
+	for(mode = 0; mode < 2; mode++) {
+		clockState->hourMode = mode;
+		NowInWeek(0, mode); // Left in this mode's layout, which UpdateTime makes 24 hours
+		for(id = 0; id < MAX_ALARMS; id++) {
+			alarmSet(id, NONE, 0, 0, 0, 0);
+		}
+		for(t = 0; t < WEEK; t++) {
+			RingCheck(mode, t);
+			RtcCheck(mode, t);
+			if(Random(4) == 0) {
+				alarmSet(Random(MAX_ALARMS), Random(5) ? Random(DAY) : NONE, Random(3) ? Random(128) : 0,
+					Random(LEAD_MAX + 10), 0, 0);
+			}
+			TableCheck(mode, t);
+			if(clockState->alarmId != NO_ID && alarmLeft(clockState) == 0 && Random(2)) {
+				/* Ring it for a few minutes, as AlarmOn does */
+				id = alarmStart();
+				for(ringing = 1 + Random(5); ringing && t + 1 < WEEK; ringing--) {
+					NowInWeek(++t, RTC_KEEP);
+					if(clockState->alarmId != id) {
+						Mismatch("table, stays published", mode, clockState->alarmMinute % DAY, t % DAY, clockState->alarmId, id);
+					}
+					cases++;
+				}
+				alarmDone();
+				TableCheck(mode, t);
+			}
+			cases++;
+		}
+	}
+	for(id = 0; id < MAX_ALARMS; id++) {
+		alarmSet(id, NONE, 0, 0, 0, 0);
+	}
+	Report("table", cases, before);
+}
+
+int main(int argc, char **argv) {
+	void *so;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s clock.so\n", argv[0]);
+		return 2;
+	}
+	if(!(so = dlopen(argv[1], RTLD_LAZY | RTLD_LOCAL))) {
+		fprintf(stderr, "alarmcheck: %s\n", dlerror());
+		return 2;
+	}
+	setTime = (void (*)(uint8_t, uint8_t, uint8_t, unsigned char))Sym(so, "sim_set_time");
+	setDay = (void (*)(uint8_t))Sym(so, "sim_set_day");
+	updateTime = (void (*)(void))Sym(so, "UpdateTime");
+	alarmSet = (void (*)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char))
+		Sym(so, "Alarm_Set");
+	alarmStart = (unsigned char (*)(void))Sym(so, "Alarm_Start");
+	alarmDone = (void (*)(void))Sym(so, "Alarm_Done");
+	alarmLeft = (unsigned int (*)(const struct ClockState *))Sym(so, "Alarm_Left");
+	showHour = (uint8_t (*)(uint8_t, unsigned char, unsigned char *))Sym(so, "Clock_ShowHour");
+	hour24 = (uint8_t (*)(uint8_t, unsigned char))Sym(so, "Clock_Hour24");
+	rtcAlarm1 = (void (*)(uint8_t *, uint8_t *))Sym(so, "sim_rtc_alarm1");
+	pina = Sym(so, "PINA");
+	clockState = Sym(so, "clockState");
+	alarms = Sym(so, "alarms");
+	alarmOrder = Sym(so, "alarmOrder");
+	alarmCount = Sym(so, "alarmCount");
+
+	Hours();
+	Set();
+	Day();
+	Days();
+	Table();
+	return errors != 0;
+}
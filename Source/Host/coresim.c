@@ -0,0 +1,764 @@
+/* Wakeup and idle time of the clock's application core
+   Loads one or more builds of the clock (Alarm1.c) as host shared objects
+   and runs each through the same simulated hour: the alarm fires, the
+   sleeper gets up three minutes later, then a new alarm is set from the
+   buttons. A build made with APP_EVENTS=0 runs its six polling tasks at
+   their vTaskDelay periods; an event build is driven the way EventTask
+   drives it, waking only for a queued event or when App_Timeout expires.
+
+   Idle time comes from a cycle model at 8 MHz, not a measurement: a
+   task wakeup (tick unblock, two context switches and a short state
+   machine pass) costs CYCLES_PER_WAKE, a full LCD redraw its busy-waits,
+   and the 1 kHz tick interrupt is charged in every build. LinkTask runs
+   every LINK_PERIOD in both cores and is charged as a wakeup.
+
+   In the event core the buttons are the pin change interrupt and the
+   timer 2 scans that debounce them (events.h), run every BUTTON_SCAN ms
+   while timer 2 is on. The same interrupt takes the DS3231's alarm
+   output, which the stand-in in sim_node.c pulls low at the alarm
+   (rtcalarm.h).
+
+   The tickless column charges the same work without the tick. The kernel
+   then wakes only when a task unblocks, an interrupt arrives (a button
+   interrupt in the event core), or the stretched Timer1 period runs out
+   after MAX_SUPPRESSED_TICKS; each of those costs CYCLES_PER_SLEEP for
+   the idle task's sleep and the tick step on the way out (port.c).
+
+   With -j a polling build and an APP_SYNC_SM build are run under their
+   two execution engines instead, to compare when each state machine
+   actually gets to run. The polling build has seven tasks of equal
+   priority, time sliced every tick, each waiting for its next deadline
+   as Periodic_Wait does (periodic.h) and skipping the deadlines an
+   overrun ran past. In the APP_SYNC_SM build the real SyncSMTask runs,
+   in a context of its own: coresim puts itself in each machine's place
+   in syncSMs[] to time it, and the host vTaskDelayUntil (sim_node.c)
+   blocks it until its next pass. LinkTask time slices with it in both
+   builds; it is charged a wakeup but not run. Work takes the time the
+   cycle model gives it, so an LCD redraw holds the CPU for ~37 ms. For
+   each machine the table lists the mean interval between ticks, the
+   worst deviation from the period and the deadlines missed, and the task
+   RAM of each engine at AVR sizes.
+
+   With -s each polling state machine's Init and Tick run on a stack of
+   their own, filled with 0xa5 the way the kernel fills a task stack, for
+   the whole hour, and the table shows how deep each one went. These are
+   host bytes: they check the bound Host/stacksize works out for the same
+   host build rather than size the AVR stacks.
+   See README.md in this directory for build instructions. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <ucontext.h>
+
+#define SIM_HOUR_MS 3600000UL
+#define F_CPU_HZ 8000000.0
+#define CYCLES_PER_WAKE 700.0
+#define CYCLES_PER_REDRAW 300000.0 // clear + ~12 cursor/data writes, 1-2 ms each
+#define CYCLES_PER_TICK 250.0
+#define CYCLES_PER_SLEEP 600.0
+#define LINK_PERIOD 20 // LINKMON_TICK
+#define MAX_SUPPRESSED_TICKS 524 // port.c, 8 MHz and prescaler 64
+#define CYCLES_PER_CALL 150.0 // one machine ticked inside a table pass
+#define STACK_BYTES 85 // configMINIMAL_STACK_SIZE
+#define TCB_BYTES 33 // V7.1.1 tskTCB on AVR, 8 character names
+#define SYNC_SM_BYTES 8 // one struct SyncSM
+#define SIM_STACK 65536 // host bytes per machine with -s, and for SyncSMTask
+#define STACK_FILL 0xa5 // tskSTACK_FILL_BYTE
+#define BUTTON_SCAN 10 // events.h
+
+/* The clock's struct ClockState (clockstate.h) */
+struct ClockState {
+	uint8_t hour, minute, second, weekday;
+	unsigned char hourMode, alarmId, alarmLead;
+	unsigned int alarmMinute, alarmNext;
+};
+
+/* Leading fields of the clock's struct EventStats (events.h) */
+struct CoreStats {
+	unsigned long wakeups;
+	unsigned long redraws;
+};
+
+struct Event {
+	unsigned char type;
+	unsigned char arg;
+};
+
+/* The polling tasks of StartSecPulse with APP_EVENTS=0 */
+static const struct {
+	const char *init, *tick;
+	unsigned period;
+} pollTasks[] = {
+	{"DisplayTime_Init", "DisplayTime_Tick", 200},
+	{"SetAlarm_Init", "SetAlarm_Tick", 50},
+	{"SetTime_Init", "SetTime_Tick", 50},
+	{"LEDPWM_Init", "LEDPWM_Tick", 200},
+	{"AlarmOn_Init", "AlarmOn_Tick", 1000},
+	{"SpeakerOn_Init", "SpeakerOn_Tick", 500},
+};
+#define POLL_TASKS (sizeof(pollTasks) / sizeof(pollTasks[0]))
+#define JITTER_SMS (POLL_TASKS + 1) // and LinkTask, charged but not run
+#define SYNC_TASK JITTER_SMS // the ready list's number for SyncSMTask
+
+#define RTC_INT 0x40 // PINA, the DS3231's alarm output (sim_node.c)
+#define RTC_KEEP 2 // SIM_RTC_KEEP, the hour register stays in the layout it is in
+
+/* Button script, ms from 6:00:00. PINA bits are active low. */
+static const struct {
+	unsigned long at;
+	unsigned char down; // buttons held from here on
+} buttons[] = {
+	{2400000, 0x04}, {2400200, 0}, // LEFT: set alarm
+	{2402000, 0x10}, {2402150, 0}, {2402500, 0x10}, {2402650, 0}, // UP taps
+	{2403000, 0x10}, {2403150, 0}, {2403500, 0x10}, {2403650, 0},
+	{2404000, 0x10}, {2404150, 0}, {2404500, 0x10}, {2404650, 0},
+	{2405000, 0x10}, {2405150, 0}, {2405500, 0x10}, {2405650, 0},
+	{2406000, 0x10}, {2406150, 0}, {2406500, 0x10}, {2406650, 0},
+	{2408000, 0x20}, {2410000, 0}, // DOWN held 2 s
+	{2412000, 0x04}, {2412200, 0}, // LEFT: save
+};
+#define SLEEPER_UP_MS 1980000UL // 6:33:00
+
+struct CoreResult {
+	int events;
+	unsigned long wakeups;
+	unsigned long redraws;
+	unsigned long linkWakes;
+	unsigned long sleeps; // tickless: times the kernel woke from sleep
+	int rang, quiet;
+	unsigned saveHour, saveMin;
+};
+
+/* The clock's struct SyncSM (Alarm1.c, APP_SYNC_SM) */
+struct SyncSM {
+	void (*init)(void);
+	void (*tick)(void);
+	unsigned int period;
+	unsigned int elapsedTime;
+};
+
+struct JitterResult {
+	unsigned sms; // machines in syncSMs[], for the table's RAM
+	unsigned long ticks[JITTER_SMS];
+	double sumInterval[JITTER_SMS]; // ms
+	double maxDeviation[JITTER_SMS]; // ms
+	unsigned long overruns[JITTER_SMS];
+};
+
+static void *Sym(void *so, const char *name) {
+	void *p = dlsym(so, name);
+	if(!p) {
+		fprintf(stderr, "coresim: missing symbol %s\n", name);
+		exit(2);
+	}
+	return p;
+}
+
+/* The event core's pin change interrupt, on either edge of the DS3231's
+   alarm output. Returns 1 if it ran. */
+static int RtcEdge(volatile uint8_t *pina, volatile uint8_t *pcmsk0, unsigned char *last, void (*pcint)(void)) {
+	unsigned char now = *pina & RTC_INT;
+	if(now == *last) {
+		return 0;
+	}
+	*last = now;
+	if(!(*pcmsk0 & RTC_INT)) {
+		return 0;
+	}
+	pcint();
+	return 1;
+}
+
+static struct CoreResult RunCore(const char *path) {
+	struct CoreResult r;
+	void *so = dlopen(path, RTLD_LAZY | RTLD_LOCAL);
+	void (*setTicks)(unsigned long);
+	void (*setTime)(uint8_t, uint8_t, uint8_t, unsigned char);
+	void (*pcint)(void);
+	void (*scan)(void);
+	void (*appDue)(void);
+	void (*appDispatch)(const struct Event *);
+	unsigned short (*appTimeout)(void);
+	signed char (*queueReceive)(void *, void *, unsigned short);
+	unsigned char (*queueWaiting)(void *);
+	unsigned char (*eventPost)(unsigned char, unsigned char);
+	void (*ticks[POLL_TASKS])(void);
+	volatile uint8_t *pina, *pcmsk0, *tccr2b;
+	void (*alarmSet)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char);
+	uint8_t *alarmOnFlag, *alarmOffSignal;
+	struct ClockState *clockState;
+	struct CoreStats *stats;
+	void **eventQueue;
+	unsigned long t, wakeAt = 0, second = 6 * 3600UL, woke = 0, scanAt = 0;
+	unsigned k, b = 0;
+	unsigned char rtcPin = RTC_INT;
+	int due;
+
+	memset(&r, 0, sizeof(r));
+	if(!so) {
+		fprintf(stderr, "coresim: %s\n", dlerror());
+		exit(2);
+	}
+	setTicks = (void (*)(unsigned long))Sym(so, "sim_set_ticks");
+	setTime = (void (*)(uint8_t, uint8_t, uint8_t, unsigned char))Sym(so, "sim_set_time");
+	stats = Sym(so, "eventStats");
+	pina = Sym(so, "PINA");
+	clockState = Sym(so, "clockState");
+	alarmSet = (void (*)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char))Sym(so, "Alarm_Set");
+	alarmOnFlag = Sym(so, "alarmOnFlag");
+	alarmOffSignal = Sym(so, "alarmOffSignal");
+	appDue = (void (*)(void))dlsym(so, "App_Due");
+	r.events = appDue != NULL;
+
+	*pina = 0xFF;
+	setTime(6, 0, 0, 0);
+	alarmSet(0, 6 * 60 + 30, 0, 10, 0, 0); // 6:30 AM once, as the buttons set it
+	setTicks(0);
+
+	if(r.events) {
+		appDispatch = (void (*)(const struct Event *))Sym(so, "App_Dispatch");
+		appTimeout = (unsigned short (*)(void))Sym(so, "App_Timeout");
+		queueReceive = (signed char (*)(void *, void *, unsigned short))Sym(so, "xQueueReceive");
+		queueWaiting = (unsigned char (*)(void *))Sym(so, "uxQueueMessagesWaiting");
+		eventPost = (unsigned char (*)(unsigned char, unsigned char))Sym(so, "Event_Post");
+		pcint = (void (*)(void))Sym(so, "PCINT0_vect");
+		scan = (void (*)(void))Sym(so, "TIMER2_COMPA_vect");
+		pcmsk0 = Sym(so, "PCMSK0");
+		tccr2b = Sym(so, "TCCR2B");
+		eventQueue = Sym(so, "eventQueue");
+		((void (*)(void))Sym(so, "Event_Init"))();
+		((void (*)(void))Sym(so, "App_Init"))();
+	}
+	else {
+		for(k = 0; k < POLL_TASKS; k++) {
+			((void (*)(void))Sym(so, pollTasks[k].init))();
+			ticks[k] = (void (*)(void))Sym(so, pollTasks[k].tick);
+		}
+	}
+
+	for(t = 0; t < SIM_HOUR_MS; t++) {
+		setTicks(t);
+		due = t % LINK_PERIOD == 0;
+		if(t % 1000 == 0) {
+			setTime((second / 3600) % 24, (second / 60) % 60, second % 60, RTC_KEEP);
+			second++;
+		}
+		if(r.events && RtcEdge(pina, pcmsk0, &rtcPin, pcint)) { // Alarm 1 reached
+			due = 1;
+		}
+		if(t == SLEEPER_UP_MS) { // What Link_Service does on LINK_ALARM_OFF
+			*alarmOffSignal = 1;
+			if(r.events) {
+				eventPost(1, 0); // EV_SLEEPER_UP
+			}
+		}
+		if(b < sizeof(buttons) / sizeof(buttons[0]) && buttons[b].at == t) {
+			unsigned char pins = (*pina & RTC_INT) | (0xFF & ~RTC_INT & ~buttons[b].down);
+			unsigned char moved = *pina ^ pins;
+			*pina = pins;
+			if(r.events && (moved & *pcmsk0)) {
+				if(!*tccr2b) {
+					scanAt = t + BUTTON_SCAN;
+				}
+				pcint();
+				due = 1;
+			}
+			b++;
+		}
+		if(r.events && *tccr2b && t == scanAt) {
+			scan();
+			scanAt += BUTTON_SCAN;
+			due = 1;
+		}
+		if(*alarmOnFlag) {
+			r.rang = 1;
+		}
+
+		if(r.events) {
+			if(queueWaiting(*eventQueue) || t >= wakeAt) {
+				struct Event ev;
+				if(queueReceive(*eventQueue, &ev, 0)) {
+					appDispatch(&ev);
+				}
+				appDue();
+				stats->wakeups++;
+				wakeAt = t + appTimeout();
+				due = 1;
+			}
+		}
+		else {
+			for(k = 0; k < POLL_TASKS; k++) {
+				if(t % pollTasks[k].period == 0) {
+					ticks[k]();
+					stats->wakeups++;
+					due = 1;
+				}
+			}
+		}
+		if(r.events) { // Alarm 1 written again, by the work just done
+			RtcEdge(pina, pcmsk0, &rtcPin, pcint);
+		}
+		if(t % LINK_PERIOD == 0) {
+			r.linkWakes++;
+		}
+		if(due || t - woke >= MAX_SUPPRESSED_TICKS) {
+			r.sleeps++;
+			woke = t;
+		}
+	}
+	r.wakeups = stats->wakeups;
+	r.redraws = stats->redraws;
+	r.quiet = !*alarmOnFlag;
+	r.saveHour = clockState->alarmMinute / 60;
+	r.saveMin = clockState->alarmMinute % 60;
+	return r;
+}
+
+/* Simulated world shared by both engines in jitter mode */
+static struct {
+	void (*setTicks)(unsigned long);
+	void (*setTime)(uint8_t, uint8_t, uint8_t, unsigned char);
+	volatile uint8_t *pina;
+	uint8_t *alarmOffSignal;
+	struct CoreStats *stats;
+	void (*inits[POLL_TASKS])(void);
+	void (*ticks[POLL_TASKS])(void);
+	unsigned long now; // ms the world has been brought up to
+	unsigned b;
+	struct JitterResult r;
+	double lastStart[JITTER_SMS]; // us, negative before the first tick
+} world;
+
+// Loads a polling build and, unless the build's own task does it, runs
+// the machines' Init
+static void *WorldLoad(const char *path, int init) {
+	void *so = dlopen(path, RTLD_LAZY | RTLD_LOCAL);
+	unsigned k;
+
+	if(!so) {
+		fprintf(stderr, "coresim: %s\n", dlerror());
+		exit(2);
+	}
+	if(dlsym(so, "App_Due")) {
+		fprintf(stderr, "coresim: -j needs a polling build (APP_EVENTS=0)\n");
+		exit(2);
+	}
+	memset(&world, 0, sizeof(world));
+	world.setTicks = (void (*)(unsigned long))Sym(so, "sim_set_ticks");
+	world.setTime = (void (*)(uint8_t, uint8_t, uint8_t, unsigned char))Sym(so, "sim_set_time");
+	world.pina = Sym(so, "PINA");
+	world.alarmOffSignal = Sym(so, "alarmOffSignal");
+	world.stats = Sym(so, "eventStats");
+	*world.pina = 0xFF;
+	world.setTime(6, 0, 0, 0);
+	((void (*)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char))Sym(so, "Alarm_Set"))
+		(0, 6 * 60 + 30, 0, 10, 0, 0);
+	world.setTicks(0);
+	for(k = 0; k < POLL_TASKS; k++) {
+		world.inits[k] = (void (*)(void))Sym(so, pollTasks[k].init);
+		world.ticks[k] = (void (*)(void))Sym(so, pollTasks[k].tick);
+		if(init) {
+			world.inits[k]();
+		}
+	}
+	for(k = 0; k < JITTER_SMS; k++) {
+		world.lastStart[k] = -1;
+	}
+	return so;
+}
+
+// Brings the clock, the sleeper and the buttons up to ms
+static void WorldAdvance(unsigned long ms) {
+	unsigned long second;
+	while(world.now <= ms) {
+		if(world.now % 1000 == 0) {
+			second = 6 * 3600UL + world.now / 1000;
+			world.setTime((second / 3600) % 24, (second / 60) % 60, second % 60, RTC_KEEP);
+		}
+		if(world.now == SLEEPER_UP_MS) {
+			*world.alarmOffSignal = 1;
+		}
+		if(world.b < sizeof(buttons) / sizeof(buttons[0]) && buttons[world.b].at == world.now) {
+			*world.pina = 0xFF & ~buttons[world.b].down;
+			world.b++;
+		}
+		world.now++;
+	}
+	world.setTicks(ms);
+}
+
+static unsigned SMPeriod(unsigned k) {
+	return k < POLL_TASKS ? pollTasks[k].period : LINK_PERIOD;
+}
+
+// Runs machine k starting at us; returns the cycles its tick took beyond the call
+static double SMRun(unsigned k, double us) {
+	unsigned long redraws = world.stats->redraws;
+	double interval;
+
+	WorldAdvance((unsigned long)(us / 1000));
+	if(world.lastStart[k] >= 0) {
+		interval = (us - world.lastStart[k]) / 1000;
+		world.r.ticks[k]++;
+		world.r.sumInterval[k] += interval;
+		if(fabs(interval - SMPeriod(k)) > world.r.maxDeviation[k]) {
+			world.r.maxDeviation[k] = fabs(interval - SMPeriod(k));
+		}
+	}
+	world.lastStart[k] = us;
+	if(k < POLL_TASKS) {
+		world.ticks[k]();
+	}
+	return (world.stats->redraws - redraws) * CYCLES_PER_REDRAW;
+}
+
+#define US(cycles) ((cycles) / (F_CPU_HZ / 1e6))
+
+// Periodic_Skip: moves *lastWake past the deadlines missed by a pass that
+// ended in tick now, and returns how many there were
+static unsigned long Skip(unsigned long *lastWake, unsigned long now, unsigned long period) {
+	unsigned long missed = 0;
+	if(now - *lastWake > period) {
+		missed = (now - *lastWake - 1) / period;
+		*lastWake += missed * period;
+	}
+	return missed;
+}
+
+/* SyncSMTask in its context, the machines it ticks and where it
+   has got to */
+static struct {
+	ucontext_t main, task;
+	struct SyncSM *table;
+	unsigned machine[POLL_TASKS]; // pollTasks index of each entry
+	double pos; // us the task is running at
+	double busy; // us the machine it just ticked takes
+	unsigned long wakeAt; // tick it blocked until
+	int blocked;
+} smTask;
+
+// Stands in for syncSMs[entry].tick: runs the machine at the task's
+// time, then hands the CPU back for as long as the work takes
+static void SyncTick(unsigned entry) {
+	unsigned k = smTask.machine[entry];
+	unsigned int elapsed = smTask.table[entry].elapsedTime;
+	if(elapsed > SMPeriod(k)) {
+		world.r.overruns[k] += (elapsed - 1) / SMPeriod(k);
+	}
+	smTask.busy = US(CYCLES_PER_CALL + SMRun(k, smTask.pos));
+	swapcontext(&smTask.task, &smTask.main);
+}
+
+#define SYNC_TICK(n) static void SyncTick##n(void) { SyncTick(n); }
+SYNC_TICK(0) SYNC_TICK(1) SYNC_TICK(2) SYNC_TICK(3) SYNC_TICK(4) SYNC_TICK(5)
+static void (*const syncTicks[POLL_TASKS])(void) = {
+	SyncTick0, SyncTick1, SyncTick2, SyncTick3, SyncTick4, SyncTick5,
+};
+
+// vTaskDelayUntil: blocks unless the wake tick has passed
+static void SyncBlock(uint16_t wakeAt) {
+	unsigned long now = (unsigned long)(smTask.pos / 1000);
+	int16_t ahead = (int16_t)(wakeAt - (uint16_t)now);
+	if(ahead <= 0) {
+		return;
+	}
+	smTask.wakeAt = now + ahead;
+	smTask.blocked = 1;
+	swapcontext(&smTask.task, &smTask.main);
+}
+
+// Lets SyncSMTask run from us until it ticks a machine (returns 1, the
+// work is in smTask.busy) or blocks (returns 0)
+static int SyncResume(double us) {
+	WorldAdvance((unsigned long)(us / 1000));
+	smTask.pos = us;
+	smTask.blocked = 0;
+	swapcontext(&smTask.main, &smTask.task);
+	return !smTask.blocked;
+}
+
+// Puts SyncSMTask from the APP_SYNC_SM build in a context of its own
+static void SyncLoad(void *so) {
+	void (*entry)(void) = (void (*)(void))Sym(so, "SyncSMTask");
+	unsigned char *stack = malloc(SIM_STACK);
+	unsigned e, k;
+
+	smTask.table = Sym(so, "syncSMs");
+	for(e = 0; e < POLL_TASKS; e++) { // The table holds the six machines, in any order
+		for(k = 0; k < POLL_TASKS && smTask.table[e].tick != world.ticks[k]; k++);
+		if(k == POLL_TASKS) {
+			fprintf(stderr, "coresim: syncSMs[%u] is not a polling machine\n", e);
+			exit(2);
+		}
+		smTask.machine[e] = k;
+		smTask.table[e].tick = syncTicks[e];
+	}
+	world.r.sms = POLL_TASKS;
+	((void (*)(void (*)(uint16_t)))Sym(so, "sim_on_block"))(SyncBlock);
+	if(!stack) {
+		perror("coresim");
+		exit(2);
+	}
+	getcontext(&smTask.task);
+	smTask.task.uc_stack.ss_sp = stack;
+	smTask.task.uc_stack.ss_size = SIM_STACK;
+	smTask.task.uc_link = NULL;
+	makecontext(&smTask.task, entry, 0);
+}
+
+/* Equal priority tasks: the one running when a tick arrives goes to the
+   back of the ready list, tasks unblocked by the tick join at the back.
+   The polling build's tasks are machines released every period; the
+   table build has SyncSMTask and LinkTask. */
+static struct JitterResult RunEngine(const char *path, int table) {
+	unsigned long release[JITTER_SMS + 1];
+	double remaining[JITTER_SMS + 1];
+	unsigned char ready[JITTER_SMS + 1], started[JITTER_SMS + 1], tasks[JITTER_SMS];
+	unsigned n = 0, count = 0, k, i;
+	unsigned long t;
+	double pos = 0, end;
+	void *so = WorldLoad(path, !table);
+
+	if(table) {
+		SyncLoad(so);
+		tasks[count++] = SYNC_TASK;
+		tasks[count++] = POLL_TASKS; // LinkTask
+	}
+	else {
+		if(dlsym(so, "SyncSMTask")) {
+			fprintf(stderr, "coresim: -j needs the polling build first (APP_SYNC_SM=0)\n");
+			exit(2);
+		}
+		for(k = 0; k < JITTER_SMS; k++) {
+			tasks[count++] = k;
+		}
+	}
+	memset(release, 0, sizeof(release));
+	memset(started, 0, sizeof(started));
+	for(t = 0; t < SIM_HOUR_MS; t++) {
+		if(n && started[ready[0]] && remaining[ready[0]] > 0) { // Time slice ends
+			k = ready[0];
+			memmove(ready, ready + 1, --n);
+			ready[n++] = k;
+		}
+		for(i = 0; i < count; i++) {
+			if(release[tasks[i]] == t) {
+				ready[n++] = tasks[i];
+				started[tasks[i]] = 0;
+			}
+		}
+		if(pos < t * 1000.0) {
+			pos = t * 1000.0;
+		}
+		end = (t + 1) * 1000.0;
+		while(n && pos < end) {
+			k = ready[0];
+			if(!started[k]) {
+				started[k] = 1;
+				remaining[k] = US(CYCLES_PER_WAKE + (k == SYNC_TASK ? 0 : SMRun(k, pos)));
+			}
+			if(remaining[k] > end - pos) {
+				remaining[k] -= end - pos;
+				pos = end;
+				break;
+			}
+			pos += remaining[k];
+			remaining[k] = 0;
+			if(k == SYNC_TASK) {
+				if(SyncResume(pos)) {
+					remaining[k] = smTask.busy;
+					continue;
+				}
+				release[k] = smTask.wakeAt;
+			}
+			else {
+				world.r.overruns[k] += Skip(&release[k], (unsigned long)(pos / 1000), SMPeriod(k));
+				release[k] += SMPeriod(k);
+			}
+			for(i = 1; i < n; i++) {
+				ready[i - 1] = ready[i];
+			}
+			n--;
+		}
+	}
+	return world.r;
+}
+
+static int Jitter(const char *poll, const char *table) {
+	const char *path[2] = {poll, table};
+	struct JitterResult r[2];
+	const char *engine[2] = {"tasks", "table"};
+	unsigned long ram[2];
+	unsigned e, k;
+
+	for(e = 0; e < 2; e++) {
+		int fd[2];
+		pid_t pid;
+		if(pipe(fd) != 0) {
+			perror("pipe");
+			return 2;
+		}
+		fflush(stdout);
+		pid = fork();
+		if(pid == 0) {
+			struct JitterResult j = RunEngine(path[e], e);
+			_exit(write(fd[1], &j, sizeof(j)) == sizeof(j) ? 0 : 3);
+		}
+		close(fd[1]);
+		if(read(fd[0], &r[e], sizeof(r[e])) != sizeof(r[e])) {
+			fprintf(stderr, "coresim: %s crashed\n", path[e]);
+			return 2;
+		}
+		close(fd[0]);
+		waitpid(pid, NULL, 0);
+	}
+	ram[0] = JITTER_SMS * (STACK_BYTES + TCB_BYTES);
+	ram[1] = 2 * (STACK_BYTES + TCB_BYTES) + r[1].sms * SYNC_SM_BYTES;
+
+	printf("%-18s %6s | %-6s %9s %9s %6s | %-6s %9s %9s %6s\n", "machine", "period",
+		"engine", "mean ms", "worst ms", "missed", "engine", "mean ms", "worst ms", "missed");
+	for(k = 0; k < JITTER_SMS; k++) {
+		printf("%-18s %6u", k < POLL_TASKS ? pollTasks[k].tick : "Link_Tick", SMPeriod(k));
+		for(e = 0; e < 2; e++) {
+			printf(" | %-6s %9.2f %9.2f %6lu", engine[e],
+				r[e].ticks[k] ? r[e].sumInterval[k] / r[e].ticks[k] : 0.0, r[e].maxDeviation[k], r[e].overruns[k]);
+		}
+		printf("\n");
+	}
+	printf("task RAM: %s %lu bytes, %s %lu bytes\n", engine[0], ram[0], engine[1], ram[1]);
+	return 0;
+}
+
+/* A painted stack per machine for -s, and one more that only ever runs
+   StackNop to measure what the switching itself costs. The machine's
+   context calls fn and switches back, over and over. */
+static struct {
+	ucontext_t main;
+	ucontext_t sm[POLL_TASKS + 1];
+	unsigned char *stack[POLL_TASKS + 1];
+	void (*fn)(void);
+} stacks;
+
+static void StackNop(void) {
+}
+
+static void StackLoop(int k) {
+	for(;;) {
+		stacks.fn();
+		swapcontext(&stacks.sm[k], &stacks.main);
+	}
+}
+
+static void StackCall(unsigned k, void (*fn)(void)) {
+	stacks.fn = fn;
+	swapcontext(&stacks.main, &stacks.sm[k]);
+}
+
+// Bytes below the fill that is still untouched, as uxTaskGetStackHighWaterMark counts it
+static unsigned long StackUsed(unsigned k) {
+	unsigned long free = 0;
+	while(free < SIM_STACK && stacks.stack[k][free] == STACK_FILL) {
+		free++;
+	}
+	return SIM_STACK - free;
+}
+
+static int Stacks(const char *path) {
+	unsigned long t;
+	unsigned k;
+
+	WorldLoad(path, 1);
+	for(k = 0; k <= POLL_TASKS; k++) {
+		stacks.stack[k] = malloc(SIM_STACK);
+		if(!stacks.stack[k]) {
+			perror("coresim");
+			return 2;
+		}
+		memset(stacks.stack[k], STACK_FILL, SIM_STACK);
+		getcontext(&stacks.sm[k]);
+		stacks.sm[k].uc_stack.ss_sp = stacks.stack[k];
+		stacks.sm[k].uc_stack.ss_size = SIM_STACK;
+		stacks.sm[k].uc_link = NULL;
+		makecontext(&stacks.sm[k], (void (*)(void))StackLoop, 1, (int)k);
+		StackCall(k, k < POLL_TASKS ? world.inits[k] : StackNop); // Again, on the machine's own stack
+	}
+	for(t = 0; t < SIM_HOUR_MS; t++) {
+		WorldAdvance(t);
+		for(k = 0; k < POLL_TASKS; k++) {
+			if(t % pollTasks[k].period == 0) {
+				StackCall(k, world.ticks[k]);
+			}
+		}
+	}
+	StackCall(POLL_TASKS, StackNop);
+	printf("%-18s %6s %11s\n", "machine", "period", "host bytes");
+	for(k = 0; k < POLL_TASKS; k++) {
+		printf("%-18s %6u %11lu\n", pollTasks[k].tick, pollTasks[k].period, StackUsed(k) - StackUsed(POLL_TASKS));
+	}
+	printf("less %lu bytes each for switching to the machine's stack\n", StackUsed(POLL_TASKS));
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int n;
+
+	if(argc == 4 && strcmp(argv[1], "-j") == 0) {
+		return Jitter(argv[2], argv[3]);
+	}
+	if(argc == 3 && strcmp(argv[1], "-s") == 0) {
+		return Stacks(argv[2]);
+	}
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s clock.so [clock.so ...]\n       %s -j clock_poll.so clock_sync.so\n       %s -s clock_poll.so\n",
+			argv[0], argv[0], argv[0]);
+		return 1;
+	}
+	printf("%-8s %10s %9s %12s %12s %8s %9s %12s %8s %6s %5s %7s\n",
+		"core", "wakeups/h", "redraws/h", "wake Mcycle", "busy Mcycle", "idle %",
+		"sleeps/h", "tickless Mc", "active", "alarm", "quiet", "new set");
+	for(n = 1; n < argc; n++) {
+		struct CoreResult r;
+		int fd[2];
+		pid_t pid;
+		double work, busy, tickless;
+
+		memset(&r, 0, sizeof(r));
+		if(pipe(fd) != 0) {
+			perror("pipe");
+			return 2;
+		}
+		fflush(stdout);
+		pid = fork();
+		if(pid == 0) { // Fresh globals for every build
+			close(fd[0]);
+			r = RunCore(argv[n]);
+			if(write(fd[1], &r, sizeof(r)) != sizeof(r)) {
+				_exit(3);
+			}
+			_exit(0);
+		}
+		close(fd[1]);
+		if(read(fd[0], &r, sizeof(r)) != sizeof(r)) {
+			fprintf(stderr, "coresim: %s crashed\n", argv[n]);
+			continue;
+		}
+		close(fd[0]);
+		waitpid(pid, NULL, 0);
+
+		work = (r.wakeups + r.linkWakes) * CYCLES_PER_WAKE + r.redraws * CYCLES_PER_REDRAW;
+		busy = work + SIM_HOUR_MS * CYCLES_PER_TICK;
+		tickless = work + r.sleeps * CYCLES_PER_SLEEP;
+		printf("%-8s %10lu %9lu %12.1f %12.1f %7.2f%% %9lu %12.1f %7.1f%% %6s %5s %4u:%02u\n",
+			r.events ? "events" : "polling", r.wakeups, r.redraws,
+			r.wakeups * CYCLES_PER_WAKE / 1e6, busy / 1e6,
+			100.0 * (1.0 - busy / (F_CPU_HZ * 3600.0)),
+			r.sleeps, tickless / 1e6, 100.0 * (tickless - busy) / busy,
+			r.rang ? "yes" : "no", r.quiet ? "yes" : "no", r.saveHour, r.saveMin);
+	}
+	return 0;
+}
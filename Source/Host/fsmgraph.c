@@ -0,0 +1,181 @@
+/* State machine graphs and table checks
+   Loads a host build of the clock (Alarm1.c built with HOST_SIM, as for
+   coresim) and walks the flash tables of every table-driven state machine
+   (fsm.h) through appFSMs[]. For each machine it writes a Graphviz digraph
+   to stdout: an edge per transition, labelled with its guard and, where a
+   state has several, the order FSM_Tick tries them in. States that cannot
+   be reached from state 0 are drawn dashed.
+
+   On stderr it reports, per machine, the states and transitions, the
+   bytes the tables take at AVR sizes (2 byte pointers), the most guards a
+   tick can call, the states that cannot be reached and the states that
+   never leave. It also checks the tables themselves: rows sorted by the
+   state they leave, every state, guard and first[] index in range and
+   pointing where it should, and no row hidden behind an FSM_ALWAYS row of
+   the same state. Exits 1 if a table is wrong; unreachable states are only
+   reported.
+   Build with  gcc -O2 -DHOST_SIM -IHost/include -o fsmgraph Host/fsmgraph.c -ldl
+   and run     fsmgraph clock.so | dot -Tsvg > machines.svg */
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <avr/pgmspace.h>
+#include "../fsm.h"
+
+#define MAX_STATES 64
+#define AVR_POINTER 2
+
+static int errors;
+
+static void Error(const struct FSM *m, const char *what, unsigned n) {
+	fprintf(stderr, "fsmgraph: %s: %s %u\n", m->name, what, n);
+	errors++;
+}
+
+// Number of rows before the FSM_END row
+static unsigned Rows(const struct FSM *m) {
+	unsigned n = 0;
+	while(m->transitions[n].from != FSM_END) {
+		n++;
+	}
+	return n;
+}
+
+static void Check(const struct FSM *m, unsigned rows) {
+	unsigned n, s;
+	if(m->states == 0 || m->states > MAX_STATES) {
+		Error(m, "bad state count", m->states);
+		return;
+	}
+	for(n = 0; n < rows; n++) {
+		const struct FSMTransition *t = &m->transitions[n];
+		if(t->from >= m->states) {
+			Error(m, "row leaves a state out of range, row", n);
+		}
+		if(t->to >= m->states) {
+			Error(m, "row goes to a state out of range, row", n);
+		}
+		if(t->guard != FSM_ALWAYS && t->guard >= m->guardCount) {
+			Error(m, "row has a guard out of range, row", n);
+		}
+		if(n && t->from < m->transitions[n - 1].from) {
+			Error(m, "rows out of order at row", n);
+		}
+		if(n && t->from == m->transitions[n - 1].from && m->transitions[n - 1].guard == FSM_ALWAYS) {
+			Error(m, "row can never be taken, row", n);
+		}
+	}
+	for(s = 0; s < m->states; s++) {
+		unsigned first = rows;
+		for(n = 0; n < rows; n++) {
+			if(m->transitions[n].from == s) {
+				first = n;
+				break;
+			}
+		}
+		if(first < rows ? m->first[s] != first : (m->first[s] > rows || m->transitions[m->first[s]].from == s)) {
+			Error(m, "first[] is wrong for state", s);
+		}
+	}
+}
+
+static void Graph(const struct FSM *m, unsigned rows) {
+	unsigned char reached[MAX_STATES] = {0}, queue[MAX_STATES];
+	unsigned head = 0, tail = 0, n, s, count, tries, most = 0, leaves;
+	unsigned bytes = (rows + 1) * sizeof(struct FSMTransition) + m->states * (1 + AVR_POINTER) + 4 * AVR_POINTER + 1;
+
+	reached[0] = 1;
+	queue[tail++] = 0;
+	while(head < tail) {
+		s = queue[head++];
+		for(n = 0; n < rows; n++) {
+			if(m->transitions[n].from == s && !reached[m->transitions[n].to]) {
+				reached[m->transitions[n].to] = 1;
+				queue[tail++] = m->transitions[n].to;
+			}
+		}
+	}
+
+	printf("digraph \"%s\" {\n\tlabel=\"%s\";\n\tnode [shape=box];\n", m->name, m->name);
+	for(s = 0; s < m->states; s++) {
+		printf("\t\"%s\"%s;\n", m->stateNames[s], reached[s] ? (s ? "" : " [peripheries=2]") : " [style=dashed]");
+	}
+	for(n = 0; n < rows; n++) {
+		const struct FSMTransition *t = &m->transitions[n];
+		count = 0;
+		tries = 0;
+		for(s = 0; s < rows; s++) {
+			if(m->transitions[s].from == t->from) {
+				count++;
+				tries += s <= n;
+			}
+		}
+		printf("\t\"%s\" -> \"%s\"", m->stateNames[t->from], m->stateNames[t->to]);
+		if(t->guard != FSM_ALWAYS) {
+			if(count > 1) {
+				printf(" [label=\"%u: %s\"]", tries, m->guardNames[t->guard]);
+			}
+			else {
+				printf(" [label=\"%s\"]", m->guardNames[t->guard]);
+			}
+		}
+		printf(";\n");
+	}
+	printf("}\n");
+
+	fprintf(stderr, "%-12s %2u states %2u transitions %4u bytes", m->name, m->states, rows, bytes);
+	for(s = 0; s < m->states; s++) {
+		tries = 0;
+		for(n = 0; n < rows; n++) {
+			if(m->transitions[n].from == s && m->transitions[n].guard != FSM_ALWAYS) {
+				tries++;
+			}
+		}
+		if(tries > most) {
+			most = tries;
+		}
+	}
+	fprintf(stderr, "  %u guards a tick at most", most);
+	for(s = 0; s < m->states; s++) {
+		if(!reached[s]) {
+			fprintf(stderr, ", %s unreachable", m->stateNames[s]);
+		}
+		leaves = 0;
+		for(n = 0; n < rows; n++) {
+			leaves |= m->transitions[n].from == s && m->transitions[n].to != s;
+		}
+		if(!leaves) {
+			fprintf(stderr, ", %s never leaves", m->stateNames[s]);
+		}
+	}
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+	void *so;
+	const struct FSM *const *machines;
+	unsigned k, rows, guards = 0;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s clock.so > machines.dot\n", argv[0]);
+		return 2;
+	}
+	if(!(so = dlopen(argv[1], RTLD_LAZY | RTLD_LOCAL))) {
+		fprintf(stderr, "fsmgraph: %s\n", dlerror());
+		return 2;
+	}
+	if(!(machines = dlsym(so, "appFSMs"))) {
+		fprintf(stderr, "fsmgraph: %s has no appFSMs (build it with HOST_SIM)\n", argv[1]);
+		return 2;
+	}
+	for(k = 0; machines[k]; k++) {
+		rows = Rows(machines[k]);
+		Check(machines[k], rows);
+		Graph(machines[k], rows);
+		if(machines[k]->guardCount > guards) {
+			guards = machines[k]->guardCount;
+		}
+	}
+	fprintf(stderr, "guards shared by all: %u, %u bytes\n", guards, guards * AVR_POINTER);
+	return errors != 0;
+}
@@ -0,0 +1,316 @@
+/* Runs the sensor's HC-05/HC-06 driver (Bluetooth/hc05.h) against a
+   scripted stand-in for the module on a pseudo-terminal.
+
+   The driver side owns the pty slave: USART0 reads and writes go to it and
+   USART_SetBaud changes its termios speed. A forked child plays the module
+   on the pty master, following a script:
+
+       expect <prefix> -> <reply>   wait for a command starting with prefix
+                                    and answer it (reply "-" sends nothing)
+       wait <ms>                    pause
+       baud <rate>                  fail unless the driver is now at rate
+       state <0|1>                  drive the module's STATE pin
+       driver failed                the driver should give up, not end
+                                    ready (read by hc05sim, not the module)
+
+   Without a script file the factory script below for HC05_MODEL is used;
+   -m instead runs a module that never answers. Replies end as the model's
+   commands do, with CRLF on the HC-05 and nothing on the HC-06. The exit
+   status is 0 when the stand-in got every expected command in order and
+   the driver ended up ready at the agreed rate, or failed if the script
+   says so.
+   See README.md in this directory for build instructions. */
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "usart_ATmega1284.h"
+#include "link.h"
+#include "hc05.h"
+
+#if HC05_MODEL == 5
+static const char *factoryScript =
+	"expect AT -> -\n" // No answer to the first AT, forcing a retry
+	"expect AT -> OK\n"
+	"expect AT+NAME= -> OK\n"
+	"expect AT+ROLE= -> OK\n"
+	"expect AT+PSWD= -> ERROR\n"
+	"expect AT+PSWD= -> OK\n"
+	"expect AT+CMODE= -> OK\n"
+	"expect AT+UART= -> OK\n"
+	"expect AT+RESET -> OK\n"
+	"wait 1200\n"
+#else
+static const char *factoryScript =
+	"expect AT -> -\n"
+	"expect AT -> OK\n"
+	"expect AT+NAME -> OKsetname\n"
+	"expect AT+PIN -> -\n" // Busy, forcing a retry; the HC-06 has no ERROR
+	"expect AT+PIN -> OKsetPIN\n"
+	"expect AT+BAUD7 -> OK57600\n" // Switches rate at once, no reset
+	"wait 1200\n"
+#endif
+	"baud 57600\n"
+	"state 1\n"
+	"wait 300\n"
+	"state 0\n"
+	"wait 300\n";
+
+/* A module that is off or on the wrong rate: every AT goes unanswered */
+static const char *muteScript =
+	"expect AT -> -\n"
+	"expect AT -> -\n"
+	"expect AT -> -\n"
+	"wait 1000\n"
+	"driver failed\n";
+
+static int ptySlave = -1;
+static unsigned long ptyBaud;
+
+static unsigned long NowMs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long)ts.tv_sec * 1000UL + (unsigned long)ts.tv_nsec / 1000000UL;
+}
+
+/* USART0 backend on the pty slave */
+unsigned char host_usart_status(unsigned char usartNum) {
+	struct pollfd p = {ptySlave, POLLIN, 0};
+	unsigned char status = (1 << UDRE0) | (1 << TXC0);
+	(void)usartNum;
+	if(poll(&p, 1, 0) > 0 && (p.revents & POLLIN)) {
+		status |= (1 << RXC0);
+	}
+	return status;
+}
+
+void host_usart_write(unsigned char usartNum, unsigned char data) {
+	(void)usartNum;
+	if(write(ptySlave, &data, 1) != 1) {
+		perror("hc05sim: write");
+	}
+}
+
+unsigned char host_usart_read(unsigned char usartNum) {
+	unsigned char data = 0;
+	(void)usartNum;
+	if(read(ptySlave, &data, 1) != 1) {
+		return 0;
+	}
+	return data;
+}
+
+static speed_t SpeedOf(unsigned long baud) {
+	switch(baud) {
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+		case 460800: return B460800;
+		case 921600: return B921600;
+		default: return B0;
+	}
+}
+
+void host_usart_baud(unsigned char usartNum, unsigned long baud) {
+	struct termios tio;
+	(void)usartNum;
+	ptyBaud = baud;
+	if(tcgetattr(ptySlave, &tio) == 0 && SpeedOf(baud) != B0) {
+		cfsetispeed(&tio, SpeedOf(baud));
+		cfsetospeed(&tio, SpeedOf(baud));
+		tcsetattr(ptySlave, TCSANOW, &tio);
+	}
+}
+
+void vTaskSuspendAll(void) {
+}
+
+signed char xTaskResumeAll(void) {
+	return 0;
+}
+
+/* Module stand-in, run in the child on the pty master */
+static int ReadCommand(int fd, char *buf, size_t size) {
+	size_t len = 0;
+	unsigned char c;
+	struct pollfd p = {fd, POLLIN, 0};
+	for(;;) {
+		// HC-06 commands have no line ending, so a quiet line ends one too
+		if(poll(&p, 1, len ? 100 : 5000) <= 0) {
+			break;
+		}
+		if(read(fd, &c, 1) != 1) {
+			return -1;
+		}
+		if(c == '\n') {
+			break;
+		}
+		if(c != '\r' && len < size - 1) {
+			buf[len++] = (char)c;
+		}
+	}
+	buf[len] = 0;
+	return (int)len;
+}
+
+static speed_t MasterSpeed(int fd) {
+	struct termios tio;
+	if(tcgetattr(fd, &tio) != 0) {
+		return B0;
+	}
+	return cfgetospeed(&tio);
+}
+
+static int RunStandIn(int master, int statePipe, const char *script) {
+	char line[128], cmd[64];
+	const char *p = script;
+	int failures = 0;
+
+	while(*p) {
+		size_t n = strcspn(p, "\n");
+		char arg[64], reply[64];
+		unsigned long value;
+		if(n >= sizeof(line)) {
+			n = sizeof(line) - 1;
+		}
+		memcpy(line, p, n);
+		line[n] = 0;
+		p += n + (p[n] == '\n');
+
+		if(sscanf(line, "expect %63s -> %63s", arg, reply) == 2) {
+			if(ReadCommand(master, cmd, sizeof(cmd)) <= 0) {
+				printf("  module: timed out waiting for %s\n", arg);
+				failures++;
+				continue;
+			}
+			if(strncmp(cmd, arg, strlen(arg)) != 0) {
+				printf("  module: got \"%s\", expected %s\n", cmd, arg);
+				failures++;
+			}
+			printf("  module: %-20s -> %s\n", cmd, reply);
+			if(strcmp(reply, "-") != 0) {
+				dprintf(master, "%s" HC05_EOL, reply);
+			}
+		}
+		else if(sscanf(line, "wait %lu", &value) == 1) {
+			usleep(value * 1000UL);
+		}
+		else if(sscanf(line, "baud %lu", &value) == 1) {
+			if(MasterSpeed(master) != SpeedOf(value)) {
+				printf("  module: host is not at %lu baud\n", value);
+				failures++;
+			}
+			else {
+				printf("  module: host switched to %lu baud\n", value);
+			}
+		}
+		else if(sscanf(line, "state %lu", &value) == 1) {
+			unsigned char level = (unsigned char)value;
+			printf("  module: STATE %lu\n", value);
+			if(write(statePipe, &level, 1) != 1) {
+				failures++;
+			}
+		}
+	}
+	return failures;
+}
+
+static char *LoadScript(const char *path) {
+	FILE *f = fopen(path, "r");
+	char *buf;
+	long size;
+	if(!f) {
+		perror(path);
+		exit(2);
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = calloc(1, (size_t)size + 1);
+	if(!buf || fread(buf, 1, (size_t)size, f) != (size_t)size) {
+		exit(2);
+	}
+	fclose(f);
+	return buf;
+}
+
+int main(int argc, char **argv) {
+	const char *script = factoryScript;
+	struct termios tio;
+	int master, statePipe[2], status, ok, wantFailed;
+	unsigned long start, readyAt = 0;
+	pid_t child;
+
+	if(argc > 1) {
+		script = strcmp(argv[1], "-m") == 0 ? muteScript : LoadScript(argv[1]);
+	}
+	wantFailed = strstr(script, "driver failed") != NULL;
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		perror("hc05sim: pty");
+		return 2;
+	}
+	ptySlave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if(ptySlave < 0 || pipe(statePipe) != 0) {
+		perror("hc05sim: pty slave");
+		return 2;
+	}
+	tcgetattr(ptySlave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(ptySlave, TCSANOW, &tio);
+	fcntl(statePipe[0], F_SETFL, O_NONBLOCK);
+
+	fflush(stdout);
+	child = fork();
+	if(child == 0) {
+		setvbuf(stdout, NULL, _IONBF, 0);
+		close(ptySlave);
+		close(statePipe[0]);
+		_exit(RunStandIn(master, statePipe[1], script) ? 1 : 0);
+	}
+	close(statePipe[1]);
+
+	Link_Init();
+	HC05_Init();
+	start = NowMs();
+	while(waitpid(child, &status, WNOHANG) == 0) {
+		unsigned char level;
+		while(host_usart_status(0) & (1 << RXC0)) { // The RX interrupt
+			USART0_RX_vect();
+		}
+		while(read(statePipe[0], &level, 1) == 1) {
+			PIND = level ? (PIND | (1 << HC05_STATE)) : (PIND & ~(1 << HC05_STATE));
+		}
+		HC05_Tick();
+		if(!readyAt && hc05_state == HCReady) {
+			readyAt = NowMs();
+		}
+		usleep(HC05_TICK * 1000);
+	}
+
+	ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	if(wantFailed) {
+		ok = ok && hc05_state == HCFailed && !readyAt && ptyBaud == BAUD_RATE;
+	}
+	else {
+		ok = ok && hc05_state == HCReady && ptyBaud == hc05Baud;
+	}
+	printf("driver: %s after %lu ms, %lu baud, link up %u down %u\n",
+		hc05_state == HCReady ? "ready" : hc05_state == HCFailed ? "failed" : "not ready",
+		readyAt ? readyAt - start : 0, ptyBaud, hc05LinkUps, hc05LinkDowns);
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+/* Host stand-in for the FreeRTOS V7.1.1 headers
+   Only the types the application sources name are provided; the simulator
+   calls the *_Tick functions itself instead of running the scheduler. */
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define portCHAR char
+#define portBASE_TYPE char
+#define portSTACK_TYPE uint8_t
+typedef uint16_t portTickType;
+
+#define portMAX_DELAY ((portTickType)0xffff)
+#define portTICK_RATE_MS ((portTickType)1)
+#define configMINIMAL_STACK_SIZE 85
+#define configTICK_RATE_HZ 1000
+#define configUSE_MUTEXES 1
+#define configUSE_TIMERS 1
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+
+size_t xPortGetFreeHeapSize(void);
+
+#endif
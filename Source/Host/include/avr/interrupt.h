@@ -0,0 +1,10 @@
+/* Host stand-in for <avr/interrupt.h>
+   An ISR becomes an ordinary function the simulator calls directly. */
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#define ISR(vector) void vector(void)
+#define sei()
+#define cli()
+
+#endif
@@ -0,0 +1,80 @@
+/* Host stand-in for <avr/io.h>
+   Registers are plain variables owned by the node under simulation
+   (see sim_node.c). Bit positions match the ATmega1284 datasheet. */
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define HOST_REG8(r) extern volatile uint8_t r;
+#define HOST_REG16(r) extern volatile uint16_t r;
+
+HOST_REG8(PINA) HOST_REG8(DDRA) HOST_REG8(PORTA)
+HOST_REG8(PINB) HOST_REG8(DDRB) HOST_REG8(PORTB)
+HOST_REG8(PINC) HOST_REG8(DDRC) HOST_REG8(PORTC)
+HOST_REG8(PIND) HOST_REG8(DDRD) HOST_REG8(PORTD)
+
+HOST_REG8(TCCR0A) HOST_REG8(TCCR0B) HOST_REG8(OCR0A) HOST_REG8(TCNT0)
+HOST_REG8(TCCR1A) HOST_REG8(TCCR1B) HOST_REG8(OCR1AH) HOST_REG8(OCR1AL) HOST_REG8(TIMSK1)
+HOST_REG16(TCNT1) HOST_REG16(OCR1A)
+HOST_REG8(TCCR2A) HOST_REG8(TCCR2B) HOST_REG8(OCR2A) HOST_REG8(TCNT2) HOST_REG8(TIMSK2) HOST_REG8(TIFR2) HOST_REG8(ASSR)
+HOST_REG8(TCCR3A) HOST_REG8(TCCR3B)
+HOST_REG16(OCR3A) HOST_REG16(TCNT3)
+
+HOST_REG8(UCSR0A) HOST_REG8(UCSR0B) HOST_REG8(UCSR0C) HOST_REG8(UBRR0L) HOST_REG8(UBRR0H) HOST_REG8(UDR0)
+HOST_REG8(UCSR1A) HOST_REG8(UCSR1B) HOST_REG8(UCSR1C) HOST_REG8(UBRR1L) HOST_REG8(UBRR1H) HOST_REG8(UDR1)
+
+HOST_REG8(ADCSRA) HOST_REG8(ADMUX)
+HOST_REG16(ADC)
+
+HOST_REG8(PCICR) HOST_REG8(PCMSK0) HOST_REG8(EICRA) HOST_REG8(EIMSK)
+HOST_REG8(SMCR) HOST_REG8(EECR)
+
+/* Timer 0 */
+#define WGM00 0
+#define WGM01 1
+#define COM0A1 7
+#define CS00 0
+/* Timer 1 */
+#define OCIE1A 1
+/* Timer 2 */
+#define WGM21 1
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define OCIE2A 1
+#define OCF2A 1
+/* Timer 3 */
+#define COM3A0 6
+#define WGM32 3
+#define CS30 0
+#define CS31 1
+/* USART0 / USART1 */
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define RXCIE0 7
+#define UCSZ00 1
+#define U2X0 1
+#define UCSZ01 2
+#define RXC1 7
+#define TXC1 6
+#define UDRE1 5
+#define RXEN1 4
+#define TXEN1 3
+#define RXCIE1 7
+#define UCSZ10 1
+#define U2X1 1
+#define UCSZ11 2
+/* ADC */
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+/* Pin change interrupts */
+#define PCIE0 0
+/* EEPROM */
+#define EERIE 3
+
+#endif
@@ -0,0 +1,28 @@
+/* Host stand-in for FreeRTOS croutine.h
+   The co-routine macros are the real ones so an APP_COROUTINES build
+   compiles; the simulator calls the *_Tick functions itself. */
+#ifndef HOST_CROUTINE_H
+#define HOST_CROUTINE_H
+
+#include "FreeRTOS.h"
+
+typedef struct corCoRoutineControlBlock {
+	unsigned short uxState;
+} corCRCB;
+typedef void * xCoRoutineHandle;
+typedef void (*crCOROUTINE_CODE)(xCoRoutineHandle, unsigned portBASE_TYPE);
+
+signed portBASE_TYPE xCoRoutineCreate(crCOROUTINE_CODE pxCoRoutineCode, unsigned portBASE_TYPE uxPriority, unsigned portBASE_TYPE uxIndex);
+void vCoRoutineSchedule(void);
+void vCoRoutineAddToDelayedList(portTickType xTicksToDelay, void *pxEventList);
+
+#define crSTART(pxCRCB) switch(((corCRCB *)(pxCRCB))->uxState) { case 0:
+#define crEND() }
+#define crSET_STATE0(xHandle) ((corCRCB *)(xHandle))->uxState = (__LINE__ * 2); return; case (__LINE__ * 2):
+#define crDELAY(xHandle, xTicksToDelay) \
+	if((xTicksToDelay) > 0) { \
+		vCoRoutineAddToDelayedList((xTicksToDelay), NULL); \
+	} \
+	crSET_STATE0((xHandle));
+
+#endif
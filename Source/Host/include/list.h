@@ -0,0 +1,46 @@
+/* Host stand-in for FreeRTOS list.h
+   The V7.1.1 list structures and macros, so that the kernel's own list.c,
+   with the timer wheel, builds on the host for Host/wheelbench.c. */
+#ifndef HOST_LIST_H
+#define HOST_LIST_H
+
+#include "FreeRTOS.h"
+
+struct xLIST_ITEM {
+	portTickType xItemValue;
+	volatile struct xLIST_ITEM *pxNext;
+	volatile struct xLIST_ITEM *pxPrevious;
+	void *pvOwner;
+	void *pvContainer;
+};
+typedef struct xLIST_ITEM xListItem;
+
+struct xMINI_LIST_ITEM {
+	portTickType xItemValue;
+	volatile struct xLIST_ITEM *pxNext;
+	volatile struct xLIST_ITEM *pxPrevious;
+};
+typedef struct xMINI_LIST_ITEM xMiniListItem;
+
+typedef struct xLIST {
+	volatile unsigned portBASE_TYPE uxNumberOfItems;
+	volatile xListItem *pxIndex;
+	volatile xMiniListItem xListEnd;
+} xList;
+
+#define listSET_LIST_ITEM_OWNER(pxListItem, pxOwner) ((pxListItem)->pvOwner = (void *)(pxOwner))
+#define listSET_LIST_ITEM_VALUE(pxListItem, xValue) ((pxListItem)->xItemValue = (xValue))
+#define listGET_LIST_ITEM_VALUE(pxListItem) ((pxListItem)->xItemValue)
+#define listGET_ITEM_VALUE_OF_HEAD_ENTRY(pxList) ((&((pxList)->xListEnd))->pxNext->xItemValue)
+#define listLIST_IS_EMPTY(pxList) ((pxList)->uxNumberOfItems == (unsigned portBASE_TYPE)0)
+#define listCURRENT_LIST_LENGTH(pxList) ((pxList)->uxNumberOfItems)
+#define listGET_OWNER_OF_HEAD_ENTRY(pxList) ((&((pxList)->xListEnd))->pxNext->pvOwner)
+#define listIS_CONTAINED_WITHIN(pxList, pxListItem) ((pxListItem)->pvContainer == (void *)(pxList))
+
+void vListInitialise(xList *pxList);
+void vListInitialiseItem(xListItem *pxItem);
+void vListInsert(xList *pxList, xListItem *pxNewListItem);
+void vListInsertEnd(xList *pxList, xListItem *pxNewListItem);
+void vListRemove(xListItem *pxItemToRemove);
+
+#endif
@@ -0,0 +1,21 @@
+/* Host stand-in for FreeRTOS queue.h
+   A fixed-size ring per queue (see sim_node.c). Nothing ever blocks: a
+   receive returns pdFALSE at once when the queue is empty and the
+   simulator does the waiting. */
+#ifndef HOST_QUEUE_H
+#define HOST_QUEUE_H
+
+#include "FreeRTOS.h"
+
+#define queueQUEUE_TYPE_MUTEX 1U
+
+typedef void * xQueueHandle;
+
+xQueueHandle xQueueCreate(unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize);
+signed portBASE_TYPE xQueueSend(xQueueHandle xQueue, const void *pvItemToQueue, portTickType xTicksToWait);
+signed portBASE_TYPE xQueueSendFromISR(xQueueHandle xQueue, const void *pvItemToQueue, signed portBASE_TYPE *pxHigherPriorityTaskWoken);
+signed portBASE_TYPE xQueueReceive(xQueueHandle xQueue, void *pvBuffer, portTickType xTicksToWait);
+xQueueHandle xQueueCreateMutex(unsigned char ucQueueType);
+unsigned portBASE_TYPE uxQueueMessagesWaiting(const xQueueHandle xQueue);
+
+#endif
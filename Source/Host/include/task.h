@@ -0,0 +1,24 @@
+/* Host stand-in for FreeRTOS task.h */
+#ifndef HOST_TASK_H
+#define HOST_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void * xTaskHandle;
+typedef void (*pdTASK_CODE)(void *);
+
+/* The simulator never preempts, so critical sections are empty */
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+#define taskYIELD()
+
+signed portBASE_TYPE xTaskCreate(void *pvTaskCode, const signed char *pcName, unsigned short usStackDepth, void *pvParameters, unsigned portBASE_TYPE uxPriority, xTaskHandle *pxCreatedTask);
+void vTaskDelay(portTickType xTicksToDelay);
+void vTaskDelayUntil(portTickType *pxPreviousWakeTime, portTickType xTimeIncrement);
+void vTaskStartScheduler(void);
+portTickType xTaskGetTickCount(void);
+portTickType xTaskGetTickCountFromISR(void);
+void vTaskSuspendAll(void);
+signed portBASE_TYPE xTaskResumeAll(void);
+
+#endif
@@ -0,0 +1,20 @@
+/* Host stand-in for FreeRTOS timers.h
+   The simulator has no timer task: sim_set_ticks runs the callback of
+   every timer whose time has come (see sim_node.c). The start, stop and
+   reset macros of the real header are functions here. */
+#ifndef HOST_TIMERS_H
+#define HOST_TIMERS_H
+
+#include "FreeRTOS.h"
+
+typedef void * xTimerHandle;
+typedef void (*tmrTIMER_CALLBACK)(xTimerHandle xTimer);
+
+xTimerHandle xTimerCreate(const signed char *pcTimerName, portTickType xTimerPeriodInTicks, unsigned portBASE_TYPE uxAutoReload, void *pvTimerID, tmrTIMER_CALLBACK pxCallbackFunction);
+portBASE_TYPE xTimerStart(xTimerHandle xTimer, portTickType xBlockTime);
+portBASE_TYPE xTimerStop(xTimerHandle xTimer, portTickType xBlockTime);
+portBASE_TYPE xTimerReset(xTimerHandle xTimer, portTickType xBlockTime);
+portBASE_TYPE xTimerIsTimerActive(xTimerHandle xTimer);
+void *pvTimerGetTimerID(xTimerHandle xTimer);
+
+#endif
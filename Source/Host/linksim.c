@@ -0,0 +1,434 @@
+/* Two-node link simulator for the clock/sensor USART0 protocol
+   Loads the clock (Alarm1.c) and the bed sensor (Bluetooth/main.c) as host
+   shared objects, wires their USART0 together through an in-process pipe
+   with injectable latency, byte loss and corruption, and runs both state
+   machines on a simulated 1 ms tick. Each fault profile is run for a number
+   of trials and the handshake (alarm on -> off signal back) is measured.
+   See README.md in this directory for build instructions. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define SIM_TIMEOUT_MS 120000UL
+#define WIRE_DEPTH 1024
+#define RTC_KEEP 2 // SIM_RTC_KEEP, the hour register stays in the layout it is in
+
+struct FaultProfile {
+	const char *name;
+	unsigned latencyMs; // fixed one-way delay
+	unsigned jitterMs; // extra uniform delay, order is preserved
+	unsigned lossPct; // chance a byte never arrives
+	unsigned corruptPct; // chance a byte arrives with one bit flipped
+};
+
+static const struct FaultProfile profiles[] = {
+	{"clean", 0, 0, 0, 0},
+	{"latency-50ms", 50, 20, 0, 0},
+	{"latency-500ms", 500, 200, 0, 0},
+	{"loss-5%", 1, 0, 5, 0},
+	{"loss-20%", 1, 0, 20, 0},
+	{"corrupt-5%", 1, 0, 0, 5},
+	{"corrupt-20%", 1, 0, 0, 20},
+	{"mixed", 30, 30, 5, 5},
+};
+
+/* One direction of the link */
+struct Wire {
+	unsigned long due[WIRE_DEPTH];
+	unsigned char data[WIRE_DEPTH];
+	unsigned head, tail;
+	unsigned long lastDue;
+	const struct FaultProfile *fault;
+	unsigned long now;
+	unsigned long sent, lost, corrupted;
+	unsigned char sniffState, sniffLeft, sniffEscape, sniffType; // frame sniffer, see WireSniff
+	unsigned long handshakeFrames;
+	unsigned long alarmPolls; // bus polls carrying the alarm flag
+};
+
+/* A firmware task: its Init/Tick pair and the vTaskDelay it runs at */
+struct SimTask {
+	const char *initName;
+	const char *tickName;
+	unsigned period;
+	void (*init)(void);
+	void (*tick)(void);
+	unsigned phase;
+};
+
+#define SIM_MAX_TASKS 4
+
+struct Node {
+	void *so;
+	struct SimTask tasks[SIM_MAX_TASKS];
+	void (*deliver)(unsigned char, unsigned char);
+	void (*attach)(void (*)(void *, unsigned char, unsigned char), void *);
+	unsigned long (*txBytes)(unsigned char);
+	unsigned long (*overruns)(unsigned char);
+	void (*setTicks)(unsigned long);
+};
+
+/* Leading fields of the clock's struct LinkMonStats (linkmon.h) */
+struct HeartbeatStats {
+	unsigned int sent;
+	unsigned int received;
+	unsigned int lost;
+	unsigned int garbled;
+};
+
+/* Tasks taking part in the link, with the periods from the firmware.
+   Tasks whose symbols are missing from a build are skipped. */
+static const struct SimTask clockTasks[SIM_MAX_TASKS] = {
+	{"AlarmOn_Init", "AlarmOn_Tick", 1000, NULL, NULL, 0},
+	{"LinkMon_Init", "Link_Tick", 20, NULL, NULL, 0},
+};
+
+static const struct SimTask sensorTasks[SIM_MAX_TASKS] = {
+	{"AlarmOff_Init", "AlarmOff_Tick", 100, NULL, NULL, 0},
+	{"FSRTelemetry_Init", "FSRTelemetry_Tick", 50, NULL, NULL, 0},
+	{NULL, "Link_Service", 10, NULL, NULL, 0},
+};
+
+/* What each main() does before starting the scheduler, in order */
+static const char *const startup[] = {"Node_Init", "Link_Init", "Bus_Init"};
+
+struct TrialResult {
+	int completed;
+	unsigned long handshakeMs;
+	unsigned long clockTx, sensorTx;
+	unsigned long lost, corrupted, overruns;
+	unsigned long pings, pongs, rttSum;
+};
+
+static uint32_t rngState;
+
+static uint32_t Rand(void) {
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
+
+/* Follows the frames (link.h) a node sends, before any fault is applied,
+   and counts the alarm on/off ones. */
+static void WireSniff(struct Wire *w, unsigned char data) {
+	if(data == 0x7E) { // LINK_SOF
+		w->sniffState = 1;
+		w->sniffEscape = 0;
+		return;
+	}
+	if(data == 0x7D) { // LINK_ESC
+		w->sniffEscape = 1;
+		return;
+	}
+	if(w->sniffEscape) {
+		data ^= 0x20;
+		w->sniffEscape = 0;
+	}
+	switch(w->sniffState) {
+		case 0: // between frames
+		break;
+		case 1: // address
+			w->sniffState = 2;
+		break;
+		case 2: // type
+			w->sniffType = data;
+			if(data == 0x01 || data == 0x02) { // LINK_ALARM_ON, LINK_ALARM_OFF
+				w->handshakeFrames++;
+			}
+			w->sniffState = 3;
+		break;
+		case 3: // length
+			w->sniffLeft = data;
+			w->sniffState = data ? 4 : 5;
+		break;
+		case 4: // payload
+			if(w->sniffType == 0x30 && w->sniffLeft == 1 && (data & 0x01)) { // LINK_POLL, LINK_POLL_ALARM
+				w->alarmPolls++;
+			}
+			if(--w->sniffLeft == 0) {
+				w->sniffState = 5;
+			}
+		break;
+		case 5: // CRC
+			w->sniffState = 0;
+		break;
+	}
+}
+
+static void WireSend(void *ctx, unsigned char usartNum, unsigned char data) {
+	struct Wire *w = ctx;
+	unsigned long due;
+	if(usartNum == 1) { // USART1 is not part of the link
+		return;
+	}
+	w->sent++;
+	WireSniff(w, data);
+	if(Rand() % 100 < w->fault->lossPct) {
+		w->lost++;
+		return;
+	}
+	if(Rand() % 100 < w->fault->corruptPct) {
+		data ^= (unsigned char)(1 << (Rand() % 8));
+		w->corrupted++;
+	}
+	due = w->now + w->fault->latencyMs;
+	if(w->fault->jitterMs) {
+		due += Rand() % (w->fault->jitterMs + 1);
+	}
+	if(due < w->lastDue) { // a UART never reorders bytes
+		due = w->lastDue;
+	}
+	w->lastDue = due;
+	if(((w->tail + 1) % WIRE_DEPTH) == w->head) {
+		w->lost++;
+		return;
+	}
+	w->due[w->tail] = due;
+	w->data[w->tail] = data;
+	w->tail = (w->tail + 1) % WIRE_DEPTH;
+}
+
+static void WireDeliver(struct Wire *w, struct Node *to) {
+	while(w->head != w->tail && w->due[w->head] <= w->now) {
+		to->deliver(0, w->data[w->head]);
+		w->head = (w->head + 1) % WIRE_DEPTH;
+	}
+}
+
+static void *Sym(void *so, const char *name) {
+	void *p = dlsym(so, name);
+	if(!p) {
+		fprintf(stderr, "linksim: missing symbol %s\n", name);
+		exit(2);
+	}
+	return p;
+}
+
+static void LoadNode(struct Node *n, const char *path, const struct SimTask *tasks) {
+	unsigned k;
+	n->so = dlopen(path, RTLD_LAZY | RTLD_LOCAL);
+	if(!n->so) {
+		fprintf(stderr, "linksim: %s\n", dlerror());
+		exit(2);
+	}
+	memcpy(n->tasks, tasks, sizeof(n->tasks));
+	for(k = 0; k < SIM_MAX_TASKS && n->tasks[k].tickName; k++) {
+		n->tasks[k].init = n->tasks[k].initName ? (void (*)(void))dlsym(n->so, n->tasks[k].initName) : NULL;
+		n->tasks[k].tick = (void (*)(void))dlsym(n->so, n->tasks[k].tickName);
+		n->tasks[k].phase = Rand() % n->tasks[k].period;
+	}
+	n->setTicks = (void (*)(unsigned long))dlsym(n->so, "sim_set_ticks");
+	n->deliver = (void (*)(unsigned char, unsigned char))Sym(n->so, "sim_deliver");
+	n->attach = (void (*)(void (*)(void *, unsigned char, unsigned char), void *))Sym(n->so, "sim_attach");
+	n->txBytes = (unsigned long (*)(unsigned char))Sym(n->so, "sim_tx_bytes");
+	n->overruns = (unsigned long (*)(unsigned char))Sym(n->so, "sim_overruns");
+}
+
+static void NodeInit(struct Node *n) {
+	unsigned k;
+	for(k = 0; k < sizeof(startup) / sizeof(startup[0]); k++) { // main() is never run
+		void (*init)(void) = (void (*)(void))dlsym(n->so, startup[k]);
+		if(init) {
+			init();
+		}
+	}
+	for(k = 0; k < SIM_MAX_TASKS; k++) {
+		if(n->tasks[k].init) {
+			n->tasks[k].init();
+		}
+	}
+}
+
+static void NodeTick(struct Node *n, unsigned long t) {
+	unsigned k;
+	for(k = 0; k < SIM_MAX_TASKS; k++) {
+		if(n->tasks[k].tick && t % n->tasks[k].period == n->tasks[k].phase) {
+			n->tasks[k].tick();
+		}
+	}
+}
+
+/* Runs one handshake in a fresh process so every trial starts from the
+   firmware's power-on state. */
+static struct TrialResult RunTrial(const char *clockPath, const char *sensorPath, const struct FaultProfile *fault, unsigned seed) {
+	struct TrialResult r;
+	struct Node clock, sensor;
+	static struct Wire toSensor, toClock;
+	void (*setTime)(uint8_t, uint8_t, uint8_t, unsigned char);
+	void (*updateTime)(void);
+	void (*alarmSet)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char);
+	unsigned char *alarmOnFlag;
+	volatile uint8_t *sensorPINA;
+	unsigned char *radioUp;
+	const struct HeartbeatStats *heartbeat;
+	unsigned long t, start = 0, second = 0;
+	unsigned char wasOn = 0;
+
+	memset(&r, 0, sizeof(r));
+	memset(&toSensor, 0, sizeof(toSensor));
+	memset(&toClock, 0, sizeof(toClock));
+	rngState = 2463534242u ^ (seed * 2654435761u);
+	if(!rngState) {
+		rngState = 1;
+	}
+	toSensor.fault = fault;
+	toClock.fault = fault;
+
+	LoadNode(&clock, clockPath, clockTasks);
+	LoadNode(&sensor, sensorPath, sensorTasks);
+	clock.attach(WireSend, &toSensor);
+	sensor.attach(WireSend, &toClock);
+
+	setTime = (void (*)(uint8_t, uint8_t, uint8_t, unsigned char))Sym(clock.so, "sim_set_time");
+	updateTime = (void (*)(void))Sym(clock.so, "UpdateTime");
+	alarmSet = (void (*)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char))
+		Sym(clock.so, "Alarm_Set");
+	alarmOnFlag = Sym(clock.so, "alarmOnFlag");
+	sensorPINA = Sym(sensor.so, "PINA");
+	radioUp = dlsym(sensor.so, "hc05LinkUp");
+	if(radioUp) { // The radios are taken as paired for the whole run
+		*radioUp = 1;
+	}
+
+	// Alarm at 7:00 AM in 12 hour mode, clock starts 6:49:50 so the
+	// 10 minute lead fires within the first few simulated seconds.
+	alarmSet(0, 7 * 60, 0, 10, 0, 0);
+	*sensorPINA = 0x01; // Sleeper already standing on the FSR
+
+	NodeInit(&clock);
+	NodeInit(&sensor);
+	second = 6 * 3600UL + 49 * 60UL + 50;
+	setTime(second / 3600, (second / 60) % 60, second % 60, 0);
+	updateTime();
+
+	for(t = 0; t < SIM_TIMEOUT_MS + 60000UL; t++) {
+		toSensor.now = t;
+		toClock.now = t;
+		if(clock.setTicks) {
+			clock.setTicks(t);
+		}
+		if(sensor.setTicks) {
+			sensor.setTicks(t);
+		}
+		WireDeliver(&toSensor, &sensor);
+		WireDeliver(&toClock, &clock);
+		if(t % 1000 == 0) {
+			setTime((second / 3600) % 24, (second / 60) % 60, second % 60, RTC_KEEP);
+			updateTime();
+			second++;
+		}
+		NodeTick(&sensor, t);
+		NodeTick(&clock, t);
+		if(!start && (toSensor.handshakeFrames || toSensor.alarmPolls)) {
+			start = t;
+		}
+		if(*alarmOnFlag) {
+			wasOn = 1;
+		}
+		else if(wasOn) {
+			r.completed = 1;
+			r.handshakeMs = t - start;
+			break;
+		}
+		if(start && t - start >= SIM_TIMEOUT_MS) {
+			break;
+		}
+	}
+	r.clockTx = toSensor.handshakeFrames;
+	r.sensorTx = toClock.handshakeFrames;
+	r.lost = toSensor.lost + toClock.lost;
+	r.corrupted = toSensor.corrupted + toClock.corrupted;
+	r.overruns = clock.overruns(0) + sensor.overruns(0);
+	heartbeat = dlsym(clock.so, "linkMon");
+	if(heartbeat) {
+		unsigned int (*rttAvg)(void) = (unsigned int (*)(void))Sym(clock.so, "LinkMon_RttAvg");
+		r.pings = heartbeat->sent;
+		r.pongs = heartbeat->received;
+		r.rttSum = (unsigned long)rttAvg() * heartbeat->received;
+	}
+	return r;
+}
+
+static struct TrialResult RunTrialIsolated(const char *clockPath, const char *sensorPath, const struct FaultProfile *fault, unsigned seed) {
+	struct TrialResult r;
+	int fd[2];
+	pid_t pid;
+
+	memset(&r, 0, sizeof(r));
+	if(pipe(fd) != 0) {
+		perror("pipe");
+		exit(2);
+	}
+	fflush(stdout);
+	pid = fork();
+	if(pid == 0) {
+		close(fd[0]);
+		r = RunTrial(clockPath, sensorPath, fault, seed);
+		if(write(fd[1], &r, sizeof(r)) != sizeof(r)) {
+			_exit(3);
+		}
+		_exit(0);
+	}
+	close(fd[1]);
+	if(read(fd[0], &r, sizeof(r)) != sizeof(r)) {
+		fprintf(stderr, "linksim: trial %u of %s crashed\n", seed, fault->name);
+	}
+	close(fd[0]);
+	waitpid(pid, NULL, 0);
+	return r;
+}
+
+int main(int argc, char **argv) {
+	unsigned trials = 50;
+	unsigned p, n;
+
+	if(argc < 3) {
+		fprintf(stderr, "usage: %s clock_node.so sensor_node.so [trials]\n", argv[0]);
+		return 1;
+	}
+	if(argc > 3) {
+		trials = (unsigned)atoi(argv[3]);
+	}
+
+	printf("%-14s %7s %9s %9s %9s %10s %10s %6s %6s %6s %8s %7s\n",
+		"profile", "done", "min ms", "avg ms", "max ms", "clk retry", "sns retry", "lost", "corr", "ovr", "hb reply", "hb rtt");
+	for(p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++) {
+		unsigned done = 0;
+		unsigned long minMs = (unsigned long)-1, maxMs = 0, sumMs = 0;
+		unsigned long clockRetry = 0, sensorRetry = 0, lost = 0, corrupted = 0, overruns = 0;
+		unsigned long pings = 0, pongs = 0, rttSum = 0;
+		for(n = 0; n < trials; n++) {
+			struct TrialResult r = RunTrialIsolated(argv[1], argv[2], &profiles[p], n + 1);
+			if(r.completed) {
+				done++;
+				sumMs += r.handshakeMs;
+				if(r.handshakeMs < minMs) {
+					minMs = r.handshakeMs;
+				}
+				if(r.handshakeMs > maxMs) {
+					maxMs = r.handshakeMs;
+				}
+			}
+			clockRetry += r.clockTx ? r.clockTx - 1 : 0;
+			sensorRetry += r.sensorTx ? r.sensorTx - 1 : 0;
+			lost += r.lost;
+			corrupted += r.corrupted;
+			overruns += r.overruns;
+			pings += r.pings;
+			pongs += r.pongs;
+			rttSum += r.rttSum;
+		}
+		printf("%-14s %3u/%-3u %9lu %9lu %9lu %10.2f %10.2f %6lu %6lu %6lu %7.0f%% %7lu\n",
+			profiles[p].name, done, trials,
+			done ? minMs : 0, done ? sumMs / done : 0, maxMs,
+			(double)clockRetry / trials, (double)sensorRetry / trials,
+			lost, corrupted, overruns,
+			pings ? 100.0 * pongs / pings : 0.0, pongs ? rttSum / pongs : 0);
+	}
+	return 0;
+}
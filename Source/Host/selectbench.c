@@ -0,0 +1,163 @@
+/* Ready task selection benchmark
+   Runs the two ways tasks.c can find the highest ready priority side by
+   side: walking uxTopReadyPriority down past the empty ready lists (the
+   V7.1.1 scheduler) and the bitmap with the nibble table
+   (configUSE_PORT_OPTIMISED_TASK_SELECTION). The ready lists are reduced to
+   a count of tasks per priority and the functions follow the macros in
+   tasks.c, so this checks the bookkeeping and counts the work, not the
+   kernel itself.
+
+   For 1, 4 and 8 priorities it plays two loads:
+     tick   - the top task wakes every tick and blocks again, the rest wait,
+              as the clock's tasks do most of the time (the worst case for
+              the walk, which goes all the way down to idle each time)
+     random - tasks at random priorities become ready and block
+   and prints how many ready lists the walk tests for each selection, where
+   the bitmap always does one lookup. Both ways must pick the same priority
+   every time. On the AVR each list tested is a load of its length, a
+   compare and a decrement of uxTopReadyPriority; host timings say nothing
+   about that, so none are printed.
+   Build with  gcc -O2 -o selectbench selectbench.c */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STEPS 2000000
+#define MAX_PRIORITIES 8
+
+static unsigned char ready[MAX_PRIORITIES]; // tasks in each ready list
+static unsigned long looked; // ready lists tested for empty
+
+/* Generic: uxTopReadyPriority is a priority */
+static unsigned char topReady;
+
+static void GenericRecord(unsigned char priority) {
+	if(priority > topReady) {
+		topReady = priority;
+	}
+}
+
+static unsigned char GenericSelect() {
+	looked++;
+	while(!ready[topReady]) {
+		--topReady;
+		looked++;
+	}
+	return topReady;
+}
+
+/* Optimised: uxTopReadyPriority is a bitmap */
+static const unsigned char priorityBit[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+static const unsigned char topBitOfNibble[16] = {0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3};
+static unsigned char readyBits;
+
+static void BitmapRecord(unsigned char priority) {
+	readyBits |= priorityBit[priority];
+}
+
+static void BitmapReset(unsigned char priority) {
+	if(!ready[priority]) {
+		readyBits &= (unsigned char)~priorityBit[priority];
+	}
+}
+
+static unsigned char BitmapSelect() {
+	unsigned char ready = readyBits;
+	return (ready & 0xf0) ? topBitOfNibble[ready >> 4] + 4 : topBitOfNibble[ready];
+}
+
+struct Load {
+	unsigned char priority; // task that changes state
+	unsigned char wake; // 1 it becomes ready, 0 it blocks
+};
+
+static struct Load loads[STEPS];
+
+// Tick load: the top task wakes and blocks, idle (priority 0) stays ready
+static unsigned TickLoad(unsigned char priorities) {
+	unsigned n;
+	for(n = 0; n < STEPS; n++) {
+		loads[n].priority = priorities - 1;
+		loads[n].wake = !(n & 1);
+	}
+	return STEPS;
+}
+
+// Random load: two tasks at each priority above idle, one of them at a
+// random priority wakes or blocks
+static unsigned RandomLoad(unsigned char priorities) {
+	unsigned char blocked[MAX_PRIORITIES];
+	unsigned n;
+	srand(priorities);
+	for(n = 0; n < MAX_PRIORITIES; n++) {
+		blocked[n] = 2;
+	}
+	for(n = 0; n < STEPS; n++) {
+		unsigned char p = 0;
+		if(priorities > 1) {
+			p = 1 + rand() % (priorities - 1);
+		}
+		loads[n].priority = p;
+		loads[n].wake = !p || blocked[p] == 2 || (blocked[p] && (rand() & 1));
+		if(p) {
+			blocked[p] += loads[n].wake ? -1 : 1;
+		}
+	}
+	return STEPS;
+}
+
+// Start with idle ready and the other tasks blocked
+static void Reset() {
+	unsigned char p;
+	for(p = 0; p < MAX_PRIORITIES; p++) {
+		ready[p] = 0;
+	}
+	topReady = 0;
+	readyBits = 0;
+	ready[0] = 1;
+	GenericRecord(0);
+	BitmapRecord(0);
+}
+
+static void Apply(const struct Load *l) {
+	if(l->wake) {
+		if(l->priority) {
+			ready[l->priority]++;
+		}
+		GenericRecord(l->priority);
+		BitmapRecord(l->priority);
+	}
+	else {
+		ready[l->priority]--;
+		BitmapReset(l->priority);
+	}
+}
+
+static void Run(const char *name, unsigned char priorities, unsigned steps) {
+	unsigned n;
+
+	Reset();
+	looked = 0;
+	for(n = 0; n < steps; n++) {
+		unsigned char a, b;
+		Apply(&loads[n]);
+		a = GenericSelect();
+		b = BitmapSelect();
+		if(a != b) {
+			fprintf(stderr, "selectbench: %s %u: step %u walk %u bitmap %u\n", name, priorities, n, a, b);
+			exit(1);
+		}
+	}
+	printf("%-6s %u priorities: walk %.2f lists a switch, bitmap 1 lookup\n", name, priorities, (double)looked / steps);
+}
+
+int main() {
+	static const unsigned char levels[] = {1, 4, 8};
+	unsigned n;
+	for(n = 0; n < sizeof(levels); n++) {
+		if(levels[n] > 1) {
+			Run("tick", levels[n], TickLoad(levels[n]));
+		}
+		Run("random", levels[n], RandomLoad(levels[n]));
+	}
+	return 0;
+}
@@ -0,0 +1,323 @@
+/* Settings store check
+   Loads a host build of the clock (Alarm1.c built with HOST_SIM, as for
+   coresim) and runs the EEPROM store of settings.h against the EEPROM
+   stand-in in sim_node.c. Settings_Poll is called as the idle hook would
+   call it and EE_READY_vect as the EEPROM would raise it, once per byte.
+   A reboot clears the settings in RAM, as a power cut does, and runs
+   Settings_Load.
+
+     blank    nothing is loaded from an EEPROM that was never written
+     idle     a burst of changes writes one record, only once the settings
+              have been left alone for SETTINGS_IDLE, and nothing is
+              written for a change that changes nothing back
+     cut      random settings, each record cut short by a power loss after
+              a random number of bytes: the reboot loads the new settings
+              if the record was finished and the ones before if not
+     wrap     the same, for long enough that the sequence number wraps
+
+   It then prints the bytes programmed per record and the fewest and the
+   most bytes any slot took, which should be close.
+   Prints a line per check and the first mismatches; exits 1 on any.
+   Build with  gcc -O2 -o settingscheck Host/settingscheck.c -ldl
+   and run     settingscheck clock.so */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#define NONE 0xFFFF
+#define MAX_ALARMS 16 // ALARM_MAX
+#define SLOTS 16 // SETTINGS_SLOTS
+#define IDLE 5000 // SETTINGS_IDLE, ms
+#define EERIE 3
+#define SHOW_ERRORS 5
+
+/* The clock's struct ClockState (clockstate.h) */
+struct ClockState {
+	uint8_t hour, minute, second, weekday;
+	unsigned char hourMode, alarmId, alarmLead;
+	unsigned int alarmMinute, alarmNext;
+};
+
+/* The clock's struct Alarm (alarm.h) */
+struct Alarm {
+	unsigned int minute;
+	unsigned char days, lead, melody, sleepers, on;
+	unsigned int next;
+};
+
+/* The clock's struct SettingsRecord (settings.h) */
+struct SettingsRecord {
+	unsigned char version;
+	uint16_t seq;
+	struct {
+		unsigned char hourMode;
+		struct {
+			unsigned int minute;
+			unsigned char days, lead, melody, sleepers;
+		} alarms[MAX_ALARMS];
+	} settings;
+	uint16_t crc;
+};
+
+/* What the settings should load back as */
+struct Expect {
+	unsigned char hourMode;
+	struct Alarm alarms[MAX_ALARMS];
+};
+
+static void (*setTicks)(unsigned long);
+static void (*alarmSet)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char);
+static void (*changed)(void);
+static void (*poll)(void);
+static void (*eeReady)(void);
+static void (*load)(void);
+static uint8_t (*eepromRead)(const uint8_t *);
+static unsigned long (*eepromWrites)(const void *);
+static struct ClockState *clockState;
+static struct Alarm *alarms;
+static unsigned char *alarmCount;
+static struct SettingsRecord *ring, *out;
+static volatile uint8_t *eecr;
+static unsigned int *records, *bytes;
+static unsigned long ticks, errors, seed = 1;
+
+static void *Sym(void *so, const char *name) {
+	void *p = dlsym(so, name);
+	if(!p) {
+		fprintf(stderr, "settingscheck: missing symbol %s\n", name);
+		exit(2);
+	}
+	return p;
+}
+
+static void Mismatch(const char *check, unsigned n, const char *what, unsigned got, unsigned want) {
+	if(errors++ < SHOW_ERRORS) {
+		fprintf(stderr, "settingscheck: %s, case %u: %s: got %u, want %u\n", check, n, what, got, want);
+	}
+}
+
+static void Report(const char *check, unsigned long cases, unsigned long before) {
+	printf("%-6s %8lu cases  %s\n", check, cases, errors == before ? "ok" : "FAILED");
+}
+
+static unsigned Random(unsigned range) {
+	seed = seed * 1103515245UL + 12345UL;
+	return (seed >> 16) % range;
+}
+
+static void Wait(unsigned long ms) {
+	ticks += ms;
+	setTicks(ticks);
+}
+
+static int Writing(void) {
+	return (*eecr >> EERIE) & 1;
+}
+
+// Raises EE_READY up to 'most' times, while it stays enabled. Returns how
+// many times it ran.
+static unsigned Drain(unsigned most) {
+	unsigned n = 0;
+	while(Writing() && n < most) {
+		eeReady();
+		n++;
+	}
+	return n;
+}
+
+// Whether settingsOut is in the EEPROM whole. The interrupt can still be on
+// when it is, to find the bytes after the last it wrote already match.
+static int Written(void) {
+	unsigned slot, k;
+	for(slot = 0; slot < SLOTS; slot++) {
+		for(k = 0; k < sizeof(*ring) && eepromRead((const uint8_t *)&ring[slot] + k) == ((uint8_t *)out)[k]; k++) {
+		}
+		if(k == sizeof(*ring)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void Reboot(void) {
+	*eecr = 0;
+	memset(out, 0, sizeof(*out));
+	memset(alarms, 0, MAX_ALARMS * sizeof(*alarms));
+	*alarmCount = 0;
+	clockState->hourMode = 0;
+	load();
+}
+
+static void Take(struct Expect *e) {
+	unsigned id;
+	memset(e, 0, sizeof(*e)); // Padding too, for memcmp
+	e->hourMode = clockState->hourMode;
+	for(id = 0; id < MAX_ALARMS; id++) {
+		e->alarms[id] = alarms[id];
+	}
+}
+
+static void Compare(const char *check, unsigned n, const struct Expect *e) {
+	unsigned id;
+	if(clockState->hourMode != e->hourMode) {
+		Mismatch(check, n, "hour mode", clockState->hourMode, e->hourMode);
+	}
+	for(id = 0; id < MAX_ALARMS; id++) {
+		const struct Alarm *a = &alarms[id], *w = &e->alarms[id];
+		if(a->on != w->on || (w->on && (a->minute != w->minute || a->days != w->days || a->lead != w->lead ||
+			a->melody != w->melody || a->sleepers != w->sleepers))) {
+			Mismatch(check, n, "alarm minute", a->on ? a->minute : NONE, w->on ? w->minute : NONE);
+			return;
+		}
+	}
+}
+
+// Sets something at random: an alarm, a cleared alarm or the hour mode
+static void Change(void) {
+	switch(Random(5)) {
+		case 0:
+			alarmSet(Random(MAX_ALARMS), NONE, 0, 0, 0, 0);
+		break;
+		case 1:
+			clockState->hourMode = !clockState->hourMode;
+		break;
+		default:
+			alarmSet(Random(MAX_ALARMS), Random(1440), Random(128), Random(61), Random(2), Random(256));
+		break;
+	}
+	changed();
+}
+
+static void Blank(void) {
+	unsigned long before = errors;
+	struct Expect e;
+	Reboot();
+	Take(&e);
+	if(*alarmCount != 0 || clockState->hourMode != 0) {
+		Mismatch("blank", 0, "alarms on", *alarmCount, 0);
+	}
+	Report("blank", 1, before);
+}
+
+static void Idle(void) {
+	unsigned long before = errors;
+	unsigned n, start = *records;
+	struct Expect e;
+	for(n = 0; n < 20; n++) { // A burst of presses, 200 ms apart
+		Change();
+		Wait(200);
+		poll();
+		if(Writing()) {
+			Mismatch("idle", n, "writing before the idle time", 1, 0);
+		}
+	}
+	Wait(IDLE - 201);
+	poll();
+	if(Writing()) {
+		Mismatch("idle", n, "writing a ms early", 1, 0);
+	}
+	Wait(1);
+	poll();
+	Drain(1000);
+	if(*records - start != 1) {
+		Mismatch("idle", n, "records for the burst", *records - start, 1);
+	}
+	Take(&e);
+	Reboot();
+	Compare("idle", n, &e);
+
+	clockState->hourMode = !clockState->hourMode; // And back again
+	changed();
+	Wait(100);
+	clockState->hourMode = !clockState->hourMode;
+	changed();
+	Wait(IDLE);
+	poll();
+	Drain(1000);
+	if(*records - start != 1) {
+		Mismatch("idle", n, "records for no change", *records - start, 1);
+	}
+	Report("idle", n + 2, before);
+}
+
+static void Cut(const char *check, unsigned records) {
+	unsigned long before = errors;
+	unsigned n, cut, done;
+	struct Expect old, now;
+	for(n = 0; n < records; n++) {
+		Take(&old);
+		do {
+			Change();
+			Take(&now);
+		} while(!memcmp(&now, &old, sizeof(now)));
+		Wait(IDLE);
+		poll();
+		if(!Writing()) {
+			Mismatch(check, n, "record started", 0, 1);
+			continue;
+		}
+		cut = Random(4) ? sizeof(*out) + 1 : Random(sizeof(*out));
+		Drain(cut);
+		done = Written();
+		Reboot();
+		Compare(check, n, done ? &now : &old);
+	}
+	Report(check, records, before);
+}
+
+static void Wear(void) {
+	unsigned long most = 0, least = ~0UL, w;
+	unsigned slot, k;
+	for(slot = 0; slot < SLOTS; slot++) {
+		for(w = 0, k = 0; k < sizeof(*ring); k++) {
+			w += eepromWrites((const uint8_t *)&ring[slot] + k);
+		}
+		if(w > most) {
+			most = w;
+		}
+		if(w < least) {
+			least = w;
+		}
+	}
+	printf("wear   %u records, %.1f bytes programmed a record, %lu to %lu a slot\n",
+		*records, (double)*bytes / *records, least, most);
+}
+
+int main(int argc, char **argv) {
+	void *so;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s clock.so\n", argv[0]);
+		return 2;
+	}
+	if(!(so = dlopen(argv[1], RTLD_LAZY | RTLD_LOCAL))) {
+		fprintf(stderr, "settingscheck: %s\n", dlerror());
+		return 2;
+	}
+	setTicks = (void (*)(unsigned long))Sym(so, "sim_set_ticks");
+	alarmSet = (void (*)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char))
+		Sym(so, "Alarm_Set");
+	changed = (void (*)(void))Sym(so, "Settings_Changed");
+	poll = (void (*)(void))Sym(so, "Settings_Poll");
+	eeReady = (void (*)(void))Sym(so, "EE_READY_vect");
+	load = (void (*)(void))Sym(so, "Settings_Load");
+	eepromRead = (uint8_t (*)(const uint8_t *))Sym(so, "eeprom_read_byte");
+	eepromWrites = (unsigned long (*)(const void *))Sym(so, "sim_eeprom_writes");
+	clockState = Sym(so, "clockState");
+	alarms = Sym(so, "alarms");
+	alarmCount = Sym(so, "alarmCount");
+	ring = Sym(so, "settingsRing");
+	out = Sym(so, "settingsOut");
+	eecr = Sym(so, "EECR");
+	records = Sym(so, "settingsRecords");
+	bytes = Sym(so, "settingsBytes");
+
+	Blank();
+	Idle();
+	Cut("cut", 2000);
+	Cut("wrap", 90000); // About 3 in 4 records finish, so the sequence number comes round
+	Wear();
+	return errors != 0;
+}
@@ -0,0 +1,412 @@
+/* Node-side glue for the host link simulator
+   Compiled into each node's shared object next to the firmware source
+   (Alarm1.c or Bluetooth/main.c) and sim_regs.c. Provides the USART model
+   behind usart_ATmega1284.h and a fake DS3231 driven by simulated time.
+   Every node is loaded with its own copy of this state. */
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+
+/* USART model
+   The ATmega1284 receiver holds two bytes; a third arriving before the
+   firmware reads is lost (data overrun). UDR is always free because the
+   simulator takes a written byte immediately, and TXC is set from then on
+   since nothing in the firmware clears it. */
+#define SIM_RX_DEPTH 2
+
+struct SimUsart {
+	unsigned char rx[SIM_RX_DEPTH];
+	unsigned char rxCount;
+	unsigned char txc;
+	unsigned long overruns;
+	unsigned long txBytes;
+	unsigned long rxBytes;
+};
+
+static struct SimUsart simUsart[2];
+static void (*simTx)(void *ctx, unsigned char usartNum, unsigned char data);
+static void *simTxCtx;
+static uint8_t eepromImage[4096];
+static unsigned long eepromWrites[4096]; // per cell, for wear counts
+
+/* Receive interrupt, if the firmware has one and has enabled it */
+extern void USART0_RX_vect(void) __attribute__((weak));
+
+static struct SimUsart *SimPort(unsigned char usartNum) {
+	return &simUsart[usartNum == 1];
+}
+
+unsigned char host_usart_status(unsigned char usartNum) {
+	struct SimUsart *u = SimPort(usartNum);
+	unsigned char status = (1 << UDRE0);
+	if(u->txc) {
+		status |= (1 << TXC0);
+	}
+	if(u->rxCount) {
+		status |= (1 << RXC0);
+	}
+	return status;
+}
+
+void host_usart_write(unsigned char usartNum, unsigned char data) {
+	struct SimUsart *u = SimPort(usartNum);
+	u->txc = 1;
+	u->txBytes++;
+	if(simTx) {
+		simTx(simTxCtx, usartNum, data);
+	}
+}
+
+unsigned char host_usart_read(unsigned char usartNum) {
+	struct SimUsart *u = SimPort(usartNum);
+	unsigned char data;
+	if(!u->rxCount) { // Reading an empty UDR returns the stale byte
+		return u->rx[0];
+	}
+	data = u->rx[0];
+	u->rx[0] = u->rx[1];
+	u->rxCount--;
+	return data;
+}
+
+void host_usart_baud(unsigned char usartNum, unsigned long baud) {
+	(void)usartNum; // Both ends of the in-process pipe always agree
+	(void)baud;
+}
+
+/* Simulator entry points (looked up with dlsym) */
+void sim_attach(void (*tx)(void *, unsigned char, unsigned char), void *ctx) {
+	simTx = tx;
+	simTxCtx = ctx;
+}
+
+void sim_deliver(unsigned char usartNum, unsigned char data) {
+	struct SimUsart *u = SimPort(usartNum);
+	if(u->rxCount >= SIM_RX_DEPTH) {
+		u->overruns++;
+		return;
+	}
+	u->rx[u->rxCount++] = data;
+	u->rxBytes++;
+	if(usartNum != 1 && (UCSR0B & (1 << RXCIE0)) && USART0_RX_vect) {
+		USART0_RX_vect();
+	}
+}
+
+unsigned long sim_overruns(unsigned char usartNum) {
+	return SimPort(usartNum)->overruns;
+}
+
+unsigned long sim_tx_bytes(unsigned char usartNum) {
+	return SimPort(usartNum)->txBytes;
+}
+
+/* Software timers: a callback runs from sim_set_ticks once a period has
+   gone since the timer started, as the timer task would run it. A period
+   can be most of the 16 bit tick count, so what is compared is the time
+   gone, not the tick it expires at. */
+#define SIM_TIMERS 4
+
+struct SimTimer {
+	uint16_t period, start;
+	unsigned char autoReload, active;
+	void *id;
+	void (*callback)(void *);
+};
+
+static struct SimTimer simTimers[SIM_TIMERS];
+static unsigned char simTimerCount;
+
+/* Tick count, advanced by the simulator once per simulated ms */
+static uint16_t simTicks;
+
+void sim_set_ticks(unsigned long t) {
+	unsigned char n;
+	simTicks = (uint16_t)t;
+	for(n = 0; n < simTimerCount; n++) {
+		struct SimTimer *tm = &simTimers[n];
+		if(tm->active && (uint16_t)(simTicks - tm->start) >= tm->period) {
+			tm->active = tm->autoReload;
+			tm->start += tm->period;
+			tm->callback(tm);
+		}
+	}
+}
+
+void *xTimerCreate(const signed char *name, uint16_t period, char autoReload, void *id, void (*callback)(void *)) {
+	struct SimTimer *tm;
+	(void)name;
+	if(simTimerCount >= SIM_TIMERS) {
+		return NULL;
+	}
+	tm = &simTimers[simTimerCount++];
+	tm->period = period;
+	tm->autoReload = autoReload;
+	tm->id = id;
+	tm->callback = callback;
+	return tm;
+}
+
+char xTimerStart(void *handle, uint16_t ticks) {
+	struct SimTimer *tm = handle;
+	(void)ticks;
+	tm->start = simTicks;
+	tm->active = 1;
+	return 1;
+}
+
+char xTimerReset(void *handle, uint16_t ticks) {
+	return xTimerStart(handle, ticks);
+}
+
+char xTimerStop(void *handle, uint16_t ticks) {
+	(void)ticks;
+	((struct SimTimer *)handle)->active = 0;
+	return 1;
+}
+
+char xTimerIsTimerActive(void *handle) {
+	return ((struct SimTimer *)handle)->active;
+}
+
+void *pvTimerGetTimerID(void *handle) {
+	return ((struct SimTimer *)handle)->id;
+}
+
+uint16_t xTaskGetTickCount(void) {
+	return simTicks;
+}
+
+uint16_t xTaskGetTickCountFromISR(void) {
+	return simTicks;
+}
+
+/* A simulator that runs a whole task loop, rather than its Tick, hands
+   the task the CPU in a context of its own and sets a block hook. The
+   hook gets the tick the task asked to wake at and returns once the
+   simulator has run it to there, or at once if that tick has passed. */
+static void (*simBlock)(uint16_t wakeAt);
+
+void sim_on_block(void (*block)(uint16_t)) {
+	simBlock = block;
+}
+
+void vTaskDelayUntil(uint16_t *previousWake, uint16_t increment) {
+	*previousWake += increment;
+	if(simBlock) {
+		simBlock(*previousWake);
+	}
+}
+
+/* Queues: one ring each, never blocking (see include/queue.h) */
+#define SIM_QUEUES 4
+#define SIM_QUEUE_BYTES 64
+
+struct SimQueue {
+	unsigned char data[SIM_QUEUE_BYTES];
+	unsigned char length, itemSize, head, count;
+};
+
+static struct SimQueue simQueues[SIM_QUEUES];
+static unsigned char simQueueCount;
+
+void *xQueueCreate(unsigned char length, unsigned char itemSize) {
+	struct SimQueue *q;
+	if(simQueueCount >= SIM_QUEUES || length * itemSize > SIM_QUEUE_BYTES) {
+		return NULL;
+	}
+	q = &simQueues[simQueueCount++];
+	q->length = length;
+	q->itemSize = itemSize;
+	return q;
+}
+
+/* A mutex is a queue of one empty item that starts full, as in queue.c */
+void *xQueueCreateMutex(unsigned char type) {
+	struct SimQueue *q = xQueueCreate(1, 0);
+	(void)type;
+	if(q) {
+		q->count = 1;
+	}
+	return q;
+}
+
+signed char xQueueSend(void *handle, const void *item, uint16_t ticks) {
+	struct SimQueue *q = handle;
+	(void)ticks;
+	if(q->count >= q->length) {
+		return 0;
+	}
+	memcpy(&q->data[((q->head + q->count) % q->length) * q->itemSize], item, q->itemSize);
+	q->count++;
+	return 1;
+}
+
+signed char xQueueSendFromISR(void *handle, const void *item, signed char *woken) {
+	*woken = 0;
+	return xQueueSend(handle, item, 0);
+}
+
+signed char xQueueReceive(void *handle, void *item, uint16_t ticks) {
+	struct SimQueue *q = handle;
+	(void)ticks;
+	if(!q->count) {
+		return 0;
+	}
+	memcpy(item, &q->data[q->head * q->itemSize], q->itemSize);
+	q->head = (q->head + 1) % q->length;
+	q->count--;
+	return 1;
+}
+
+unsigned char uxQueueMessagesWaiting(void *handle) {
+	return ((struct SimQueue *)handle)->count;
+}
+
+/* Scheduler lock: the simulator never preempts, so these are no-ops */
+void vTaskSuspendAll(void) {
+}
+
+signed char xTaskResumeAll(void) {
+	return 0;
+}
+
+/* EEPROM */
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+	return eepromImage[(uintptr_t)addr % sizeof(eepromImage)];
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value) {
+	eepromImage[(uintptr_t)addr % sizeof(eepromImage)] = value;
+	eepromWrites[(uintptr_t)addr % sizeof(eepromImage)]++;
+}
+
+unsigned long sim_eeprom_writes(const void *addr) {
+	return eepromWrites[(uintptr_t)addr % sizeof(eepromImage)];
+}
+
+/* DS3231 stand-in: the simulator sets the time with sim_set_time() and
+   the day of the week with sim_set_day(). The hour register is written in
+   the 12 or 24 hour layout hourMode gives, or with SIM_RTC_KEEP in the one
+   it is in, which on the chip only the clock's own writes change. Alarm 1
+   is kept as written; when the time registers reach it, compared raw as
+   the chip compares them, with its interrupt on, A1F is set and INT/SQW,
+   PA6, goes low until the next write. */
+#define SIM_RTC_INT 0x40 // PINA
+#define SIM_RTC_KEEP 2 // sim_set_time hourMode: the layout the hour register is in
+
+static uint8_t rtcSec, rtcMin, rtcHr, rtcDay = 1, rtcDate = 1, rtcMnth = 1, rtcYr = 18;
+static uint8_t rtcAlarm1[4], rtcControl = 0x1C, rtcStatus = 0x88;
+
+uint8_t dec2bcd(uint8_t d) {
+	return ((d/10 * 16) + (d % 10));
+}
+
+uint8_t bcd2dec(uint8_t b) {
+	return ((b/16 * 10) + (b % 16));
+}
+
+static void SimRtcFlag(uint8_t status) {
+	rtcStatus = status;
+	if((rtcStatus & 0x01) && (rtcControl & 0x05) == 0x05) {
+		PINA &= ~SIM_RTC_INT;
+	}
+	else {
+		PINA |= SIM_RTC_INT;
+	}
+}
+
+void sim_set_time(uint8_t hour24, uint8_t minute, uint8_t second, unsigned char hourMode) {
+	if(hourMode == SIM_RTC_KEEP) {
+		hourMode = !(rtcHr & 0x40);
+	}
+	rtcSec = dec2bcd(second);
+	rtcMin = dec2bcd(minute);
+	if(hourMode == 0) { // 12 hour register layout
+		uint8_t h12 = hour24 % 12;
+		if(h12 == 0) {
+			h12 = 12;
+		}
+		rtcHr = 0x40 | ((hour24 >= 12) << 5) | dec2bcd(h12);
+	}
+	else {
+		rtcHr = dec2bcd(hour24);
+	}
+	if(rtcAlarm1[0] == rtcSec && rtcAlarm1[1] == rtcMin && rtcAlarm1[2] == rtcHr && rtcAlarm1[3] == (0x40 | rtcDay)) {
+		SimRtcFlag(rtcStatus | 0x01);
+	}
+}
+
+void sim_set_day(uint8_t day) { // 1 is Sunday
+	rtcDay = day;
+}
+
+void ds3231_init(void) {
+}
+
+void ds3231_get(uint8_t *h,uint8_t *m,uint8_t *s,uint8_t *yr,uint8_t *mnth,uint8_t *dt,uint8_t *day) {
+	*h = rtcHr;
+	*m = rtcMin;
+	*s = rtcSec;
+	*yr = rtcYr;
+	*mnth = rtcMnth;
+	*dt = rtcDate;
+	*day = rtcDay;
+}
+
+void ds3231_setHr(uint8_t hour_ref, uint8_t hr) {
+	uint8_t hour24 = (hr & 0x40) ? bcd2dec(hr & 0x1F) % 12 + ((hr & 0x20) ? 12 : 0) : bcd2dec(hr & 0x3F);
+	uint8_t h12 = hour24 % 12 ? hour24 % 12 : 12;
+	rtcHr = hour_ref ? dec2bcd(hour24) : 0x40 | ((hour24 >= 12) << 5) | dec2bcd(h12);
+}
+
+void ds3231_setTime(uint8_t hr,uint8_t min,uint8_t sec,uint8_t ampm, unsigned char hourMode) {
+	(void)ampm;
+	(void)hourMode;
+	rtcHr = hr;
+	rtcMin = min;
+	rtcSec = sec;
+}
+
+void ds3231_setAlarm1(uint8_t min, uint8_t hr, uint8_t day) {
+	rtcAlarm1[0] = 0x00;
+	rtcAlarm1[1] = min;
+	rtcAlarm1[2] = hr & 0x3F;
+	rtcAlarm1[3] = 0x40 | (day & 0x07);
+	rtcControl = 0x1D;
+	SimRtcFlag(0x08);
+}
+
+void ds3231_alarm1Off(void) {
+	rtcControl = 0x1C;
+	SimRtcFlag(0x08);
+}
+
+/* Alarm 1 as written, 0x07-0x0A, and the control register */
+void sim_rtc_alarm1(uint8_t regs[4], uint8_t *control) {
+	memcpy(regs, rtcAlarm1, sizeof(rtcAlarm1));
+	*control = rtcControl;
+}
+
+/* Temperature in quarters of a degree, set with sim_set_temp(). Reads and
+   forced conversions are counted for sim_rtc_temp_reads(). */
+static int16_t rtcTemp = 22 * 4 + 1;
+static unsigned long rtcTempReads, rtcConverts;
+
+void sim_set_temp(int16_t quarters) {
+	rtcTemp = quarters;
+}
+
+void sim_rtc_temp_reads(unsigned long *reads, unsigned long *converts) {
+	*reads = rtcTempReads;
+	*converts = rtcConverts;
+}
+
+void ds3231_getT(int16_t *quarters) {
+	*quarters = rtcTemp;
+	rtcTempReads++;
+}
+
+void ds3231_convert(void) {
+	rtcConverts++;
+}
@@ -0,0 +1,29 @@
+/* Register file for host builds of the firmware
+   Each node (or test program) links its own copy. */
+#include <stdint.h>
+#include <avr/io.h>
+
+/* Register file */
+#define HOST_DEF8(r) volatile uint8_t r;
+#define HOST_DEF16(r) volatile uint16_t r;
+
+HOST_DEF8(PINA) HOST_DEF8(DDRA) HOST_DEF8(PORTA)
+HOST_DEF8(PINB) HOST_DEF8(DDRB) HOST_DEF8(PORTB)
+HOST_DEF8(PINC) HOST_DEF8(DDRC) HOST_DEF8(PORTC)
+HOST_DEF8(PIND) HOST_DEF8(DDRD) HOST_DEF8(PORTD)
+
+HOST_DEF8(TCCR0A) HOST_DEF8(TCCR0B) HOST_DEF8(OCR0A) HOST_DEF8(TCNT0)
+HOST_DEF8(TCCR1A) HOST_DEF8(TCCR1B) HOST_DEF8(OCR1AH) HOST_DEF8(OCR1AL) HOST_DEF8(TIMSK1)
+HOST_DEF16(TCNT1) HOST_DEF16(OCR1A)
+HOST_DEF8(TCCR2A) HOST_DEF8(TCCR2B) HOST_DEF8(OCR2A) HOST_DEF8(TCNT2) HOST_DEF8(TIMSK2) HOST_DEF8(TIFR2) HOST_DEF8(ASSR)
+HOST_DEF8(TCCR3A) HOST_DEF8(TCCR3B)
+HOST_DEF16(OCR3A) HOST_DEF16(TCNT3)
+
+HOST_DEF8(UCSR0A) HOST_DEF8(UCSR0B) HOST_DEF8(UCSR0C) HOST_DEF8(UBRR0L) HOST_DEF8(UBRR0H) HOST_DEF8(UDR0)
+HOST_DEF8(UCSR1A) HOST_DEF8(UCSR1B) HOST_DEF8(UCSR1C) HOST_DEF8(UBRR1L) HOST_DEF8(UBRR1H) HOST_DEF8(UDR1)
+
+HOST_DEF8(ADCSRA) HOST_DEF8(ADMUX)
+HOST_DEF16(ADC)
+
+HOST_DEF8(PCICR) HOST_DEF8(PCMSK0) HOST_DEF8(EICRA) HOST_DEF8(EIMSK)
+HOST_DEF8(SMCR) HOST_DEF8(EECR)
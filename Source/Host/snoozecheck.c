@@ -0,0 +1,199 @@
+/* Snooze check
+   Loads a host build of the clock made with APP_EVENTS=0 (Alarm1.c built
+   with HOST_SIM, as for coresim) and runs its polling state machines at
+   their task periods, ms by ms, with the clock a second further on every
+   1000 ms. The snooze timer is the software timer stand-in in sim_node.c,
+   run from sim_set_ticks. An alarm at 6:30 with a minute of lead rings,
+   then:
+
+     early    UP while only the light is on, before the alarm sounds,
+              does not snooze
+     ring     at 6:30 the speaker sounds
+     button   UP while it sounds silences the speaker and darkens the light
+              at once, for SNOOZE_MINUTES, and then both start again; the
+              light ramps up from dark
+     again    a second UP snoozes it again, the same way
+     up       the sleeper getting up during a snooze ends the alarm and
+              the snooze, and nothing starts again after it
+
+   Prints a line per check and the first mismatches; exits 1 on any.
+   Build with  gcc -O2 -o snoozecheck Host/snoozecheck.c -ldl
+   and run     snoozecheck clock.so */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <dlfcn.h>
+
+#define MINUTES 9 // SNOOZE_MINUTES
+#define UP_BUTTON 0x10 // PINA, active low
+#define RTC_KEEP 2 // SIM_RTC_KEEP, the hour register stays in the layout it is in
+#define SHOW_ERRORS 5
+
+/* The clock's machine states (Alarm1.c) */
+enum {LPInit, LPOff, LPOn, LPReset, LPSnooze};
+enum {AOInit, AOCheck, AOSendFlag, AOWaitSignal, AOReset, AOSnooze, AOResume};
+enum {SInit, SOff, SOn, SReset, SSnooze};
+
+/* The polling tasks of Alarm1.c and their periods in ms */
+static const struct {
+	const char *init, *tick;
+	unsigned period;
+} tasks[] = {
+	{"DisplayTime_Init", "DisplayTime_Tick", 200},
+	{"SetAlarm_Init", "SetAlarm_Tick", 50},
+	{"SetTime_Init", "SetTime_Tick", 50},
+	{"LEDPWM_Init", "LEDPWM_Tick", 200},
+	{"AlarmOn_Init", "AlarmOn_Tick", 1000},
+	{"SpeakerOn_Init", "SpeakerOn_Tick", 500},
+};
+#define TASKS (sizeof(tasks) / sizeof(tasks[0]))
+
+static void (*setTicks)(unsigned long);
+static void (*setTime)(uint8_t, uint8_t, uint8_t, unsigned char);
+static void (*ticks[TASKS])(void);
+static volatile uint8_t *pina, *ocr0a;
+static unsigned char *ledState, *alarmState, *speakerState, *alarmOnFlag, *alarmOffSignal, *snoozeLeft;
+static unsigned long t, second = 6 * 3600UL + 28 * 60 + 50, errors;
+
+static void *Sym(void *so, const char *name) {
+	void *p = dlsym(so, name);
+	if(!p) {
+		fprintf(stderr, "snoozecheck: missing symbol %s\n", name);
+		exit(2);
+	}
+	return p;
+}
+
+static void Mismatch(const char *check, const char *what, unsigned got, unsigned want) {
+	if(errors++ < SHOW_ERRORS) {
+		fprintf(stderr, "snoozecheck: %s, at %lu ms: %s: got %u, want %u\n", check, t, what, got, want);
+	}
+}
+
+static void Report(const char *check, unsigned long before) {
+	printf("%-6s %s\n", check, errors == before ? "ok" : "FAILED");
+}
+
+// Runs the clock for ms milliseconds
+static void Run(unsigned long ms) {
+	unsigned k;
+	for(; ms; ms--, t++) {
+		setTicks(t);
+		if(t % 1000 == 0) {
+			setTime((second / 3600) % 24, (second / 60) % 60, second % 60, RTC_KEEP);
+			second++;
+		}
+		for(k = 0; k < TASKS; k++) {
+			if(t % tasks[k].period == 0) {
+				ticks[k]();
+			}
+		}
+	}
+}
+
+static void Press(void) {
+	*pina &= ~UP_BUTTON;
+	Run(300);
+	*pina |= UP_BUTTON;
+}
+
+// Checks the machines are in the states given
+static void Expect(const char *check, unsigned led, unsigned alarm, unsigned speaker) {
+	if(*ledState != led) {
+		Mismatch(check, "LEDPWM state", *ledState, led);
+	}
+	if(*alarmState != alarm) {
+		Mismatch(check, "AlarmOn state", *alarmState, alarm);
+	}
+	if(*speakerState != speaker) {
+		Mismatch(check, "SpeakerOn state", *speakerState, speaker);
+	}
+}
+
+// Runs through a snooze: silent and dark all along, sounding after it
+static void Snooze(const char *check) {
+	unsigned long before = errors, end;
+	Press();
+	Run(1200); // The AlarmOn machine ticks once a second
+	Expect(check, LPSnooze, AOSnooze, SSnooze);
+	if(*snoozeLeft != MINUTES) {
+		Mismatch(check, "minutes left", *snoozeLeft, MINUTES);
+	}
+	for(end = t + MINUTES * 60000UL - 3000; t < end && errors == before; ) {
+		Run(1000);
+		if(*ocr0a != 0 || *speakerState != SSnooze) {
+			Mismatch(check, "dark and silent", *ocr0a, 0);
+		}
+	}
+	Run(4000); // Over a second after the timer, for AOResume to pass
+	Expect(check, LPOn, AOWaitSignal, SOn);
+	if(*ocr0a == 0 || *ocr0a > 20) {
+		Mismatch(check, "light ramping from dark", *ocr0a, 20);
+	}
+	Report(check, before);
+}
+
+int main(int argc, char **argv) {
+	void *so;
+	unsigned long before;
+	unsigned k;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s clock.so\n", argv[0]);
+		return 2;
+	}
+	if(!(so = dlopen(argv[1], RTLD_LAZY | RTLD_LOCAL))) {
+		fprintf(stderr, "snoozecheck: %s\n", dlerror());
+		return 2;
+	}
+	setTicks = (void (*)(unsigned long))Sym(so, "sim_set_ticks");
+	setTime = (void (*)(uint8_t, uint8_t, uint8_t, unsigned char))Sym(so, "sim_set_time");
+	pina = Sym(so, "PINA");
+	ocr0a = Sym(so, "OCR0A");
+	ledState = Sym(so, "LEDPWM_state");
+	alarmState = Sym(so, "alarmOn_state");
+	speakerState = Sym(so, "speakerOn_state");
+	alarmOnFlag = Sym(so, "alarmOnFlag");
+	alarmOffSignal = Sym(so, "alarmOffSignal");
+	snoozeLeft = Sym(so, "snoozeLeft");
+	for(k = 0; k < TASKS; k++) {
+		((void (*)(void))Sym(so, tasks[k].init))();
+		ticks[k] = (void (*)(void))Sym(so, tasks[k].tick);
+	}
+
+	*pina = 0xFF;
+	setTime(6, 28, 50, 0);
+	((void (*)(unsigned char, unsigned int, unsigned char, unsigned char, unsigned char, unsigned char))
+		Sym(so, "Alarm_Set"))(0, 6 * 60 + 30, 0, 1, 0, 0);
+	((void (*)(void))Sym(so, "Snooze_Init"))();
+
+	before = errors;
+	Run(20000); // 6:29:10, the light is on
+	Press();
+	Run(1200);
+	Expect("early", LPOn, AOWaitSignal, SOff);
+	if(*snoozeLeft) {
+		Mismatch("early", "minutes left", *snoozeLeft, 0);
+	}
+	Report("early", before);
+
+	before = errors;
+	Run(52000); // 6:30:03, it sounds
+	Expect("ring", LPOn, AOWaitSignal, SOn);
+	Report("ring", before);
+	Snooze("button");
+	Snooze("again");
+
+	before = errors;
+	Press();
+	Run(30000);
+	*alarmOffSignal = 1; // What Link_Service does on LINK_ALARM_OFF
+	Run(2000);
+	if(*alarmOnFlag || *snoozeLeft) {
+		Mismatch("up", "alarm and snooze on", *alarmOnFlag + *snoozeLeft, 0);
+	}
+	Run(MINUTES * 60000UL);
+	Expect("up", LPOff, AOCheck, SOff);
+	Report("up", before);
+	return errors != 0;
+}
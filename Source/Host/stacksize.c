@@ -0,0 +1,345 @@
+/* Task stack sizes from the compiler's call graph
+   Reads the .ci files GCC writes with -fcallgraph-info=su (one per source
+   file; each function's frame from -fstack-usage plus the calls it makes)
+   and works out the deepest chain of frames below each task's entry
+   function. Every task gets that, the return addresses on the way down,
+   the context the kernel saves when the task is switched out, the deepest
+   interrupt handler (handlers run on whichever stack they interrupt) and
+   a margin, and the result is printed as the -D to build the task with.
+
+   A bound is only as good as the graph. Calls through a function pointer,
+   recursion, stacks that grow at run time and functions with no figure
+   (libraries built without -fstack-usage) are reported and make the exit
+   status 1. Resolve pointer calls with -c and give library functions a
+   size with -x. See README.md in this directory for the AVR invocation. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NAME_LEN 128
+#define INDIRECT "__indirect_call" // GCC's node for a call through a pointer
+
+enum {
+	F_UNKNOWN = 1, // no stack figure for something below
+	F_INDIRECT = 2, // an unresolved call through a pointer
+	F_RECURSION = 4,
+	F_DYNAMIC = 8 // alloca or a variable length array without a bound
+};
+
+struct Func {
+	char name[NAME_LEN];
+	long bytes; // frame, -1 when there is no figure
+	unsigned char dynamic;
+	unsigned char resolved; // -c gave its pointer calls
+	unsigned char state; // 0 not visited, 1 on the current path, 2 done
+	unsigned char flags; // of everything below, see above
+	long depth; // deepest chain from here down
+	int next; // callee on that chain, -1 at the bottom
+};
+
+struct Call {
+	int from, to;
+};
+
+struct Task {
+	const char *macro;
+	const char *entry;
+};
+
+/* -c caller=callee or -x function=bytes */
+struct Pair {
+	char kind;
+	char *name, *value;
+};
+
+static struct Func *funcs;
+static int funcCount, funcMax;
+static struct Call *calls;
+static int callCount, callMax;
+static long retBytes; // -r
+
+static int Find(const char *name) {
+	int f;
+	for(f = 0; f < funcCount; f++) {
+		if(strcmp(funcs[f].name, name) == 0) {
+			return f;
+		}
+	}
+	if(funcCount == funcMax) {
+		funcMax = funcMax ? funcMax * 2 : 256;
+		funcs = realloc(funcs, funcMax * sizeof(*funcs));
+		if(!funcs) {
+			perror("stacksize");
+			exit(2);
+		}
+	}
+	memset(&funcs[funcCount], 0, sizeof(*funcs));
+	snprintf(funcs[funcCount].name, NAME_LEN, "%s", name);
+	funcs[funcCount].bytes = -1;
+	funcs[funcCount].next = -1;
+	return funcCount++;
+}
+
+static void AddCall(int from, int to) {
+	if(callCount == callMax) {
+		callMax = callMax ? callMax * 2 : 1024;
+		calls = realloc(calls, callMax * sizeof(*calls));
+		if(!calls) {
+			perror("stacksize");
+			exit(2);
+		}
+	}
+	calls[callCount].from = from;
+	calls[callCount].to = to;
+	callCount++;
+}
+
+// Copies the quoted value after key in line into out; 0 if it is not there
+static int Field(const char *line, const char *key, char *out, size_t len) {
+	const char *p = strstr(line, key);
+	size_t n = 0;
+	if(!p) {
+		return 0;
+	}
+	p += strlen(key);
+	while(*p == ' ') {
+		p++;
+	}
+	if(*p++ != '"') {
+		return 0;
+	}
+	while(*p && *p != '"' && n + 1 < len) {
+		if(*p == '\\' && p[1]) { // Keep escapes as they are, \n included
+			out[n++] = *p++;
+		}
+		out[n++] = *p++;
+	}
+	out[n] = '\0';
+	return 1;
+}
+
+static void Load(const char *path) {
+	FILE *in = fopen(path, "r");
+	char line[1024], title[NAME_LEN], label[512], target[NAME_LEN];
+	const char *figure;
+	int f;
+	if(!in) {
+		perror(path);
+		exit(2);
+	}
+	while(fgets(line, sizeof(line), in)) {
+		if(strncmp(line, "node:", 5) == 0 && Field(line, "title:", title, sizeof(title))) {
+			f = Find(title);
+			// The label is "name\nfile:line:col\nN bytes (static)"
+			if(Field(line, "label:", label, sizeof(label)) && (figure = strrchr(label, '\\')) &&
+				strstr(figure, " bytes (")) {
+				long bytes = atol(figure + 2);
+				if(bytes > funcs[f].bytes) { // Same static name in two files: keep the larger
+					funcs[f].bytes = bytes;
+				}
+				if(strstr(figure, "(dynamic)")) {
+					funcs[f].dynamic = 1;
+				}
+			}
+		}
+		else if(strncmp(line, "edge:", 5) == 0 && Field(line, "sourcename:", title, sizeof(title)) &&
+			Field(line, "targetname:", target, sizeof(target))) {
+			f = Find(title);
+			AddCall(f, Find(target));
+		}
+	}
+	fclose(in);
+}
+
+// Deepest chain of frames from f down, return addresses included
+static long Depth(int f) {
+	struct Func *fn = &funcs[f];
+	long best = 0, d;
+	int c, to;
+
+	if(fn->state == 2) {
+		return fn->depth;
+	}
+	fn->state = 1;
+	fn->flags = fn->dynamic ? F_DYNAMIC : 0;
+	if(strcmp(fn->name, INDIRECT) == 0) {
+		fn->flags |= F_INDIRECT;
+	}
+	else if(fn->bytes < 0) {
+		fn->flags |= F_UNKNOWN;
+	}
+	for(c = 0; c < callCount; c++) {
+		if(calls[c].from != f) {
+			continue;
+		}
+		to = calls[c].to;
+		if(fn->resolved && strcmp(funcs[to].name, INDIRECT) == 0) {
+			continue;
+		}
+		if(funcs[to].state == 1) {
+			funcs[f].flags |= F_RECURSION;
+			continue;
+		}
+		d = Depth(to);
+		fn = &funcs[f];
+		fn->flags |= funcs[to].flags;
+		if(d > best) {
+			best = d;
+			fn->next = to;
+		}
+	}
+	fn->depth = (fn->bytes > 0 ? fn->bytes : 0) + retBytes + best;
+	fn->state = 2;
+	return fn->depth;
+}
+
+static void Notes(unsigned char flags) {
+	if(flags & F_INDIRECT) {
+		printf(" pointer-call");
+	}
+	if(flags & F_RECURSION) {
+		printf(" recursion");
+	}
+	if(flags & F_DYNAMIC) {
+		printf(" dynamic");
+	}
+	if(flags & F_UNKNOWN) {
+		printf(" unknown");
+	}
+}
+
+static void Chain(int f) {
+	printf("   ");
+	for(; f >= 0; f = funcs[f].next) {
+		printf(" %s %ld", funcs[f].name, funcs[f].bytes > 0 ? funcs[f].bytes : 0);
+		if(funcs[f].next >= 0) {
+			printf(" >");
+		}
+	}
+	printf("\n");
+}
+
+static void Usage(const char *name) {
+	fprintf(stderr, "usage: %s [-r bytes] [-f bytes] [-m bytes] [-i isr]... [-c caller=callee]...\n"
+		"       [-x function=bytes]... -t MACRO=entry... file.ci...\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	struct Task tasks[32];
+	struct Pair pairs[64];
+	const char *isrs[16];
+	int taskCount = 0, isrCount = 0, pairCount = 0, isrWorst = -1;
+	long frame = 0, margin = 16, isrDepth = 0, need;
+	unsigned char flags = 0;
+	int opt, n, f, to;
+	char *eq;
+
+	while((opt = getopt(argc, argv, "r:f:m:i:c:x:t:")) != -1) {
+		switch(opt) {
+			case 'r':
+				retBytes = atol(optarg);
+			break;
+			case 'f':
+				frame = atol(optarg);
+			break;
+			case 'm':
+				margin = atol(optarg);
+			break;
+			case 'i':
+				if(isrCount == 16) {
+					Usage(argv[0]);
+				}
+				isrs[isrCount++] = optarg;
+			break;
+			case 'c':
+			case 'x':
+				if(pairCount == 64 || !(eq = strchr(optarg, '='))) {
+					Usage(argv[0]);
+				}
+				*eq = '\0';
+				pairs[pairCount].kind = opt;
+				pairs[pairCount].name = optarg;
+				pairs[pairCount].value = eq + 1;
+				pairCount++;
+			break;
+			case 't':
+				if(taskCount == 32 || !(eq = strchr(optarg, '='))) {
+					Usage(argv[0]);
+				}
+				*eq = '\0';
+				tasks[taskCount].macro = optarg;
+				tasks[taskCount].entry = eq + 1;
+				taskCount++;
+			break;
+			default:
+				Usage(argv[0]);
+		}
+	}
+	if(optind >= argc || !taskCount) {
+		Usage(argv[0]);
+	}
+	for(n = optind; n < argc; n++) {
+		Load(argv[n]);
+	}
+	for(n = 0; n < pairCount; n++) {
+		f = Find(pairs[n].name);
+		if(pairs[n].kind == 'x') {
+			funcs[f].bytes = atol(pairs[n].value);
+		}
+		else {
+			to = Find(pairs[n].value);
+			AddCall(f, to);
+			funcs[f].resolved = 1;
+		}
+	}
+
+	// Interrupts do not nest on the AVR, so only the deepest handler counts
+	for(n = 0; n < isrCount; n++) {
+		f = Find(isrs[n]);
+		if(Depth(f) > isrDepth) {
+			isrDepth = funcs[f].depth;
+			isrWorst = f;
+		}
+		flags |= funcs[f].flags;
+	}
+	if(isrWorst >= 0) {
+		printf("interrupts: %ld bytes in %s", isrDepth, funcs[isrWorst].name);
+		Notes(flags);
+		printf("\n");
+		Chain(isrWorst);
+	}
+
+	printf("%-14s %-18s %6s %6s %6s %6s %7s  %s\n", "task", "entry", "chain", "isr", "frame", "margin", "stack", "notes");
+	for(n = 0; n < taskCount; n++) {
+		f = Find(tasks[n].entry);
+		Depth(f);
+		if(funcs[f].bytes < 0 && funcs[f].next < 0) {
+			printf("%-14s %-18s not in the call graph\n", tasks[n].macro, tasks[n].entry);
+			flags |= F_UNKNOWN;
+			continue;
+		}
+		need = funcs[f].depth + isrDepth + frame + margin;
+		printf("%-14s %-18s %6ld %6ld %6ld %6ld %7ld ", tasks[n].macro, tasks[n].entry,
+			funcs[f].depth, isrDepth, frame, margin, need);
+		Notes(funcs[f].flags);
+		printf("\n");
+		Chain(f);
+		flags |= funcs[f].flags;
+	}
+
+	for(f = 0; f < funcCount; f++) { // Everything reached that has no figure
+		if(funcs[f].state == 2 && funcs[f].bytes < 0 && strcmp(funcs[f].name, INDIRECT) != 0) {
+			printf("no figure: %s\n", funcs[f].name);
+		}
+	}
+	for(n = 0; n < taskCount; n++) {
+		f = Find(tasks[n].entry);
+		if(funcs[f].state == 2) {
+			printf("%s-D%s=%ld", n ? " " : "", tasks[n].macro, funcs[f].depth + isrDepth + frame + margin);
+		}
+	}
+	printf("\n");
+	return flags ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+/* Temperature service check
+   Loads a host build of the clock (Alarm1.c built with HOST_SIM, as for
+   coresim) and runs temperature.h against the DS3231 stand-in in
+   sim_node.c, which counts its temperature reads.
+
+     format   every reading the DS3231 can give, -40 to 85 C in quarters,
+              is written in 6 characters and reads back the same
+     refresh  Temp_Poll called once a second, as DT_Display calls it, for
+              an hour: the first call reads, then one read every
+              TEMP_REFRESH and no more, and a new temperature shows within
+              TEMP_REFRESH; with TEMP_CONVERT every read has its forced
+              conversion
+
+   Prints a line per check and the first mismatches; exits 1 on any.
+   Build with  gcc -O2 -o tempcheck Host/tempcheck.c -ldl
+   and run     tempcheck clock.so */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#define REFRESH 64000UL // TEMP_REFRESH, ms
+#define TEXT 7 // TEMP_TEXT
+#define HOUR_MS 3600000UL
+#define SHOW_ERRORS 5
+
+static void (*setTicks)(unsigned long);
+static void (*setTemp)(int16_t);
+static void (*reads)(unsigned long *, unsigned long *);
+static void (*tempPoll)(void);
+static int16_t (*tempGet)(void);
+static void (*tempFormat)(int16_t, char *);
+static unsigned long errors;
+
+static void *Sym(void *so, const char *name) {
+	void *p = dlsym(so, name);
+	if(!p) {
+		fprintf(stderr, "tempcheck: missing symbol %s\n", name);
+		exit(2);
+	}
+	return p;
+}
+
+static void Mismatch(const char *check, long at, const char *what, long got, long want) {
+	if(errors++ < SHOW_ERRORS) {
+		fprintf(stderr, "tempcheck: %s, at %ld: %s: got %ld, want %ld\n", check, at, what, got, want);
+	}
+}
+
+static void Report(const char *check, unsigned long cases, unsigned long before) {
+	printf("%-7s %7lu cases  %s\n", check, cases, errors == before ? "ok" : "FAILED");
+}
+
+static void Format(void) {
+	unsigned long before = errors;
+	char text[TEXT + 8];
+	double c;
+	int q;
+	for(q = -40 * 4; q <= 85 * 4; q++) {
+		memset(text, '#', sizeof(text));
+		tempFormat(q, text);
+		if(strlen(text) != TEXT - 1) {
+			Mismatch("format", q, "length", strlen(text), TEXT - 1);
+		}
+		if(sscanf(text, "%lf", &c) != 1 || (long)(c * 4 + (c < 0 ? -0.5 : 0.5)) != q) {
+			Mismatch("format", q, "read back, quarters", (long)(c * 4), q);
+		}
+	}
+	Report("format", 85 * 4 + 40 * 4 + 1, before);
+}
+
+static void Refresh(void) {
+	unsigned long before = errors, t, n, converts, setAt = 0;
+	int16_t temp = 21 * 4 + 3;
+	setTemp(temp);
+	for(t = 0; t < HOUR_MS; t += 1000) {
+		if(t % 600000 == 300000) { // A new temperature every ten minutes
+			temp = (int16_t)((t / 600000) * 57 - 100);
+			setTemp(temp);
+			setAt = t;
+		}
+		setTicks(t);
+		tempPoll();
+		if(tempGet() != temp && t >= setAt + REFRESH + 1000) {
+			Mismatch("refresh", t, "shown", tempGet(), temp);
+		}
+	}
+	reads(&n, &converts);
+	if(n != (HOUR_MS - 1) / REFRESH + 1) {
+		Mismatch("refresh", t, "reads", n, (HOUR_MS - 1) / REFRESH + 1);
+	}
+	if(converts && converts != n && converts != n + 1) {
+		Mismatch("refresh", t, "conversions", converts, n);
+	}
+	Report("refresh", HOUR_MS / 1000, before);
+	printf("        %lu reads and %lu forced conversions in an hour\n", n, converts);
+}
+
+int main(int argc, char **argv) {
+	void *so;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s clock.so\n", argv[0]);
+		return 2;
+	}
+	if(!(so = dlopen(argv[1], RTLD_LAZY | RTLD_LOCAL))) {
+		fprintf(stderr, "tempcheck: %s\n", dlerror());
+		return 2;
+	}
+	setTicks = (void (*)(unsigned long))Sym(so, "sim_set_ticks");
+	setTemp = (void (*)(int16_t))Sym(so, "sim_set_temp");
+	reads = (void (*)(unsigned long *, unsigned long *))Sym(so, "sim_rtc_temp_reads");
+	tempPoll = (void (*)(void))Sym(so, "Temp_Poll");
+	tempGet = (int16_t (*)(void))Sym(so, "Temp_Get");
+	tempFormat = (void (*)(int16_t, char *))Sym(so, "Temp_Format");
+
+	Format();
+	Refresh();
+	return errors != 0;
+}
@@ -0,0 +1,200 @@
+/* Trace recorder dump to Chrome trace JSON
+   Reads what the clock sends on USART1 after a 't' (trace.h): a header,
+   the names of the tasks and queues, then the ring of records oldest
+   first. Anything before the "TRC1" magic is skipped, so a capture can
+   start with other console output. The JSON goes to stdout; open it in
+   chrome://tracing or ui.perfetto.dev.
+
+   Every task is a thread of its own, busy from the record that switched it
+   in until the next switch. Queue operations and delays are instant events
+   on the task that was running, and interrupt handlers are slices on an
+   "interrupts" thread.
+   See README.md in this directory for how to capture a dump. */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NAME_LEN 8 // TRACE_NAME
+#define MAX_OBJECTS 255
+#define ISR_TID 0 // thread for interrupt handlers; tasks use their number
+
+/* enum TraceType in tracehooks.h */
+enum {TR_SWITCH, TR_TICK, TR_DELAY, TR_SEND, TR_SEND_FAILED, TR_RECEIVE,
+	TR_RECEIVE_FAILED, TR_BLOCK_SEND, TR_BLOCK_RECEIVE, TR_ISR_ENTER, TR_ISR_EXIT};
+
+static const char *queueOps[] = {
+	[TR_SEND] = "send", [TR_SEND_FAILED] = "send failed",
+	[TR_RECEIVE] = "receive", [TR_RECEIVE_FAILED] = "receive failed",
+	[TR_BLOCK_SEND] = "block on send", [TR_BLOCK_RECEIVE] = "block on receive",
+};
+
+/* TRACE_ISR_* in tracehooks.h */
+static const char *isrNames[] = {"?", "USART0_RX", "PCINT0", "TIMER2_COMPA", "EE_READY"};
+
+static char names[MAX_OBJECTS + 1][NAME_LEN + 1];
+static unsigned char isTask[MAX_OBJECTS + 1];
+static int first = 1; // no event written yet
+
+static unsigned Get16(const unsigned char *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static void ReadAll(FILE *in, unsigned char *buf, size_t len) {
+	if(fread(buf, 1, len, in) != len) {
+		fprintf(stderr, "tracedump: capture ends inside the dump\n");
+		exit(1);
+	}
+}
+
+// Name of object n, quoted for JSON
+static void Name(unsigned n, char *out, size_t len) {
+	size_t o = 0;
+	const char *s = names[n];
+	if(!*s) {
+		snprintf(out, len, "%s %u", isTask[n] ? "task" : "queue", n);
+		return;
+	}
+	for(; *s && o + 3 < len; s++) {
+		if(*s == '"' || *s == '\\') {
+			out[o++] = '\\';
+		}
+		out[o++] = (*s >= ' ' && *s < 0x7f) ? *s : '?';
+	}
+	out[o] = '\0';
+}
+
+static void Event(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void Event(const char *fmt, ...) {
+	va_list ap;
+	printf("%s\n", first ? "" : ",");
+	first = 0;
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+}
+
+int main(int argc, char **argv) {
+	FILE *in = stdin;
+	unsigned char header[12], *records;
+	unsigned objects, recordSize, count, lost, tickCounts, countUs;
+	unsigned long long tick = 0, lastTick = 0, base = 0, now = 0, start = 0;
+	unsigned running = 0, isrDepth = 0, n;
+	char name[3 * NAME_LEN + 16];
+	int c, matched = 0;
+
+	if(argc > 2) {
+		fprintf(stderr, "usage: %s [capture] > trace.json\n", argv[0]);
+		return 1;
+	}
+	if(argc == 2 && !(in = fopen(argv[1], "rb"))) {
+		perror(argv[1]);
+		return 1;
+	}
+	while(matched < 4 && (c = fgetc(in)) != EOF) { // Find "TRC1"
+		matched = (c == "TRC1"[matched]) ? matched + 1 : (c == 'T');
+	}
+	if(matched < 4) {
+		fprintf(stderr, "tracedump: no dump in the capture\n");
+		return 1;
+	}
+	ReadAll(in, header + 4, sizeof(header) - 4);
+	tickCounts = header[4];
+	countUs = header[5];
+	objects = header[6];
+	recordSize = header[7];
+	count = Get16(header + 8);
+	lost = Get16(header + 10);
+	if(recordSize < 6 || !tickCounts || !countUs) {
+		fprintf(stderr, "tracedump: bad header\n");
+		return 1;
+	}
+	for(n = 1; n <= objects; n++) {
+		ReadAll(in, (unsigned char *)names[n], NAME_LEN);
+	}
+	records = malloc((size_t)count * recordSize + 1);
+	if(!records) {
+		perror("tracedump");
+		return 1;
+	}
+	ReadAll(in, records, (size_t)count * recordSize);
+	if(lost) {
+		fprintf(stderr, "tracedump: %u older records were overwritten\n", lost);
+	}
+
+	for(n = 0; n < count; n++) { // Tasks are what TR_SWITCH names
+		if(records[n * recordSize] == TR_SWITCH) {
+			isTask[records[n * recordSize + 1]] = 1;
+		}
+	}
+
+	printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	Event("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"interrupts\"}}", ISR_TID);
+	for(n = 1; n <= objects; n++) {
+		if(isTask[n]) {
+			Name(n, name, sizeof(name));
+			Event("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", n, name);
+		}
+	}
+
+	for(n = 0; n < count; n++) {
+		const unsigned char *r = records + (size_t)n * recordSize;
+		unsigned type = r[0], arg = r[1];
+		unsigned t16 = Get16(r + 2);
+
+		// The tick count is 16 bits; records are never 32 s apart
+		tick = n ? lastTick + (unsigned short)(t16 - (lastTick & 0xffff)) : t16;
+		lastTick = tick;
+		now = (tick * tickCounts + Get16(r + 4)) * countUs;
+		if(n == 0) {
+			base = now;
+		}
+		now -= base;
+
+		switch(type) {
+			case TR_SWITCH:
+				if(running) {
+					Event("{\"name\":\"run\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu}",
+						running, start, now - start);
+				}
+				running = arg;
+				start = now;
+			break;
+			case TR_TICK:
+				Event("{\"name\":\"tick\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%llu}", ISR_TID, now);
+			break;
+			case TR_DELAY:
+				Event("{\"name\":\"delay\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%llu}", running, now);
+			break;
+			case TR_SEND:
+			case TR_SEND_FAILED:
+			case TR_RECEIVE:
+			case TR_RECEIVE_FAILED:
+			case TR_BLOCK_SEND:
+			case TR_BLOCK_RECEIVE:
+				Name(arg, name, sizeof(name));
+				Event("{\"name\":\"%s %s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"args\":{\"queue\":\"%s\"}}",
+					queueOps[type], name, running, now, name);
+			break;
+			case TR_ISR_ENTER:
+				isrDepth++;
+				Event("{\"name\":\"%s\",\"ph\":\"B\",\"pid\":1,\"tid\":%d,\"ts\":%llu}",
+					arg < sizeof(isrNames) / sizeof(isrNames[0]) ? isrNames[arg] : "?", ISR_TID, now);
+			break;
+			case TR_ISR_EXIT:
+				if(isrDepth) { // The enter may have been overwritten
+					isrDepth--;
+					Event("{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%llu}", ISR_TID, now);
+				}
+			break;
+			default:
+				fprintf(stderr, "tracedump: unknown record type %u\n", type);
+			break;
+		}
+	}
+	if(running) { // Runs to the end of the dump
+		Event("{\"name\":\"run\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu}",
+			running, start, now - start);
+	}
+	printf("\n]}\n");
+	return 0;
+}
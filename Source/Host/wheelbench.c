@@ -0,0 +1,222 @@
+/* Timer wheel benchmark
+   Runs 64 software timers through the two ways the kernel can keep them:
+   the pair of lists sorted by expiry time that V7.1.1 uses (vListInsert,
+   swapped when the tick count overflows) and the timer wheel
+   (configUSE_TIMER_WHEEL, listwheel.h). Both are the real list.c, built
+   here with the host stand-in of list.h.
+
+   The timers are what the clock would have with a timer per alarm, per
+   sensor node and per UI timeout:
+     16 alarm checks    every minute
+      8 node timeouts   5 s, restarted by traffic every 0.3 to 0.8 s
+     10 UI timeouts     10 s, restarted by a button now and then
+     30 short timers    10 to 500 ticks (blinks, debounce, beeps)
+   all auto reload, over an hour of 1 ms ticks, so the 16 bit tick count
+   overflows 54 times. Every timer must fire on the tick it is due, and
+   the same number of times with both.
+
+   Prints how long the list vListInsert() searched was on average for the
+   sorted lists (the wheel's insert does not depend on it) and host ns per
+   tick for each. The host times only compare the two; the AVR figure has
+   to come from the run time stats (runstats.h).
+   Build with  gcc -O2 -IHost/include -o wheelbench Host/wheelbench.c */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define configUSE_TIMER_WHEEL 1
+#define configUSE_16_BIT_TICKS 1
+#define configASSERT(x) assert(x)
+#include "../list.c"
+
+#define TIMERS 64
+#define TICKS (60UL * 60UL * 1000UL)
+
+struct Timer {
+	xListItem item;
+	portTickType period;
+	unsigned long fired[2];
+};
+
+static struct Timer timers[TIMERS];
+static unsigned long restarts, inserts, searched;
+
+/* Sorted lists, as timers.c */
+static xList list1, list2, *current, *overflow;
+
+static void SortedInit(portTickType now) {
+	(void)now;
+	vListInitialise(&list1);
+	vListInitialise(&list2);
+	current = &list1;
+	overflow = &list2;
+}
+
+static void SortedInsert(struct Timer *t, portTickType now) {
+	xList *to = (listGET_LIST_ITEM_VALUE(&t->item) < now) ? overflow : current;
+	inserts++;
+	searched += listCURRENT_LIST_LENGTH(to);
+	vListInsert(to, &t->item);
+}
+
+static void Fire(struct Timer *t, portTickType now, int backend);
+
+static void SortedTick(portTickType now) {
+	if(now == 0) {
+		xList *swap = current;
+		assert(listLIST_IS_EMPTY(current));
+		current = overflow;
+		overflow = swap;
+	}
+	while(!listLIST_IS_EMPTY(current) && listGET_ITEM_VALUE_OF_HEAD_ENTRY(current) <= now) {
+		struct Timer *t = listGET_OWNER_OF_HEAD_ENTRY(current);
+		vListRemove(&t->item);
+		Fire(t, now, 0);
+	}
+}
+
+/* Timer wheel */
+static xListWheel wheel;
+
+static void WheelInit(portTickType now) {
+	vListWheelInitialise(&wheel, now);
+}
+
+static void WheelInsert(struct Timer *t, portTickType now) {
+	(void)now;
+	(void)xListWheelInsert(&wheel, &t->item);
+}
+
+static void WheelTick(portTickType now) {
+	xList *due = pxListWheelAdvance(&wheel);
+	assert(wheel.xNow == now);
+	while(!listLIST_IS_EMPTY(due)) {
+		struct Timer *t = listGET_OWNER_OF_HEAD_ENTRY(due);
+		vListRemove(&t->item);
+		Fire(t, now, 1);
+	}
+}
+
+struct Backend {
+	const char *name;
+	void (*init)(portTickType now);
+	void (*insert)(struct Timer *t, portTickType now);
+	void (*tick)(portTickType now);
+};
+
+static const struct Backend backends[2] = {
+	{"sorted lists", SortedInit, SortedInsert, SortedTick},
+	{"timer wheel", WheelInit, WheelInsert, WheelTick},
+};
+
+static void Fire(struct Timer *t, portTickType now, int backend) {
+	if(listGET_LIST_ITEM_VALUE(&t->item) != now) {
+		fprintf(stderr, "wheelbench: %s fired timer %d due %u at %u\n", backends[backend].name,
+			(int)(t - timers), listGET_LIST_ITEM_VALUE(&t->item), now);
+		exit(1);
+	}
+	t->fired[backend]++;
+	listSET_LIST_ITEM_VALUE(&t->item, now + t->period);
+	backends[backend].insert(t, now);
+}
+
+static void Start(const struct Backend *b, struct Timer *t, portTickType now) {
+	if(t->item.pvContainer) {
+		vListRemove(&t->item);
+	}
+	listSET_LIST_ITEM_VALUE(&t->item, now + t->period);
+	b->insert(t, now);
+	restarts++;
+}
+
+static void Setup() {
+	int n = 0, k;
+	for(k = 0; k < 16; k++, n++) {
+		timers[n].period = 60000U;
+	}
+	for(k = 0; k < 8; k++, n++) {
+		timers[n].period = 5000U;
+	}
+	for(k = 0; k < 10; k++, n++) {
+		timers[n].period = 10000U;
+	}
+	for(k = 0; n < TIMERS; k++, n++) {
+		timers[n].period = 10U + (k * 163U) % 491U;
+	}
+}
+
+static double Now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Same restarts for both: node n hears traffic every 300 to 800 ticks, and
+// node 7 goes quiet for a while so its timeout fires; a UI timer is
+// restarted every 3 s or so
+static double Run(const struct Backend *b, unsigned long *restartCount) {
+	portTickType now = 0xff00U; // close to the overflow
+	unsigned long tick;
+	unsigned short next[TIMERS] = {0};
+	double start;
+	int n;
+
+	srand(1);
+	restarts = 0;
+	inserts = 0;
+	searched = 0;
+	for(n = 0; n < TIMERS; n++) {
+		vListInitialiseItem(&timers[n].item);
+		listSET_LIST_ITEM_OWNER(&timers[n].item, &timers[n]);
+	}
+	b->init(now);
+	for(n = 0; n < TIMERS; n++) {
+		Start(b, &timers[n], now);
+		next[n] = 300 + rand() % 500;
+	}
+	start = Now();
+	for(tick = 0; tick < TICKS; tick++) {
+		now++;
+		b->tick(now);
+		for(n = 16; n < 24; n++) { // Nodes
+			if(--next[n] == 0) {
+				next[n] = 300 + rand() % 500;
+				if(n != 23 || (tick / 60000UL) % 2) {
+					Start(b, &timers[n], now);
+				}
+			}
+		}
+		if(rand() % 3000 == 0) { // A button
+			Start(b, &timers[24 + rand() % 10], now);
+		}
+	}
+	*restartCount = restarts;
+	return Now() - start;
+}
+
+int main() {
+	unsigned long count[2];
+	double ns[2];
+	int b, n;
+
+	Setup();
+	for(b = 0; b < 2; b++) {
+		ns[b] = Run(&backends[b], &count[b]);
+		if(b == 0) {
+			printf("%d timers, %lu ticks, %lu restarts, %lu inserts; sorted inserts searched %.1f timers on average\n",
+				TIMERS, TICKS, count[b], inserts, (double)searched / inserts);
+		}
+	}
+	for(n = 0; n < TIMERS; n++) {
+		if(timers[n].fired[0] != timers[n].fired[1]) {
+			fprintf(stderr, "wheelbench: timer %d fired %lu times with the lists, %lu with the wheel\n",
+				n, timers[n].fired[0], timers[n].fired[1]);
+			return 1;
+		}
+	}
+	for(b = 0; b < 2; b++) {
+		printf("%-13s %.1f ns a tick\n", backends[b].name, ns[b] / TICKS);
+	}
+	return 0;
+}
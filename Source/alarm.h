@@ -0,0 +1,307 @@
+// The alarm table and when each alarm rings next, and the hours as shown
+// (clock side). Include after clockstate.h and <string.h>.
+//
+// Times are kept the way the clock counts them, not the way it shows
+// them: clockState holds the hour 0-23 and an alarm is a minute of the day
+// (0-1439). 12 or 24 hour mode only matters when a time is drawn
+// (Clock_ShowHour).
+//
+// alarms[] holds up to ALARM_MAX alarms, each with the days it repeats on
+// (any set of days of the week, such as ALARM_WEEKDAYS or ALARM_WEEKEND, or
+// ALARM_ONCE, which rings once and turns off), how many minutes early the
+// light and the sensors start, its melody and the sleepers it wakes. When an
+// alarm is set its next time, a minute of the week, is worked out once.
+// alarmOrder[] lists the alarms that are on by that minute, as a ring that
+// starts anywhere: the first alarm after a minute is a binary search away,
+// and setting or clearing an alarm moves the entries after it by one.
+//
+// Alarm_Update, run from UpdateTime, publishes the alarm the machines go
+// by in clockState: the next to ring, or a later one whose longer lead
+// starts it first. It also moves alarms the clock went past without
+// ringing (while another rang) on to their next time. From then on every
+// check is a subtraction modulo a week (Alarm_Left), so an alarm after
+// midnight or on another day is no different from any other. An alarm
+// that has started stays published until Alarm_Done.
+// Alarm_Update only works when the minute or the table has changed, so
+// the reads in between cost a compare. Midnight is one more minute: the
+// day of the week comes from the DS3231, and only the alarms the clock
+// went past look for their next day.
+//
+// The table only changes between ClockState_Begin and ClockState_End. The
+// functions here take them themselves, except Alarm_Update and
+// Alarm_Reschedule, which writers call while they hold them.
+
+#ifndef ALARM_H
+#define ALARM_H
+
+#define ALARM_MAX 16
+#define ALARM_NONE 0xFFFF // alarmMinute and alarmNext with no alarm
+#define ALARM_NO_ID 0xFF
+#define ALARM_DAY 1440U // minutes
+#define ALARM_WEEK (7U * ALARM_DAY)
+#define ALARM_EVERY_DAY 0x7F // days, bit 0 is Sunday
+#define ALARM_WEEKDAYS 0x3E // Monday to Friday
+#define ALARM_WEEKEND 0x41 // Saturday and Sunday
+#define ALARM_ONCE 0 // days of an alarm that rings once
+#define ALARM_NEAR 10 // minutes of lead the buttons give an alarm
+#define ALARM_LEAD_MAX 60
+
+struct Alarm {
+	unsigned int minute; // minute of the day
+	unsigned char days; // days it repeats on, or ALARM_ONCE
+	unsigned char lead; // minutes early the light and the sensors start
+	unsigned char melody;
+	unsigned char sleepers; // sensor nodes it wakes, bit 0 is node 1, 0 for all
+	unsigned char on;
+	unsigned int next; // minute of the week it rings next, while on
+};
+
+struct Alarm alarms[ALARM_MAX];
+unsigned char alarmOrder[ALARM_MAX]; // the alarms that are on, by next
+unsigned char alarmCount;
+static unsigned char alarmActive = ALARM_NO_ID; // started, until Alarm_Done
+static unsigned int alarmSeen; // minute of the week Alarm_Update caught up to
+static unsigned char alarmStale = 1; // the table changed since it was published
+
+// Minute of the week at hour:minute on weekday, 0 at midnight on Sunday
+unsigned int Clock_MinuteOfWeek(uint8_t weekday, uint8_t hour, uint8_t minute) {
+
+	return weekday * ALARM_DAY + hour * 60U + minute;
+}
+
+// The hour 0-23 from a 12 hour one and its PM bit
+uint8_t Clock_Hour24(uint8_t hour12, unsigned char pm) {
+
+	return (hour12 % 12) + (pm ? 12 : 0);
+}
+
+// The hour 0-23 as shown in hourMode, 1-12 with *pm set in 12 hour mode
+uint8_t Clock_ShowHour(uint8_t hour, unsigned char hourMode, unsigned char *pm) {
+
+	*pm = hour >= 12;
+	if(hourMode == 1) {
+		return hour;
+	}
+	hour %= 12;
+	return hour ? hour : 12;
+}
+
+// Minutes from minute 'from' of the week on to minute 'to'
+static unsigned int Alarm_Until(unsigned int from, unsigned int to) {
+
+	return (to + ALARM_WEEK - from) % ALARM_WEEK;
+}
+
+// The first minute of the week from 'from' on that alarm a rings at
+static unsigned int Alarm_From(const struct Alarm *a, unsigned int from) {
+
+	unsigned char days = a->days ? a->days : ALARM_EVERY_DAY;
+	unsigned char today = from / ALARM_DAY;
+	unsigned char d, day;
+	unsigned int at;
+	for(d = 0; d <= 7; d++) { // Today, up to the same day next week
+		day = (today + d) % 7;
+		at = day * ALARM_DAY + a->minute;
+		if((days & (1 << day)) && (d || at >= from)) {
+			return at;
+		}
+	}
+	return ALARM_NONE;
+}
+
+// Position in alarmOrder of the first alarm at or after minute 'at' of
+// the week, alarmCount if there is none before the week is out
+static unsigned char Alarm_Find(unsigned int at) {
+
+	unsigned char lo = 0, hi = alarmCount, mid;
+	while(lo < hi) {
+		mid = (lo + hi) / 2;
+		if(alarms[alarmOrder[mid]].next < at) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static void Alarm_Link(unsigned char id) {
+
+	unsigned char n = Alarm_Find(alarms[id].next + 1); // After those at the same minute
+	memmove(&alarmOrder[n + 1], &alarmOrder[n], alarmCount - n);
+	alarmOrder[n] = id;
+	alarmCount++;
+}
+
+static void Alarm_Unlink(unsigned char id) {
+
+	unsigned char n = Alarm_Find(alarms[id].next);
+	while(alarmOrder[n] != id) { // Among those at the same minute
+		n++;
+	}
+	alarmCount--;
+	memmove(&alarmOrder[n], &alarmOrder[n + 1], alarmCount - n);
+}
+
+// Moves alarm id, which is on, to the first time it rings from 'from' on
+static void Alarm_Move(unsigned char id, unsigned int from) {
+
+	Alarm_Unlink(id);
+	alarms[id].next = Alarm_From(&alarms[id], from);
+	Alarm_Link(id);
+}
+
+// Catches the table up with the time in *c and publishes the alarm to go by
+void Alarm_Update(struct ClockState *c) {
+
+	unsigned int now = Clock_MinuteOfWeek(c->weekday, c->hour, c->minute);
+	unsigned int gone = Alarm_Until(alarmSeen, now);
+	unsigned int left;
+	unsigned char passed[ALARM_MAX];
+	unsigned char k = 0, n, i, id, best = ALARM_NO_ID;
+	int start, bestStart = 0;
+
+	if(alarmActive != ALARM_NO_ID || (gone == 0 && !alarmStale)) {
+		return;
+	}
+	alarmStale = 0;
+	/* Alarms at a minute in [alarmSeen, now) went by without ringing. Each
+	   is moved once, as its next time can fall in the same span a week on. */
+	n = Alarm_Find(alarmSeen);
+	for(i = 0; i < alarmCount && gone; i++, n++) {
+		if(n == alarmCount) {
+			n = 0;
+		}
+		if(Alarm_Until(alarmSeen, alarms[alarmOrder[n]].next) >= gone) {
+			break;
+		}
+		passed[k++] = alarmOrder[n];
+	}
+	while(k) {
+		Alarm_Move(passed[--k], now);
+	}
+	alarmSeen = now;
+
+	/* The alarm that starts first, from the next on. A lead is at most
+	   ALARM_LEAD_MAX, so the walk stops that far past the best start. */
+	n = Alarm_Find(now);
+	for(i = 0; i < alarmCount; i++, n++) {
+		if(n == alarmCount) {
+			n = 0;
+		}
+		id = alarmOrder[n];
+		left = Alarm_Until(now, alarms[id].next);
+		if(best != ALARM_NO_ID && (int)left - ALARM_LEAD_MAX >= bestStart) {
+			break;
+		}
+		start = (int)left - alarms[id].lead;
+		if(best == ALARM_NO_ID || start < bestStart) {
+			best = id;
+			bestStart = start;
+		}
+	}
+	c->alarmId = best;
+	if(best == ALARM_NO_ID) {
+		c->alarmMinute = ALARM_NONE;
+		c->alarmNext = ALARM_NONE;
+		c->alarmLead = 0;
+	}
+	else {
+		c->alarmMinute = alarms[best].minute;
+		c->alarmNext = alarms[best].next;
+		c->alarmLead = alarms[best].lead;
+	}
+}
+
+// Moves every alarm to its first time from the time in *c on, after the
+// time was set
+void Alarm_Reschedule(struct ClockState *c) {
+
+	unsigned char id;
+	alarmSeen = Clock_MinuteOfWeek(c->weekday, c->hour, c->minute);
+	alarmCount = 0;
+	alarmStale = 1;
+	for(id = 0; id < ALARM_MAX; id++) {
+		if(alarms[id].on) {
+			alarms[id].next = Alarm_From(&alarms[id], alarmSeen);
+			Alarm_Link(id);
+		}
+	}
+	Alarm_Update(c);
+}
+
+// Sets alarm id, or clears it with minute ALARM_NONE
+void Alarm_Set(unsigned char id, unsigned int minute, unsigned char days, unsigned char lead,
+	unsigned char melody, unsigned char sleepers) {
+
+	struct Alarm *a;
+	struct ClockState *c;
+	if(id >= ALARM_MAX) {
+		return;
+	}
+	a = &alarms[id];
+	c = ClockState_Begin();
+	if(a->on) {
+		Alarm_Unlink(id);
+		a->on = 0;
+	}
+	if(id == alarmActive) { // Changed while it rings: Alarm_Done leaves it be
+		alarmActive = ALARM_NO_ID;
+	}
+	alarmStale = 1;
+	if(minute < ALARM_DAY) {
+		a->minute = minute;
+		a->days = days;
+		a->lead = (lead > ALARM_LEAD_MAX) ? ALARM_LEAD_MAX : lead;
+		a->melody = melody;
+		a->sleepers = sleepers;
+		a->on = 1;
+		a->next = Alarm_From(a, Clock_MinuteOfWeek(c->weekday, c->hour, c->minute));
+		Alarm_Link(id);
+	}
+	Alarm_Update(c);
+	ClockState_End();
+}
+
+// The published alarm has started. Returns its id.
+unsigned char Alarm_Start() {
+
+	struct ClockState *c = ClockState_Begin();
+	alarmActive = c->alarmId;
+	ClockState_End();
+	return alarmActive;
+}
+
+// The started alarm is over: one that rings once turns off, one that
+// repeats moves on to its next time
+void Alarm_Done() {
+
+	struct ClockState *c = ClockState_Begin();
+	unsigned char id = alarmActive;
+	alarmActive = ALARM_NO_ID;
+	alarmStale = 1;
+	if(id != ALARM_NO_ID && alarms[id].on) {
+		if(alarms[id].days == ALARM_ONCE) {
+			Alarm_Unlink(id);
+			alarms[id].on = 0;
+		}
+		else {
+			Alarm_Move(id, (alarms[id].next + 1) % ALARM_WEEK);
+		}
+	}
+	Alarm_Update(c);
+	ClockState_End();
+}
+
+// Minutes from the time in *c until the published alarm rings, ALARM_NONE
+// with none
+unsigned int Alarm_Left(const struct ClockState *c) {
+
+	if(c->alarmNext == ALARM_NONE) {
+		return ALARM_NONE;
+	}
+	return Alarm_Until(Clock_MinuteOfWeek(c->weekday, c->hour, c->minute), c->alarmNext);
+}
+
+#endif // ALARM_H
@@ -0,0 +1,243 @@
+// Sensor nodes on the link (clock side). Include after link.h and linkmon.h.
+//
+// Every node has an entry in busNodes[] holding its presence, alarm state
+// and FSR telemetry stats, so serving another sleeper costs a table entry
+// rather than a task. Bus_Route files a received frame under the node it
+// came from. With LINK_BUS set Bus_Tick also owns the bus: it polls the
+// online nodes in turn, one slot each, and probes one offline node per
+// round so a sensor plugged in later is picked up.
+
+#ifndef BUS_H
+#define BUS_H
+
+#define BUS_SLOT_TIMEOUT 60 // ms a polled node has to start its answer
+#define BUS_MAX_MISSED 3 // unanswered polls before a node counts as gone
+
+enum BusAlarm {BANone, BARinging, BAUp};
+
+struct BusNode {
+	unsigned char online;
+	unsigned char seen; // answered at least once since power-up
+	unsigned char missed; // polls in a row without an answer
+	unsigned char alarm; // enum BusAlarm
+	unsigned int polls;
+	unsigned int answers;
+	uint16_t fsrLast, fsrMin, fsrMax;
+	unsigned int fsrFrames;
+	unsigned int fsrMissed; // frames lost, from gaps in the sequence number
+	unsigned char fsrSeq;
+};
+
+enum BusState {BSInit, BSPoll, BSWaitAnswer} bus_state;
+
+struct BusNode busNodes[LINK_MAX_NODES];
+
+static unsigned char busPolled; // node being polled
+static unsigned char busAnswered;
+#if LINK_BUS
+static unsigned char busNext; // last node polled this round, 0 at the start
+static unsigned char busProbe; // last offline node probed
+static portTickType busPolledAt;
+#endif
+static unsigned char busRinging; // nodes rung for, between Bus_Ring and Bus_Quiet
+static unsigned char busSnoozed; // between Bus_Snooze and Bus_Resume
+
+// Table entry for a node address, or 0 for the clock or a bad address
+struct BusNode *Bus_Node(unsigned char addr) {
+
+	if(addr == LINK_BROADCAST || addr > LINK_MAX_NODES) {
+		return 0;
+	}
+	return &busNodes[addr - 1];
+}
+
+void Bus_Init() {
+
+	unsigned char n;
+	bus_state = BSInit;
+	for(n = 0; n < LINK_MAX_NODES; n++) {
+		busNodes[n].fsrMin = 0xFFFF;
+	}
+}
+
+// Starts the alarm for every node in sleepers (bit 0 is node 1, 0 for all)
+// that is there to hear it. Nodes that are not online are left alone so a
+// dead sensor cannot hold the alarm on; one that comes back while the
+// alarm sounds joins in then.
+void Bus_Ring(unsigned char sleepers) {
+
+	unsigned char n;
+	busRinging = sleepers ? sleepers : 0xFF;
+	for(n = 0; n < LINK_MAX_NODES; n++) {
+		busNodes[n].alarm = (busNodes[n].online && (busRinging & (1 << n))) ? BARinging : BANone;
+	}
+#if !LINK_BUS
+	if(!sleepers) {
+		Link_Send(LINK_ALARM_ON, 0, 0); // On the bus the alarm rides on the polls
+	}
+	for(n = 0; sleepers && n < LINK_MAX_NODES; n++) {
+		if(sleepers & (1 << n)) {
+			Link_SendTo(n + 1, LINK_ALARM_ON, 0, 0);
+		}
+	}
+#endif
+}
+
+// 1 while any sleeper the alarm was rung for is still in bed
+unsigned char Bus_Ringing() {
+
+	unsigned char n;
+	for(n = 0; n < LINK_MAX_NODES; n++) {
+		if(busNodes[n].alarm == BARinging) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Stops sounding the alarm at the nodes for a snooze. The sleepers stay
+// in bed as far as Bus_Ringing goes, and one that gets up ends the alarm.
+void Bus_Snooze() {
+
+	busSnoozed = 1;
+}
+
+// Sounds the alarm again at the nodes whose sleeper is still in bed. On
+// the bus their next poll carries it.
+void Bus_Resume() {
+
+#if !LINK_BUS
+	unsigned char n;
+	for(n = 0; n < LINK_MAX_NODES; n++) {
+		if(busNodes[n].online && busNodes[n].alarm == BARinging) {
+			Link_SendTo(n + 1, LINK_ALARM_ON, 0, 0);
+		}
+	}
+#endif
+	busSnoozed = 0;
+}
+
+void Bus_Quiet() {
+
+	unsigned char n;
+	busRinging = 0;
+	busSnoozed = 0;
+	for(n = 0; n < LINK_MAX_NODES; n++) {
+		busNodes[n].alarm = BANone;
+	}
+}
+
+// Marks the node a frame came from as present. Returns its entry, or 0.
+struct BusNode *Bus_Route(const struct LinkFrame *frame) {
+
+	struct BusNode *node = Bus_Node(frame->addr);
+	if(!node) {
+		return 0;
+	}
+	if(!node->online && (busRinging & (1 << (frame->addr - 1))) && node->alarm == BANone) {
+		node->alarm = BARinging;
+	}
+	node->online = 1;
+	node->seen = 1;
+	node->missed = 0;
+	if(frame->addr == busPolled) {
+		node->answers++;
+		busAnswered = 1;
+	}
+	return node;
+}
+
+#if LINK_BUS
+// Picks the next node to poll: every online node once per round, then one
+// offline node
+static unsigned char Bus_NextNode() {
+
+	unsigned char n;
+	while(busNext < LINK_MAX_NODES) {
+		if(busNodes[busNext++].online) {
+			return busNext;
+		}
+	}
+	busNext = 0;
+	for(n = 0; n < LINK_MAX_NODES; n++) {
+		busProbe = (busProbe % LINK_MAX_NODES) + 1;
+		if(!busNodes[busProbe - 1].online) {
+			return busProbe;
+		}
+	}
+	busNext = 1; // Everyone is online, start the next round
+	return 1;
+}
+#endif
+
+void Bus_Tick() {
+
+#if LINK_BUS
+	portTickType now = xTaskGetTickCount();
+	struct BusNode *node;
+	unsigned char n;
+	unsigned char flags;
+
+	// Transitions
+	switch(bus_state) {
+
+		case BSInit:
+			bus_state = BSPoll;
+		break;
+
+		case BSPoll:
+			bus_state = BSWaitAnswer;
+		break;
+
+		case BSWaitAnswer:
+			if(busAnswered) {
+				bus_state = BSPoll;
+			}
+			else if((portTickType)(now - busPolledAt) >= BUS_SLOT_TIMEOUT) {
+				node = Bus_Node(busPolled);
+				if(++node->missed >= BUS_MAX_MISSED) {
+					node->online = 0;
+				}
+				bus_state = BSPoll;
+			}
+			else {
+				bus_state = BSWaitAnswer;
+			}
+		break;
+
+		default:
+			bus_state = BSInit;
+		break;
+	}
+
+	// Actions
+	switch(bus_state) {
+
+		case BSInit:
+		case BSWaitAnswer:
+		break;
+
+		case BSPoll:
+			busPolled = Bus_NextNode();
+			node = Bus_Node(busPolled);
+			flags = (node->alarm == BARinging && !busSnoozed) ? LINK_POLL_ALARM : 0;
+			busAnswered = 0;
+			busPolledAt = now;
+			node->polls++;
+			Link_SendTo(busPolled, LINK_POLL, &flags, 1);
+		break;
+
+		default:
+		break;
+	}
+
+	linkDegraded = 0; // A sensor that has been heard from has gone quiet
+	for(n = 0; n < LINK_MAX_NODES; n++) {
+		if(busNodes[n].seen && !busNodes[n].online) {
+			linkDegraded = 1;
+		}
+	}
+#endif
+}
+
+#endif // BUS_H
@@ -0,0 +1,64 @@
+// The time and the set alarm, shared by every state machine (clock side).
+// Include after the FreeRTOS headers.
+//
+// One struct ClockState, published with a sequence lock. A writer calls
+// ClockState_Begin, changes the fields through the pointer it gets back and
+// calls ClockState_End; clockSeq is odd in between. Writers hold the
+// scheduler suspended, so two of them never interleave and interrupts stay
+// on. A reader copies the struct with ClockState_Read and copies again if
+// clockSeq moved meanwhile, so it never waits on a writer and never sees
+// the time from one update next to the alarm from another. Readers take
+// one snapshot per pass and work from that.
+
+#ifndef CLOCKSTATE_H
+#define CLOCKSTATE_H
+
+// Keeps the compiler from moving struct accesses across clockSeq
+#define CLOCKSTATE_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+struct ClockState {
+	uint8_t hour, minute, second; // 24 hour, whatever the display shows
+	uint8_t weekday; // 0 is Sunday
+	unsigned char hourMode; // how hours are shown: 0 is 12 hour | 1 is 24 hour
+	unsigned char alarmId; // entry in alarms[] of the alarm to go by (alarm.h)
+	unsigned char alarmLead; // minutes before it rings that it starts
+	unsigned int alarmMinute; // minute of the day it rings, ALARM_NONE with none
+	unsigned int alarmNext; // minute of the week it rings
+};
+
+struct ClockState clockState = {0, 0, 0, 0, 0, 0xFF, 0, 0xFFFF, 0xFFFF};
+volatile unsigned char clockSeq;
+
+void ClockState_Read(struct ClockState *snapshot) {
+
+	unsigned char seq;
+	do {
+		seq = clockSeq;
+		CLOCKSTATE_BARRIER();
+		*snapshot = clockState;
+		CLOCKSTATE_BARRIER();
+	} while((seq & 1) || seq != clockSeq);
+}
+
+// One byte is read in one go, so needs no retry
+unsigned char ClockState_HourMode() {
+
+	return clockState.hourMode;
+}
+
+struct ClockState *ClockState_Begin() {
+
+	vTaskSuspendAll();
+	clockSeq++;
+	CLOCKSTATE_BARRIER();
+	return &clockState;
+}
+
+void ClockState_End() {
+
+	CLOCKSTATE_BARRIER();
+	clockSeq++;
+	xTaskResumeAll();
+}
+
+#endif // CLOCKSTATE_H
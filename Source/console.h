@@ -0,0 +1,59 @@
+// USART1 debug console (clock side). Include after runstats.h, trace.h and
+// temperature.h.
+//
+// A command byte on USART1 asks for a report: 's' the run time stats
+// (runstats.h), 't' the trace recorder's ring (trace.h), 'c' the last
+// temperature read (temperature.h). The report goes out a piece per
+// Console_Tick, from the link task, so nothing waits for all of it; a
+// command sent meanwhile is taken once it is done.
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#define CONSOLE_USART (configGENERATE_RUN_TIME_STATS == 1 || configUSE_TRACE_RECORDER == 1 || TEMP_CONSOLE)
+
+#if CONSOLE_USART
+
+#define CONSOLE_STATS 's'
+#define CONSOLE_TRACE 't'
+#define CONSOLE_TEMP 'c'
+
+static unsigned char (*consoleJob)(); // sends the next piece, 1 once it is all out
+
+void Console_Tick() {
+
+	if(consoleJob) {
+		if(consoleJob()) {
+			consoleJob = 0;
+		}
+		return;
+	}
+	if(!USART_HasReceived(1)) {
+		return;
+	}
+	switch(USART_Receive(1)) {
+#if configGENERATE_RUN_TIME_STATS == 1
+		case CONSOLE_STATS:
+			RunStats_Request();
+			consoleJob = RunStats_Send;
+		break;
+#endif
+#if configUSE_TRACE_RECORDER == 1
+		case CONSOLE_TRACE:
+			Trace_Request();
+			consoleJob = Trace_Send;
+		break;
+#endif
+#if TEMP_CONSOLE
+		case CONSOLE_TEMP:
+			consoleJob = Temp_Send;
+		break;
+#endif
+		default:
+		break;
+	}
+}
+
+#endif // CONSOLE_USART
+
+#endif // CONSOLE_H
@@ -148,18 +148,48 @@ void ds3231_setHr(uint8_t hour_ref, uint8_t hr) {
 	}
 }
 
-void ds3231_getT(uint8_t *temp) {
+void ds3231_getT(int16_t *quarters) {
 	
-	/* read upper byte temperature reg 0x11 */
+	/* The temperature is a signed 10 bit count of quarter degrees C: the
+	whole degrees in 0x11 and the quarters in bits 7-6 of 0x12, which the
+	chip latches together when 0x11 is read. DS3231 pg 15 */
+	
+	uint8_t msb, lsb;
 	i2c_start(DS3231_WRITE);
 	i2c_write(0x11);
 		
 	i2c_start(DS3231_READ); // read
-	*temp = i2c_read_nack();
+	msb = i2c_read_ack();
+	lsb = i2c_read_nack();
 	i2c_stop();
+	*quarters = (int16_t)(int8_t)msb * 4 + (lsb >> 6);
 		
 }
 
+void ds3231_convert(void) {
+	
+	/* Setting CONV in the control register starts a conversion now, which
+	takes up to 200 ms. If BSY in the status register says the chip is
+	already converting, its own result comes as soon. DS3231 pg 13-14 */
+	
+	uint8_t control, status;
+	i2c_start(DS3231_WRITE);
+	i2c_write(0x0E);
+	
+	i2c_start(DS3231_READ); // read
+	control = i2c_read_ack();
+	status = i2c_read_nack();
+	if(status & 0x04) { // BSY
+		i2c_stop();
+		return;
+	}
+	i2c_start(DS3231_WRITE); // write
+	i2c_write(0x0E); // control register
+	i2c_write(control | 0x20); // CONV = 1, the alarm bits as they are
+	i2c_stop();
+	
+}
+
 void ds3231_setTime(uint8_t hr,uint8_t min,uint8_t sec,uint8_t ampm, unsigned char hourMode) {
 	
 	if(hourMode == 0) { // 12 hour mode
@@ -178,4 +208,34 @@ void ds3231_setTime(uint8_t hr,uint8_t min,uint8_t sec,uint8_t ampm, unsigned ch
 	i2c_write(hr);
 	i2c_stop();	
 	
+}
+
+void ds3231_setAlarm1(uint8_t min,uint8_t hr,uint8_t day) {
+	
+	/* Alarm 1 is seconds, minutes, hours and day at 0x07-0x0A. With
+	A1M1-A1M4 (bit 7 of each) clear it matches all four, and with DY/DT
+	(bit 6 of 0x0A) set the day is the day of the week, 1-7. INTCN and
+	A1IE in the control register then pull INT/SQW low on a match, until
+	A1F in the status register is cleared. DS3231 pg 11-14 */
+	
+	i2c_start(DS3231_WRITE); // write
+	i2c_write(0x07); // starting at address of alarm 1 seconds register
+	i2c_write(0x00); // at second 0
+	i2c_write(min);
+	i2c_write(hr & 0x3F); // 24 hour
+	i2c_write(0x40 | (day & 0x07)); // DY/DT = 1, day of the week
+	i2c_write(0x1D); // control: INTCN = 1, A1IE = 1, the rest as at power on
+	i2c_write(0x08); // status: clear A1F, keep the 32 kHz output on
+	i2c_stop();
+	
+}
+
+void ds3231_alarm1Off(void) {
+	
+	i2c_start(DS3231_WRITE); // write
+	i2c_write(0x0E); // control register
+	i2c_write(0x1C); // A1IE = 0
+	i2c_write(0x08); // status: clear A1F, which lets INT/SQW go high again
+	i2c_stop();
+	
 }
\ No newline at end of file
@@ -4,11 +4,16 @@
 
 #include <avr/io.h>
 
+uint8_t dec2bcd(uint8_t d);
+uint8_t bcd2dec(uint8_t b);
 void ds3231_init(void);
 void ds3231_set(uint8_t hr,uint8_t min,uint8_t sec,uint8_t ampm,uint8_t yr,uint8_t mnth,uint8_t dt,uint8_t day);
 void ds3231_get(uint8_t *h,uint8_t *m,uint8_t *s,uint8_t *yr,uint8_t *mnth,uint8_t *dt,uint8_t *day);
 void ds3231_setHr(uint8_t hour_ref, uint8_t hr);
-void ds3231_getT(uint8_t *temp);
+void ds3231_getT(int16_t *quarters);
+void ds3231_convert(void);
 void ds3231_setTime(uint8_t hr,uint8_t min,uint8_t sec,uint8_t ampm, unsigned char hourMode);
+void ds3231_setAlarm1(uint8_t min,uint8_t hr,uint8_t day);
+void ds3231_alarm1Off(void);
 
 #endif
\ No newline at end of file
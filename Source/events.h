@@ -0,0 +1,193 @@
+// Event queue for the clock application (APP_EVENTS in Alarm1.c).
+// Include after the FreeRTOS headers and usart_ATmega1284.h (for F_CPU).
+//
+// Buttons are read by interrupt: the first edge on PORTA masks the pin
+// change interrupt and starts timer 2, which scans the pins every
+// BUTTON_SCAN ms. Once they have held still for BUTTON_SETTLE scans the
+// change is posted as presses, and as releases if EVENT_RELEASES is set,
+// and the pin change interrupt is unmasked again. While a button stays
+// down the scans post a long press after BUTTON_LONG if EVENT_LONGS is
+// set, and UP and DOWN repeat, faster the longer they are held. Nothing in
+// the clock acts on a release or a long press, so by default they are not
+// posted: a tap wakes EventTask once, and a held snooze button is only a
+// snooze, since only getting up ends the alarm. Timer 2 stops when every
+// button is up, so it only wakes the tickless idle while someone is
+// pressing. The DS3231 pulls PA6 low when the alarm in it comes
+// (rtcalarm.h), which is posted straight away. The link task posts
+// sleeper and display changes. EventTask blocks on the queue and only
+// wakes for an event or for the periodic work it still has to do.
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#define EVENT_QUEUE_LEN 8
+#define EVENT_BUTTONS 0x3C // PA2..PA5, active low
+#define EVENT_REPEATING 0x30 // UP and DOWN repeat while held
+#define EVENT_RTC_ALARM 0x40 // PA6, the DS3231's INT/SQW, active low
+#ifndef EVENT_RELEASES
+#define EVENT_RELEASES 0 // 1 posts EV_RELEASE when a button comes up
+#endif
+#ifndef EVENT_LONGS
+#define EVENT_LONGS 0 // 1 posts EV_LONG when a button is held BUTTON_LONG
+#endif
+
+#define BUTTON_SCAN 10 // ms between scans while a button is down or bouncing
+#define BUTTON_SETTLE 2 // scans the pins must hold still before a change counts
+#define BUTTON_LONG 80 // scans held before a long press
+#define BUTTON_REPEAT_DELAY 50 // scans held before the first repeat
+#define BUTTON_REPEAT_START 25 // scans between the first repeats, shrinking by a quarter each time
+#define BUTTON_REPEAT_MIN 5 // fastest repeat, after 7 repeats
+#define BUTTON_OCR ((unsigned char)(F_CPU / 1024UL * BUTTON_SCAN / 1000UL - 1)) // 77 at 8 MHz
+
+enum EventType {EV_BUTTON, EV_SLEEPER_UP, EV_RENDER, EV_RELEASE, EV_LONG, EV_REPEAT, EV_ALARM, EV_COUNT};
+
+struct Event {
+	unsigned char type; // enum EventType
+	unsigned char arg; // mask of the buttons that went down (EV_BUTTON), up (EV_RELEASE) or are held
+};
+
+struct EventStats {
+	unsigned long wakeups; // times EventTask ran
+	unsigned long redraws; // full LCD redraws, in either core
+	unsigned long posted[EV_COUNT];
+	unsigned int dropped; // queue full
+};
+
+struct EventStats eventStats;
+xQueueHandle eventQueue;
+
+static unsigned char buttonStable; // pressed buttons after debouncing
+static unsigned char buttonRaw; // pressed buttons at the last scan
+static unsigned char buttonSettle; // scans left before buttonRaw counts, 0 when settled
+static unsigned char buttonHeld; // scans buttonStable has been held, up to BUTTON_LONG
+static unsigned char buttonRepeatIn; // scans to the next repeat
+static unsigned char buttonInterval; // scans between repeats
+static unsigned char rtcAlarmLow; // EVENT_RTC_ALARM when the pin was last seen low
+
+void Event_Init() {
+
+	eventQueue = xQueueCreate(EVENT_QUEUE_LEN, sizeof(struct Event));
+#if configUSE_TRACE_RECORDER == 1
+	ucTraceObject(eventQueue, "events");
+#endif
+	TCCR2B = 0; // Stopped until a button moves
+	TCCR2A = (1 << WGM21); // CTC: clear the counter on a match with OCR2A
+	OCR2A = BUTTON_OCR;
+	TIMSK2 = (1 << OCIE2A);
+	PCMSK0 |= EVENT_BUTTONS | EVENT_RTC_ALARM;
+	PCICR |= (1 << PCIE0);
+}
+
+// Posts from a task without blocking. Returns 0 if the event was dropped.
+unsigned char Event_Post(unsigned char type, unsigned char arg) {
+
+	struct Event ev;
+	if(!eventQueue) { // Not running the event core
+		return 0;
+	}
+	ev.type = type;
+	ev.arg = arg;
+	if(xQueueSend(eventQueue, &ev, 0) != pdTRUE) {
+		eventStats.dropped++;
+		return 0;
+	}
+	eventStats.posted[type]++;
+	return 1;
+}
+
+static void Button_Post(unsigned char type, unsigned char mask, signed portBASE_TYPE *woken) {
+
+	struct Event ev;
+	ev.type = type;
+	ev.arg = mask;
+	if(xQueueSendFromISR(eventQueue, &ev, woken) == pdTRUE) {
+		eventStats.posted[type]++;
+	}
+	else {
+		eventStats.dropped++;
+	}
+}
+
+// The alarm pin fell: post it. A button moved: stop listening to their
+// edges and scan the pins until they settle.
+ISR(PCINT0_vect) {
+
+	signed portBASE_TYPE woken = pdFALSE;
+	unsigned char pins = ~PINA;
+
+	TRACE_ISR_ENTER(TRACE_ISR_PCINT0);
+	if((pins & EVENT_RTC_ALARM) && !rtcAlarmLow) {
+		Button_Post(EV_ALARM, 0, &woken);
+	}
+	rtcAlarmLow = pins & EVENT_RTC_ALARM;
+	if((PCMSK0 & EVENT_BUTTONS) && (pins & EVENT_BUTTONS) != buttonStable) {
+		PCMSK0 &= ~EVENT_BUTTONS;
+		buttonRaw = pins & EVENT_BUTTONS;
+		buttonSettle = BUTTON_SETTLE;
+		if(!TCCR2B) {
+			TCNT2 = 0;
+			TIFR2 = (1 << OCF2A);
+			TCCR2B = (1 << CS22) | (1 << CS21) | (1 << CS20); // 1024 prescaler
+		}
+	}
+	TRACE_ISR_EXIT(TRACE_ISR_PCINT0);
+	if(woken != pdFALSE) {
+		taskYIELD();
+	}
+}
+
+// Every BUTTON_SCAN ms while a button is down or bouncing
+ISR(TIMER2_COMPA_vect) {
+
+	signed portBASE_TYPE woken = pdFALSE;
+	unsigned char raw = ~PINA & EVENT_BUTTONS;
+	unsigned char changed;
+
+	TRACE_ISR_ENTER(TRACE_ISR_TIMER2);
+	if(raw != buttonRaw) { // Still bouncing
+		buttonRaw = raw;
+		buttonSettle = BUTTON_SETTLE;
+	}
+	else if(buttonSettle) {
+		if(!--buttonSettle) {
+			changed = raw ^ buttonStable;
+			if(raw & changed) {
+				Button_Post(EV_BUTTON, raw & changed, &woken);
+			}
+#if EVENT_RELEASES
+			if(buttonStable & changed) {
+				Button_Post(EV_RELEASE, buttonStable & changed, &woken);
+			}
+#endif
+			buttonStable = raw;
+			buttonHeld = 0;
+			buttonRepeatIn = BUTTON_REPEAT_DELAY;
+			buttonInterval = BUTTON_REPEAT_START;
+			PCMSK0 |= EVENT_BUTTONS;
+		}
+	}
+	else if(buttonStable) { // Held
+#if EVENT_LONGS
+		if(buttonHeld < BUTTON_LONG && ++buttonHeld == BUTTON_LONG) {
+			Button_Post(EV_LONG, buttonStable, &woken);
+		}
+#endif
+		if((buttonStable & EVENT_REPEATING) && !--buttonRepeatIn) {
+			Button_Post(EV_REPEAT, buttonStable & EVENT_REPEATING, &woken);
+			buttonInterval -= buttonInterval / 4;
+			if(buttonInterval < BUTTON_REPEAT_MIN) {
+				buttonInterval = BUTTON_REPEAT_MIN;
+			}
+			buttonRepeatIn = buttonInterval;
+		}
+	}
+	if(!buttonSettle && !buttonStable) { // All up
+		TCCR2B = 0;
+	}
+	TRACE_ISR_EXIT(TRACE_ISR_TIMER2);
+	if(woken != pdFALSE) {
+		taskYIELD();
+	}
+}
+
+#endif // EVENTS_H
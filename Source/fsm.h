@@ -0,0 +1,84 @@
+// Table-driven state machines with their tables in flash.
+// Include after <avr/pgmspace.h>.
+//
+// A machine is a table of transitions, sorted by the state they leave, and
+// an action per state. FSM_Tick tries the transitions out of the current
+// state in order and takes the first whose guard holds, or stays put if
+// none does, then runs the action of the state it is in, as the
+// transition and action switches of the hand-written machines did. State 0
+// is the initial state; a state variable that is out of range goes back to
+// it, as their default cases did.
+//
+// Guards and actions are plain functions reached through tables of
+// pointers, so machines can share guards. Everything but the state
+// variable lives in flash: three bytes per transition, one per state for
+// first[] and two for each action and guard pointer.
+//
+// The host builds (HOST_SIM) also carry the names of the machine, its
+// states and its guards for Host/fsmgraph.c, which draws every machine and
+// checks its tables.
+
+#ifndef FSM_H
+#define FSM_H
+
+#define FSM_ALWAYS 0xFF // guard of a transition that is always taken
+#define FSM_END 0xFF // from of the row that ends a transition table
+#define FSM_END_ROW {FSM_END, FSM_ALWAYS, FSM_END} // the row that ends a transition table
+
+typedef unsigned char (*FSMGuard)(void);
+typedef void (*FSMAction)(void);
+
+struct FSMTransition {
+	unsigned char from;
+	unsigned char guard; // index into the guards, or FSM_ALWAYS
+	unsigned char to;
+};
+
+struct FSM {
+	const struct FSMTransition *transitions; // ends with a row from FSM_END
+	const unsigned char *first; // per state, its first transition row
+	const FSMAction *actions; // per state, 0 for none
+	const FSMGuard *guards;
+	unsigned char states;
+#ifdef HOST_SIM
+	const char *name;
+	const char *const *stateNames;
+	const char *const *guardNames;
+	unsigned char guardCount;
+#endif
+};
+
+// The state the machine moves to from state
+static unsigned char FSM_Next(const struct FSM *m, unsigned char state) {
+
+	const struct FSMTransition *t = (const struct FSMTransition *)pgm_read_ptr(&m->transitions);
+	const FSMGuard *guards = (const FSMGuard *)pgm_read_ptr(&m->guards);
+	unsigned char n = pgm_read_byte((const unsigned char *)pgm_read_ptr(&m->first) + state);
+	unsigned char guard;
+
+	for(; pgm_read_byte(&t[n].from) == state; n++) {
+		guard = pgm_read_byte(&t[n].guard);
+		if(guard == FSM_ALWAYS || ((FSMGuard)pgm_read_ptr(&guards[guard]))()) {
+			return pgm_read_byte(&t[n].to);
+		}
+	}
+	return state;
+}
+
+// One tick of machine m (in flash) with its state in *state
+void FSM_Tick(const struct FSM *m, unsigned char *state) {
+
+	FSMAction action;
+	if(*state >= pgm_read_byte(&m->states)) {
+		*state = 0;
+	}
+	else {
+		*state = FSM_Next(m, *state);
+	}
+	action = (FSMAction)pgm_read_ptr((const FSMAction *)pgm_read_ptr(&m->actions) + *state);
+	if(action) {
+		action();
+	}
+}
+
+#endif // FSM_H
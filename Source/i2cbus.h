@@ -0,0 +1,99 @@
+// Ownership of the I2C bus (clock side). Include after the FreeRTOS headers.
+//
+// Every DS3231 transaction runs between I2CBus_Acquire and I2CBus_Release,
+// which take and give a FreeRTOS mutex. A task preempted halfway through a
+// transfer keeps the bus until it finishes, and the mutex lends it the
+// priority of any task waiting behind it, so a higher priority task is
+// held up for one transaction at most. A client waits up to
+// I2CBUS_TIMEOUT and then gives up, and its struct I2CClient counts how
+// often it found the bus taken and how long it waited; runstats.h prints
+// them with the run time report. FreeRTOSConfig.h needs configUSE_MUTEXES.
+//
+// Before I2CBus_Init (in main, before the scheduler starts) nothing else
+// can be on the bus, so Acquire always succeeds.
+
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#if configUSE_MUTEXES != 1
+#error "i2cbus.h needs configUSE_MUTEXES set to 1 in FreeRTOSConfig.h"
+#endif
+
+#ifndef queueQUEUE_TYPE_MUTEX
+#define queueQUEUE_TYPE_MUTEX 1U
+#endif
+
+#define I2CBUS_TIMEOUT 100 // ms a client waits for the bus, a few full transactions
+#define I2CBUS_MAX_CLIENTS 4
+
+struct I2CClient {
+	const char *name;
+	unsigned int uses;
+	unsigned int contended; // found the bus taken and had to wait
+	unsigned int timeouts; // gave up after I2CBUS_TIMEOUT
+	unsigned long waited; // ms spent waiting in all
+	portTickType waitMax; // longest wait, ms
+};
+
+struct I2CClient *i2cClients[I2CBUS_MAX_CLIENTS];
+unsigned char i2cClientCount;
+xQueueHandle i2cBusMutex;
+
+void I2CBus_Init() {
+
+	i2cBusMutex = xQueueCreateMutex(queueQUEUE_TYPE_MUTEX);
+#if configUSE_TRACE_RECORDER == 1
+	ucTraceObject(i2cBusMutex, "i2c");
+#endif
+}
+
+// Names a client and lists it in the report. Calling it again does nothing.
+void I2CBus_Client(struct I2CClient *c, const char *name) {
+
+	unsigned char n;
+	c->name = name;
+	for(n = 0; n < i2cClientCount; n++) {
+		if(i2cClients[n] == c) {
+			return;
+		}
+	}
+	if(i2cClientCount < I2CBUS_MAX_CLIENTS) {
+		i2cClients[i2cClientCount++] = c;
+	}
+}
+
+// Returns 1 with the bus, or 0 if it stayed taken for I2CBUS_TIMEOUT
+unsigned char I2CBus_Acquire(struct I2CClient *c) {
+
+	portTickType start, waited;
+	c->uses++;
+	if(!i2cBusMutex) {
+		return 1;
+	}
+	if(xQueueReceive(i2cBusMutex, NULL, 0) == pdTRUE) {
+		return 1;
+	}
+	c->contended++;
+	start = xTaskGetTickCount();
+	if(xQueueReceive(i2cBusMutex, NULL, I2CBUS_TIMEOUT / portTICK_RATE_MS) != pdTRUE) {
+		c->timeouts++;
+		c->waited += I2CBUS_TIMEOUT;
+		return 0;
+	}
+	waited = (portTickType)(xTaskGetTickCount() - start) * portTICK_RATE_MS;
+	c->waited += waited;
+	if(waited > c->waitMax) {
+		c->waitMax = waited;
+	}
+	return 1;
+}
+
+void I2CBus_Release(struct I2CClient *c) {
+
+	(void)c;
+	if(i2cBusMutex) {
+		xQueueSend(i2cBusMutex, NULL, 0);
+	}
+}
+
+#endif // I2CBUS_H
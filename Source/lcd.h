@@ -5,6 +5,7 @@
 #define LCD_H
 
 #include <stdio.h>
+#include <string.h>
 #include <util/delay.h>
 
 #define SET_BIT(p,i) ((p) |= (1 << (i)))
@@ -18,6 +19,11 @@
 #define RS 2			// pin number of uC connected to pin 4 of LCD disp.
 #define E 3				// pin number of uC connected to pin 6 of LCD disp.
 
+#ifndef LCD_BUFFERED
+#define LCD_BUFFERED 0 // 1 draws into RAM and LCD_Flush sends only changed characters
+#endif
+#define LCD_CELLS 32 // columns 1 - 32 of the 16x2 display
+
 /*-------------------------------------------------------------------------*/
 
 void delay_ms(int miliSec) { //for 8 Mhz crystal
@@ -63,8 +69,22 @@ void LCD_WriteCommand (unsigned char Command) {
 	delay_ms(2); // ClearScreen requires 1.52ms to execute
 }
 
+#if LCD_BUFFERED
+/* A cursor move costs a 2 ms command and a character 1 ms, so a full redraw
+   takes around 100 ms of busy-waiting. Buffered, the state machines still
+   clear and redraw the whole screen but only into lcdFrame; LCD_Flush then
+   sends the cells that differ from lcdShown, moving the cursor only when
+   the next changed cell is not where the display's auto-increment left it. */
+static unsigned char lcdFrame[LCD_CELLS]; // screen being drawn
+static unsigned char lcdShown[LCD_CELLS]; // screen on the display
+#endif
+
 void LCD_ClearScreen(void) {
+#if LCD_BUFFERED
+	memset(lcdFrame, ' ', LCD_CELLS);
+#else
 	LCD_WriteCommand(0x01);
+#endif
 }
 
 void LCD_init(void) {
@@ -74,6 +94,10 @@ void LCD_init(void) {
 	LCD_WriteCommand(0x0f);
 	LCD_WriteCommand(0x01);
 	delay_ms(10);
+#if LCD_BUFFERED
+	memset(lcdFrame, ' ', LCD_CELLS);
+	memset(lcdShown, ' ', LCD_CELLS);
+#endif
 }
 
 void LCD_WriteData(unsigned char Data) {
@@ -94,18 +118,42 @@ void LCD_Cursor(unsigned char column) {
 	}
 }
 
+void SLCD_WriteData(unsigned char column, unsigned char Data) {
+#if LCD_BUFFERED
+	if(column >= 1 && column <= LCD_CELLS) {
+		lcdFrame[column - 1] = Data;
+	}
+#else
+	LCD_Cursor(column);
+	LCD_WriteData(Data);
+#endif
+}
+
 void LCD_DisplayString( unsigned char column,  char* string) {
 	//LCD_ClearScreen();
 	unsigned char c = column;
 	while(*string) {
-		LCD_Cursor(c++);
-		LCD_WriteData(*string++);
+		SLCD_WriteData(c++, *string++);
 	}
 }
 
-void SLCD_WriteData(unsigned char column, unsigned char Data) {
-	LCD_Cursor(column);
-	LCD_WriteData(Data);
+// Sends what was drawn since the last flush. Unbuffered, it was sent already.
+void LCD_Flush(void) {
+#if LCD_BUFFERED
+	unsigned char i;
+	unsigned char at = 0; // cell the display's address counter is on, 0: unknown
+	for(i = 0; i < LCD_CELLS; i++) {
+		if(lcdFrame[i] == lcdShown[i]) {
+			continue;
+		}
+		if(at != i + 1) {
+			LCD_Cursor(i + 1);
+		}
+		LCD_WriteData(lcdFrame[i]);
+		lcdShown[i] = lcdFrame[i];
+		at = (i + 2 == 17) ? 0 : i + 2; // Row 1 does not run on into row 2
+	}
+#endif
 }
 
 #endif // LCD_H
@@ -0,0 +1,185 @@
+// Heartbeat and link quality monitor for the sensor link (clock side).
+// Include after link.h.
+//
+// LinkMon_Tick sends a LINK_PING carrying a sequence number and waits for
+// the sensor to echo it back. Round-trip times go into min/avg/max and a
+// histogram; missing replies count as lost, or garbled when a frame failed
+// its CRC while waiting. The ping period doubles while the link is healthy
+// and nothing is happening, and drops back to the minimum on a failure or
+// when LinkMon_Activity() is called.
+
+#ifndef LINKMON_H
+#define LINKMON_H
+
+#define LINKMON_TICK 20 // ms between LinkMon_Tick calls
+#define LINKMON_MIN_PERIOD 2000 // ms between pings when busy
+#define LINKMON_MAX_PERIOD 64000 // ms between pings when idle
+#define LINKMON_TIMEOUT 1000 // ms to wait for a reply
+#define LINKMON_DEGRADED 2 // consecutive failures before the link is degraded
+#define LINKMON_RECOVER 3 // consecutive replies to clear it again
+#define LINKMON_BUCKETS 8
+
+struct LinkMonStats {
+	unsigned int sent;
+	unsigned int received;
+	unsigned int lost;
+	unsigned int garbled;
+	unsigned int rttMin;
+	unsigned int rttMax;
+	unsigned long rttSum;
+	unsigned int hist[LINKMON_BUCKETS];
+};
+
+/* Upper bound (ms) of each histogram bucket, the last is open */
+static const unsigned int linkMonBounds[LINKMON_BUCKETS - 1] = {20, 50, 100, 200, 500, 1000, 2000};
+
+enum LinkMonState {LMInit, LMIdle, LMSendPing, LMWaitPong} linkMon_state;
+
+struct LinkMonStats linkMon;
+unsigned char linkDegraded = 0; // Shown on the LCD by DisplayTime_Tick
+
+static unsigned char linkMonSeq;
+static unsigned char linkMonReplied;
+static unsigned char linkMonFails;
+static unsigned char linkMonGood;
+static unsigned int linkMonBadCrc; // linkStats.rxBadCrc when the ping went out
+static portTickType linkMonSentAt;
+static portTickType linkMonLastPing;
+static portTickType linkMonPeriod = LINKMON_MIN_PERIOD;
+static portTickType linkMonRtt;
+
+void LinkMon_Init() {
+
+	linkMon_state = LMInit;
+	linkMon.rttMin = 0xFFFF;
+}
+
+// Something is happening on the clock (alarm due or sounding); keep the
+// heartbeat at its fastest rate.
+void LinkMon_Activity() {
+
+	linkMonPeriod = LINKMON_MIN_PERIOD;
+}
+
+// Called from the link dispatcher when a LINK_PONG arrives
+void LinkMon_Pong(const unsigned char *payload, unsigned char len) {
+
+	if((linkMon_state == LMSendPing || linkMon_state == LMWaitPong) && len >= 1 && payload[0] == linkMonSeq) {
+		linkMonRtt = xTaskGetTickCount() - linkMonSentAt;
+		linkMonReplied = 1;
+	} // A late reply to an earlier ping was already counted as a failure
+}
+
+unsigned int LinkMon_RttAvg() {
+
+	return linkMon.received ? (unsigned int)(linkMon.rttSum / linkMon.received) : 0;
+}
+
+static void LinkMon_Record(unsigned char ok) {
+
+	unsigned char b;
+	if(ok) {
+		linkMon.received++;
+		linkMon.rttSum += linkMonRtt;
+		if(linkMonRtt < linkMon.rttMin) {
+			linkMon.rttMin = linkMonRtt;
+		}
+		if(linkMonRtt > linkMon.rttMax) {
+			linkMon.rttMax = linkMonRtt;
+		}
+		for(b = 0; b < LINKMON_BUCKETS - 1 && linkMonRtt > linkMonBounds[b]; b++);
+		linkMon.hist[b]++;
+		linkMonFails = 0;
+		if(linkDegraded && ++linkMonGood >= LINKMON_RECOVER) {
+			linkDegraded = 0;
+		}
+		if(linkMonPeriod < LINKMON_MAX_PERIOD / 2) { // Back off while healthy
+			linkMonPeriod *= 2;
+		}
+		else {
+			linkMonPeriod = LINKMON_MAX_PERIOD;
+		}
+	}
+	else {
+		if(linkStats.rxBadCrc != linkMonBadCrc) {
+			linkMon.garbled++;
+		}
+		else {
+			linkMon.lost++;
+		}
+		linkMonGood = 0;
+		if(++linkMonFails >= LINKMON_DEGRADED) {
+			linkDegraded = 1;
+		}
+		linkMonPeriod = LINKMON_MIN_PERIOD;
+	}
+}
+
+void LinkMon_Tick() {
+
+	portTickType now = xTaskGetTickCount();
+
+	// Transitions
+	switch(linkMon_state) {
+
+		case LMInit:
+			linkMonLastPing = now;
+			linkMon_state = LMIdle;
+		break;
+
+		case LMIdle:
+			if((portTickType)(now - linkMonLastPing) >= linkMonPeriod) {
+				linkMon_state = LMSendPing;
+			}
+			else {
+				linkMon_state = LMIdle;
+			}
+		break;
+
+		case LMSendPing:
+			linkMon_state = LMWaitPong;
+		break;
+
+		case LMWaitPong:
+			if(linkMonReplied) {
+				LinkMon_Record(1);
+				linkMon_state = LMIdle;
+			}
+			else if((portTickType)(now - linkMonSentAt) >= LINKMON_TIMEOUT) {
+				LinkMon_Record(0);
+				linkMon_state = LMIdle;
+			}
+			else {
+				linkMon_state = LMWaitPong;
+			}
+		break;
+
+		default:
+			linkMon_state = LMInit;
+		break;
+	}
+
+	// Actions
+	switch(linkMon_state) {
+
+		case LMInit:
+		case LMIdle:
+		case LMWaitPong:
+		break;
+
+		case LMSendPing:
+			linkMonSeq++;
+			linkMonReplied = 0;
+			linkMonBadCrc = linkStats.rxBadCrc;
+			linkMonSentAt = now;
+			linkMonLastPing = now;
+			Link_Send(LINK_PING, &linkMonSeq, 1);
+			linkMon.sent++;
+		break;
+
+		default:
+		break;
+	}
+}
+
+#endif // LINKMON_H
@@ -0,0 +1,79 @@
+/*
+ * A hierarchical timer wheel built from lists.  This is not part of FreeRTOS
+ * V7.1.1 and has been added for the AVR port.  With configUSE_TIMER_WHEEL set
+ * to 1 in FreeRTOSConfig.h, tasks.c keeps its delayed tasks and timers.c its
+ * active timers in a wheel, instead of in a pair of lists sorted by wake time
+ * that are swapped when the tick count overflows.
+ *
+ * The wheel has listWHEEL_LEVELS levels of listWHEEL_SLOTS lists each.  Level
+ * n counts in units of listWHEEL_SLOTS^n ticks.  An item that is due d ticks
+ * after xNow goes in the lowest level that can count that far, in the slot
+ * given by that level's digit of its due time, so insertion takes the same
+ * time however many items there are.  Every tick level 0 moves on one slot,
+ * and the items in that slot are due.  When a level's digit rolls over to 0
+ * the current slot of the level above is emptied into the levels below it,
+ * so an item is moved at most listWHEEL_LEVELS - 1 times before it is due.
+ * Due times are compared modulo the tick count, so nothing special happens
+ * when it overflows.
+ *
+ * An item leaves the wheel through vListRemove(), as it would leave a list.
+ * The levels take listWHEEL_LEVELS * listWHEEL_SLOTS lists of RAM, 576 bytes
+ * with 16 bit ticks on the AVR.
+ */
+
+#ifndef LIST_WHEEL_H
+#define LIST_WHEEL_H
+
+#ifndef configUSE_TIMER_WHEEL
+	#define configUSE_TIMER_WHEEL	0
+#endif
+
+#if ( configUSE_TIMER_WHEEL == 1 )
+
+#define listWHEEL_SLOT_BITS		4
+#define listWHEEL_SLOTS			( 1U << listWHEEL_SLOT_BITS )
+
+#if ( configUSE_16_BIT_TICKS == 1 )
+	#define listWHEEL_LEVELS	4
+#else
+	#define listWHEEL_LEVELS	8
+#endif
+
+typedef struct xLIST_WHEEL
+{
+	xList xSlots[ listWHEEL_LEVELS ][ listWHEEL_SLOTS ];
+	portTickType xNow;								/*< The tick the wheel has been advanced to. */
+} xListWheel;
+
+/*
+ * Empties every slot and starts the wheel at tick xNow.
+ */
+void vListWheelInitialise( xListWheel *pxWheel, portTickType xNow );
+
+/*
+ * Inserts an item that is due at the tick in its item value, which must be
+ * after xNow.  Returns the number of ticks after xNow at which the wheel will
+ * next move or fire the item; the caller can keep the least of these as the
+ * time the wheel next needs advancing.
+ */
+portTickType xListWheelInsert( xListWheel *pxWheel, xListItem *pxNewListItem );
+
+/*
+ * Advances the wheel by one tick, moving items down from the levels above
+ * as their digits roll over, and returns the list of the items that are due
+ * at the new xNow.  The caller removes them.
+ */
+xList *pxListWheelAdvance( xListWheel *pxWheel );
+
+/*
+ * The number of ticks after xNow at which the wheel next has anything to do,
+ * or portMAX_DELAY if it is empty.  Looks at every slot.  Ticks before then
+ * can be passed over with listWHEEL_SKIP() instead of pxListWheelAdvance().
+ */
+portTickType xListWheelNextEvent( xListWheel *pxWheel );
+
+#define listWHEEL_SKIP( pxWheel, xTicks )	( ( pxWheel )->xNow += ( portTickType ) ( xTicks ) )
+
+#endif /* configUSE_TIMER_WHEEL */
+
+#endif /* LIST_WHEEL_H */
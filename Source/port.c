@@ -75,10 +75,17 @@ Changes from V2.6.0
 
 #include <stdlib.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
 
+/* Matches the default in tasks.c, for a FreeRTOSConfig.h that predates
+tickless idle. */
+#ifndef configUSE_TICKLESS_IDLE
+	#define configUSE_TICKLESS_IDLE		1
+#endif
+
 /*-----------------------------------------------------------
  * Implementation of functions defined in portable.h for the AVR port.
  *----------------------------------------------------------*/
@@ -92,6 +99,13 @@ Changes from V2.6.0
 #define portCLOCK_PRESCALER						( ( unsigned long ) 64 )
 #define portCOMPARE_MATCH_A_INTERRUPT_ENABLE	( ( unsigned char ) 0x02 )
 
+/* Timer 1 counts in one tick, and the most ticks a single compare match can
+span when the tick is suppressed (524 at 8MHz and a 1ms tick). */
+#define portTICK_COUNTS							( ( unsigned long ) ( configCPU_CLOCK_HZ / configTICK_RATE_HZ / portCLOCK_PRESCALER ) )
+#define portMAX_SUPPRESSED_TICKS				( ( portTickType ) ( 0xffffUL / portTICK_COUNTS ) )
+#define portTIMER1_INTERRUPT_MASK				TIMSK1
+#define portTIMER1_INTERRUPT_FLAGS				TIFR1
+
 /*-----------------------------------------------------------*/
 
 /* We require the address of the pxCurrentTCB variable, but don't want to know
@@ -440,6 +454,142 @@ unsigned char ucHighByte, ucLowByte;
 }
 /*-----------------------------------------------------------*/
 
+#if configUSE_TICKLESS_IDLE == 1
+
+	extern void vTaskStepTick( portTickType xTicksToJump );
+	extern portBASE_TYPE xTaskConfirmSleepModeStatus( void );
+
+	/*
+	 * Compare match B ends a suppressed tick period.  It only has to wake the
+	 * CPU; vPortSuppressTicksAndSleep() works out how long it slept.
+	 */
+	EMPTY_INTERRUPT( TIMER1_COMPB_vect );
+
+	/*
+	 * Called by the idle task, with the scheduler suspended, when no task is
+	 * due for xExpectedIdleTime ticks.  Timer 1 keeps counting from the last
+	 * tick but its period is stretched to end on the tick the next task
+	 * unblocks at, and the tick interrupt is swapped for compare match B so
+	 * the kernel sees nothing until then.  The CPU sleeps in idle mode: the
+	 * async Timer 2 and power-save mode need a 32kHz crystal on TOSC1/2,
+	 * which are PC6/PC7 and drive the LCD shift register on the clock board,
+	 * and the LED and speaker timers stop in the deeper modes.
+	 *
+	 * Any interrupt ends the sleep early.  Either way the whole ticks that
+	 * went by are handed to vTaskStepTick() and the part tick is left in
+	 * TCNT1, so the tick does not drift.
+	 */
+	void vPortSuppressTicksAndSleep( portTickType xExpectedIdleTime )
+	{
+	unsigned long ulElapsed;
+
+		if( xExpectedIdleTime > portMAX_SUPPRESSED_TICKS )
+		{
+			xExpectedIdleTime = portMAX_SUPPRESSED_TICKS;
+		}
+
+		/* Stop the timer while it is reprogrammed.  A few counts are lost
+		each time, well under a tick. */
+		portDISABLE_INTERRUPTS();
+		TCCR1B = portCLEAR_COUNTER_ON_MATCH;
+
+		if( ( portTIMER1_INTERRUPT_FLAGS & ( 1 << OCF1A ) ) || ( xTaskConfirmSleepModeStatus() == pdFALSE ) )
+		{
+			/* A tick is pending or a task has been readied: keep ticking. */
+			TCCR1B = portCLEAR_COUNTER_ON_MATCH | portPRESCALE_64;
+			portENABLE_INTERRUPTS();
+			return;
+		}
+
+		OCR1A = ( unsigned short ) ( ( unsigned long ) xExpectedIdleTime * portTICK_COUNTS - 1UL );
+		OCR1B = OCR1A;
+		portTIMER1_INTERRUPT_FLAGS = ( 1 << OCF1A ) | ( 1 << OCF1B );
+		portTIMER1_INTERRUPT_MASK = ( portTIMER1_INTERRUPT_MASK & ~( 1 << OCIE1A ) ) | ( 1 << OCIE1B );
+		TCCR1B = portCLEAR_COUNTER_ON_MATCH | portPRESCALE_64;
+
+		/* sei lets one more instruction run before any interrupt is taken, so
+		a wake up cannot slip in between it and the sleep. */
+		set_sleep_mode( SLEEP_MODE_IDLE );
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+
+		portDISABLE_INTERRUPTS();
+		TCCR1B = portCLEAR_COUNTER_ON_MATCH;
+		ulElapsed = TCNT1;
+		if( portTIMER1_INTERRUPT_FLAGS & ( 1 << OCF1A ) )
+		{
+			/* Slept the whole period and the counter has started again. */
+			ulElapsed += ( unsigned long ) OCR1A + 1UL;
+		}
+
+		/* Back to a compare match every tick, starting part way through. */
+		TCNT1 = ( unsigned short ) ( ulElapsed % portTICK_COUNTS );
+		OCR1A = ( unsigned short ) ( portTICK_COUNTS - 1UL );
+		portTIMER1_INTERRUPT_FLAGS = ( 1 << OCF1A ) | ( 1 << OCF1B );
+		portTIMER1_INTERRUPT_MASK = ( portTIMER1_INTERRUPT_MASK & ~( 1 << OCIE1B ) ) | ( 1 << OCIE1A );
+		TCCR1B = portCLEAR_COUNTER_ON_MATCH | portPRESCALE_64;
+
+		vTaskStepTick( ( portTickType ) ( ulElapsed / portTICK_COUNTS ) );
+		portENABLE_INTERRUPTS();
+	}
+
+#endif /* configUSE_TICKLESS_IDLE */
+/*-----------------------------------------------------------*/
+
+#if configGENERATE_RUN_TIME_STATS == 1
+
+	/*
+	 * Run time stats clock: the tick count and the count timer 1 has reached
+	 * in the current tick, 125 counts (8us) per 1ms tick, so no other timer
+	 * or interrupt is needed.  The 16 bit tick count wraps every 65.5
+	 * seconds, so the ticks are added up in a 32 bit count of their own;
+	 * the kernel reads this clock on every context switch, far more often
+	 * than that.  The result wraps after about 9.5 hours; clear the stats
+	 * more often than that.  FreeRTOSConfig.h enables it with:
+	 *
+	 *	#define configGENERATE_RUN_TIME_STATS	1
+	 *	extern unsigned long ulPortGetRunTimeCounter( void );
+	 *	#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+	 *	#define portGET_RUN_TIME_COUNTER_VALUE()	ulPortGetRunTimeCounter()
+	 *
+	 * Timer 1 is set up by xPortStartScheduler(), so nothing needs to be
+	 * configured beforehand.  While the tick is suppressed the count is
+	 * only read once vPortSuppressTicksAndSleep() has put it right again.
+	 */
+	static unsigned long ulRunTimeTicks = 0UL;
+	static portTickType xRunTimeLastTick = 0;
+
+	unsigned long ulPortGetRunTimeCounter( void )
+	{
+	unsigned long ulTicks;
+	unsigned short usCount;
+	portTickType xNow;
+
+		portENTER_CRITICAL();
+		{
+			xNow = xTaskGetTickCountFromISR();
+			ulRunTimeTicks += ( unsigned long ) ( portTickType ) ( xNow - xRunTimeLastTick );
+			xRunTimeLastTick = xNow;
+			ulTicks = ulRunTimeTicks;
+			usCount = TCNT1;
+
+			/* A compare match that has not been serviced yet has restarted
+			the count without adding to the tick count. */
+			if( ( portTIMER1_INTERRUPT_FLAGS & ( 1 << OCF1A ) ) && ( usCount < ( unsigned short ) ( portTICK_COUNTS / 2UL ) ) )
+			{
+				ulTicks++;
+			}
+		}
+		portEXIT_CRITICAL();
+
+		return ( ulTicks * portTICK_COUNTS ) + ( unsigned long ) usCount;
+	}
+
+#endif /* configGENERATE_RUN_TIME_STATS */
+/*-----------------------------------------------------------*/
+
 #if configUSE_PREEMPTION == 1
 
 	/*
@@ -0,0 +1,51 @@
+// The published alarm kept in the DS3231's Alarm 1 (clock side). Include
+// after alarm.h and i2cbus.h.
+//
+// Whenever UpdateTime publishes an alarm with a new next time,
+// RtcAlarm_Sync writes it into Alarm 1 (0x07-0x0A) in day of the week
+// mode, at second 0, with its interrupt on, and turns the interrupt off
+// when there is no alarm. At the alarm's minute the chip pulls INT/SQW,
+// wired to PA6, low until the next write, and the event core starts the
+// speaker on that edge (EV_ALARM, events.h) rather than looking once a
+// second. A write that could not have the bus is tried on the next pass;
+// until it goes through RtcAlarm_Armed is 0 and the event core looks
+// once a second as before.
+
+#ifndef RTCALARM_H
+#define RTCALARM_H
+
+#define RTCALARM_UNKNOWN 0xFFFE // Alarm 1 before the first write
+
+static struct I2CClient i2cRtcAlarm;
+static unsigned int rtcAlarmAt = RTCALARM_UNKNOWN; // next time in Alarm 1, ALARM_NONE when off
+
+// Writes 'next', a minute of the week or ALARM_NONE, into Alarm 1 if it
+// is not there already
+void RtcAlarm_Sync(unsigned int next) {
+
+	unsigned int minute = next % ALARM_DAY;
+	if(next == rtcAlarmAt) {
+		return;
+	}
+	if(!I2CBus_Acquire(&i2cRtcAlarm)) {
+		return;
+	}
+	if(next == ALARM_NONE) {
+		ds3231_alarm1Off();
+	}
+	else {
+		ds3231_setAlarm1(dec2bcd(minute % 60), dec2bcd(minute / 60), next / ALARM_DAY + 1); // DS3231 counts 1-7 from Sunday
+	}
+	I2CBus_Release(&i2cRtcAlarm);
+	rtcAlarmAt = next;
+}
+
+// 1 if Alarm 1 holds the published alarm and will raise EV_ALARM for it
+unsigned char RtcAlarm_Armed() {
+
+	struct ClockState now;
+	ClockState_Read(&now);
+	return now.alarmNext != ALARM_NONE && now.alarmNext == rtcAlarmAt;
+}
+
+#endif // RTCALARM_H
@@ -0,0 +1,118 @@
+// CPU time per task, reported over USART1 on request (clock side).
+// Include after the FreeRTOS headers, usart_ATmega1284.h, periodic.h,
+// stacks.h and i2cbus.h.
+//
+// Built when FreeRTOSConfig.h turns on configGENERATE_RUN_TIME_STATS with
+// the timer 1 clock from port.c (see ulPortGetRunTimeCounter). The kernel
+// adds up how long each task ran every time it is switched out. An 's' on
+// the USART1 console (console.h) prints every task's share of the CPU since
+// the last report, the idle share, the overruns of the fixed-rate loops and
+// the stack left in each task and how long each I2C client has waited for
+// the bus since reset, then starts a new window. Measure a window
+// before and after a change to see what it saved.
+//
+// A window nobody asked about is restarted after RUNSTATS_MAX_WINDOW,
+// before the 8us counter can wrap. The counter carries the ticks in 32
+// bits of its own, so it runs for 9.5 hours, not the 65.5 seconds of the
+// 16 bit tick count.
+
+#ifndef RUNSTATS_H
+#define RUNSTATS_H
+
+#if configGENERATE_RUN_TIME_STATS == 1
+
+#define RUNSTATS_MAX_WINDOW (8UL * 60UL * 60UL * 1000UL) // ms, the 8us counter wraps after 2^32 * 8us, 9.5 hours
+#define RUNSTATS_TEXT 1024 // 50 bytes a task from the kernel, 8 tasks, plus the loops, stacks and I2C clients
+
+/* Added to tasks.c, not in the stock task.h */
+void vTaskClearRunTimeStats(void);
+unsigned long ulTaskGetIdleRunTimeCounter(void);
+
+static char runStatsText[RUNSTATS_TEXT];
+static unsigned int runStatsLen;
+static unsigned int runStatsSent; // report sent up to here
+static unsigned long runStatsStart; // run time counter when the window opened
+static unsigned long runStatsWindow; // ms in the window
+static portTickType runStatsLast;
+
+static void RunStats_Clear() {
+
+	vTaskClearRunTimeStats();
+	runStatsStart = portGET_RUN_TIME_COUNTER_VALUE();
+	runStatsWindow = 0;
+}
+
+void RunStats_Init() {
+
+	runStatsLast = xTaskGetTickCount();
+	RunStats_Clear();
+}
+
+// Formats the window into runStatsText and starts a new one
+void RunStats_Request() {
+
+	unsigned long total = (portGET_RUN_TIME_COUNTER_VALUE() - runStatsStart) / 1000UL;
+	unsigned long idle = total ? ulTaskGetIdleRunTimeCounter() / total : 0; // tenths of a percent
+	unsigned char n;
+	int len;
+
+	if(idle > 1000) {
+		idle = 1000;
+	}
+	len = snprintf(runStatsText, RUNSTATS_TEXT, "\r\nCPU over %lu ms\r\nTask\t\tCount\t\tShare", runStatsWindow);
+	vTaskGetRunTimeStats((signed char *)runStatsText + len); // Starts with a line break
+	len += strlen(runStatsText + len);
+	len += snprintf(runStatsText + len, RUNSTATS_TEXT - len, "Idle %lu.%lu%%, load %lu.%lu%%\r\nLoop\t\tRuns\tOverruns\r\n",
+		idle / 10, idle % 10, (1000 - idle) / 10, (1000 - idle) % 10);
+	for(n = 0; n < periodicCount && len < RUNSTATS_TEXT; n++) {
+		len += snprintf(runStatsText + len, RUNSTATS_TEXT - len, "%s\t%u\t%u\r\n",
+			periodicTasks[n]->name, periodicTasks[n]->runs, periodicTasks[n]->overruns);
+	}
+#if INCLUDE_uxTaskGetStackHighWaterMark == 1
+	if(len < RUNSTATS_TEXT) {
+		len += snprintf(runStatsText + len, RUNSTATS_TEXT - len, "Stack\t\tDepth\tFree\r\n");
+	}
+	for(n = 0; n < stackCount && len < RUNSTATS_TEXT; n++) {
+		unsigned short free = Stack_Free(n);
+		len += snprintf(runStatsText + len, RUNSTATS_TEXT - len, "%s\t%u\t%u%s\r\n",
+			stackTasks[n].name, stackTasks[n].depth, free, free < STACK_MARGIN ? " low" : "");
+	}
+#endif
+	if(len < RUNSTATS_TEXT) {
+		len += snprintf(runStatsText + len, RUNSTATS_TEXT - len, "I2C		Uses	Waited	Timeouts	Wait ms	Max\r\n");
+	}
+	for(n = 0; n < i2cClientCount && len < RUNSTATS_TEXT; n++) {
+		len += snprintf(runStatsText + len, RUNSTATS_TEXT - len, "%s\t%u\t%u\t%u\t%lu\t%u\r\n",
+			i2cClients[n]->name, i2cClients[n]->uses, i2cClients[n]->contended, i2cClients[n]->timeouts,
+			i2cClients[n]->waited, (unsigned int)i2cClients[n]->waitMax);
+	}
+	runStatsLen = (len < RUNSTATS_TEXT) ? len : RUNSTATS_TEXT - 1;
+	runStatsSent = 0;
+	RunStats_Clear();
+}
+
+// Sends the next line of the report. Returns 1 once it is all out.
+unsigned char RunStats_Send() {
+
+	while(runStatsSent < runStatsLen) {
+		USART_Send(runStatsText[runStatsSent], 1);
+		if(runStatsText[runStatsSent++] == '\n') {
+			break;
+		}
+	}
+	return runStatsSent >= runStatsLen;
+}
+
+void RunStats_Tick() {
+
+	portTickType now = xTaskGetTickCount();
+	runStatsWindow += (portTickType)(now - runStatsLast) * portTICK_RATE_MS;
+	runStatsLast = now;
+	if(runStatsWindow >= RUNSTATS_MAX_WINDOW) {
+		RunStats_Clear();
+	}
+}
+
+#endif // configGENERATE_RUN_TIME_STATS
+
+#endif // RUNSTATS_H
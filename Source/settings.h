@@ -0,0 +1,188 @@
+// Settings kept across power cuts in the EEPROM (clock side). Include after
+// alarm.h and <util/crc16.h>.
+//
+// The settings (the hour mode and the alarm table) live in RAM as ever, in
+// clockState and alarms[]. Whatever changes one calls Settings_Changed,
+// which only notes the tick. Settings_Poll runs from the idle hook: once
+// nothing has changed for SETTINGS_IDLE it copies the settings into
+// settingsOut and, if they differ from what was written last, stamps the
+// copy with the next sequence number and a CRC and hands it to the
+// EE_READY interrupt. That writes one byte each time the EEPROM is ready
+// (3.3 ms a byte) and skips bytes that already hold the value, so a burst
+// of button presses costs one record and no task ever waits on the EEPROM.
+//
+// Records go round SETTINGS_SLOTS slots, so each slot takes one write in
+// SETTINGS_SLOTS. A record starts by clearing the version byte of its slot
+// and ends by writing it: one cut short by a power loss has no version,
+// whatever its CRC comes to, and the one before, still in its own slot, is
+// used. The CRC catches bytes that went bad later.
+// Settings_Load, at boot, reads every slot once and keeps the valid record
+// with the highest sequence number (compared modulo 2^16, as they wrap).
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#define SETTINGS_VERSION 1 // change with the layout of struct Settings
+#define SETTINGS_UNFINISHED 0 // version of a slot being written
+#define SETTINGS_SLOTS 16 // records in the ring, 102 bytes each on the AVR
+#define SETTINGS_IDLE 5000 // ms without a change before a record is written
+
+struct SettingsAlarm {
+	unsigned int minute; // ALARM_NONE when off
+	unsigned char days, lead, melody, sleepers;
+};
+
+struct Settings {
+	unsigned char hourMode;
+	struct SettingsAlarm alarms[ALARM_MAX];
+};
+
+struct SettingsRecord {
+	unsigned char version; // SETTINGS_VERSION, written last
+	uint16_t seq;
+	struct Settings settings;
+	uint16_t crc; // CCITT of every byte before it
+};
+
+struct SettingsRecord EEMEM settingsRing[SETTINGS_SLOTS];
+struct SettingsRecord settingsOut; // the record written last, or being written
+static unsigned char settingsSlot; // slot of settingsOut
+static unsigned char settingsPos; // next step of the interrupt, see EE_READY_vect
+static unsigned char settingsDirty;
+static portTickType settingsChangedAt;
+unsigned int settingsRecords; // records written since boot
+unsigned int settingsBytes; // bytes programmed since boot
+
+static uint16_t Settings_Crc(const struct SettingsRecord *r) {
+
+	const unsigned char *p = (const unsigned char *)r;
+	uint16_t crc = 0xFFFF;
+	unsigned char n;
+	for(n = 0; n < offsetof(struct SettingsRecord, crc); n++) {
+		crc = _crc_ccitt_update(crc, p[n]);
+	}
+	return crc;
+}
+
+void Settings_Changed() {
+
+	settingsChangedAt = xTaskGetTickCount();
+	settingsDirty = 1;
+}
+
+// Copies the settings into settingsOut. Returns 1 if any differed.
+static unsigned char Settings_Fill() {
+
+	struct Settings *s = &settingsOut.settings;
+	struct SettingsAlarm *to;
+	unsigned char id, changed = 0;
+	unsigned int minute;
+
+#define SETTINGS_PUT(field, value) do { if((field) != (value)) { (field) = (value); changed = 1; } } while(0)
+	vTaskSuspendAll(); // Writers change them with the scheduler suspended
+	SETTINGS_PUT(s->hourMode, clockState.hourMode);
+	for(id = 0; id < ALARM_MAX; id++) {
+		to = &s->alarms[id];
+		minute = alarms[id].on ? alarms[id].minute : ALARM_NONE;
+		SETTINGS_PUT(to->minute, minute);
+		SETTINGS_PUT(to->days, alarms[id].days);
+		SETTINGS_PUT(to->lead, alarms[id].lead);
+		SETTINGS_PUT(to->melody, alarms[id].melody);
+		SETTINGS_PUT(to->sleepers, alarms[id].sleepers);
+	}
+	xTaskResumeAll();
+#undef SETTINGS_PUT
+	return changed;
+}
+
+// From the idle hook: starts the write of a record once the settings have
+// been left alone for SETTINGS_IDLE
+void Settings_Poll() {
+
+	if(!settingsDirty || (EECR & (1 << EERIE)) ||
+		(portTickType)(xTaskGetTickCount() - settingsChangedAt) < SETTINGS_IDLE / portTICK_RATE_MS) {
+		return;
+	}
+	settingsDirty = 0;
+	if(!Settings_Fill()) {
+		return;
+	}
+	settingsOut.version = SETTINGS_VERSION;
+	settingsOut.seq++;
+	settingsOut.crc = Settings_Crc(&settingsOut);
+	settingsSlot = (settingsSlot + 1) % SETTINGS_SLOTS;
+	settingsPos = 0;
+	EECR |= (1 << EERIE);
+}
+
+// Writes the next byte of settingsOut that differs from the slot, and
+// turns itself off after the last. Step 0 clears the version, steps 1 to
+// sizeof - 1 write the bytes after it and the last step the version.
+ISR(EE_READY_vect) {
+
+	const unsigned char *from = (const unsigned char *)&settingsOut;
+	uint8_t *to = (uint8_t *)&settingsRing[settingsSlot];
+	unsigned char n, data;
+	TRACE_ISR_ENTER(TRACE_ISR_EE_READY);
+	while(settingsPos <= sizeof(settingsOut)) {
+		n = (settingsPos == sizeof(settingsOut)) ? 0 : settingsPos;
+		data = settingsPos ? from[n] : SETTINGS_UNFINISHED;
+		settingsPos++;
+		if(eeprom_read_byte(&to[n]) != data) {
+			eeprom_write_byte(&to[n], data); // EEPE is clear, so this does not wait
+			settingsBytes++;
+			break;
+		}
+	}
+	if(settingsPos > sizeof(settingsOut)) {
+		EECR &= ~(1 << EERIE);
+		settingsRecords++;
+	}
+	TRACE_ISR_EXIT(TRACE_ISR_EE_READY);
+}
+
+// Loads the newest valid record, if there is one, and schedules its alarms
+// from the time in clockState. Call once UpdateTime has run, before the
+// scheduler starts.
+void Settings_Load() {
+
+	struct SettingsRecord r;
+	struct ClockState *c;
+	unsigned char *p = (unsigned char *)&r;
+	unsigned char slot, n, found = 0;
+	uint16_t crc;
+
+	for(slot = 0; slot < SETTINGS_SLOTS; slot++) {
+		crc = 0xFFFF;
+		for(n = 0; n < sizeof(r); n++) {
+			p[n] = eeprom_read_byte((const uint8_t *)&settingsRing[slot] + n);
+			if(n < offsetof(struct SettingsRecord, crc)) {
+				crc = _crc_ccitt_update(crc, p[n]);
+			}
+		}
+		if(r.version == SETTINGS_VERSION && r.crc == crc && (!found || (int16_t)(r.seq - settingsOut.seq) > 0)) {
+			settingsOut = r;
+			settingsSlot = slot;
+			found = 1;
+		}
+	}
+	if(!found) { // A blank EEPROM: keep the defaults, written on the first change
+		settingsSlot = SETTINGS_SLOTS - 1;
+		return;
+	}
+	c = ClockState_Begin();
+	c->hourMode = settingsOut.settings.hourMode;
+	for(n = 0; n < ALARM_MAX; n++) {
+		struct SettingsAlarm *a = &settingsOut.settings.alarms[n];
+		alarms[n].on = a->minute < ALARM_DAY;
+		alarms[n].minute = alarms[n].on ? a->minute : 0;
+		alarms[n].days = a->days;
+		alarms[n].lead = (a->lead > ALARM_LEAD_MAX) ? ALARM_LEAD_MAX : a->lead;
+		alarms[n].melody = a->melody;
+		alarms[n].sleepers = a->sleepers;
+	}
+	Alarm_Reschedule(c);
+	ClockState_End();
+}
+
+#endif // SETTINGS_H
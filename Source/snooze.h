@@ -0,0 +1,64 @@
+// Snooze (clock side). Include after the FreeRTOS headers and timers.h.
+//
+// Snooze_Start pauses a sounding alarm for SNOOZE_MINUTES (set it with
+// -D). It is counted down by a FreeRTOS software timer that fires once a
+// minute, as a tick count of 16 bits runs out after 65 s, and stops itself
+// at zero; the timer task does the waiting, so snoozing costs no polling
+// task. The machines go by Snooze_Active: the speaker and the light pause
+// while it holds and pick up again once it is over. FreeRTOSConfig.h needs
+// configUSE_TIMERS.
+
+#ifndef SNOOZE_H
+#define SNOOZE_H
+
+#if configUSE_TIMERS != 1
+#error "snooze.h needs configUSE_TIMERS set to 1 in FreeRTOSConfig.h"
+#endif
+
+#ifndef SNOOZE_MINUTES
+#define SNOOZE_MINUTES 9 // 1-255
+#endif
+#define SNOOZE_MINUTE 60000 // ms per timer period
+
+volatile unsigned char snoozeLeft; // minutes to go, 0 when not snoozing
+unsigned char snoozeCount; // snoozes since boot
+static xTimerHandle snoozeTimer;
+
+static void Snooze_Minute(xTimerHandle timer) {
+
+	if(snoozeLeft && --snoozeLeft == 0) {
+		xTimerStop(timer, 0);
+	}
+}
+
+void Snooze_Init() {
+
+	snoozeTimer = xTimerCreate((const signed char *)"snooze", SNOOZE_MINUTE / portTICK_RATE_MS, pdTRUE, 0, Snooze_Minute);
+}
+
+unsigned char Snooze_Active() {
+
+	return snoozeLeft != 0;
+}
+
+// Starts a snooze unless one is on. Returns 1 if it started.
+unsigned char Snooze_Start() {
+
+	if(!snoozeTimer || snoozeLeft) {
+		return 0;
+	}
+	snoozeLeft = SNOOZE_MINUTES;
+	snoozeCount++;
+	xTimerReset(snoozeTimer, 0); // A minute from now
+	return 1;
+}
+
+void Snooze_Cancel() {
+
+	if(snoozeTimer) {
+		xTimerStop(snoozeTimer, 0);
+	}
+	snoozeLeft = 0;
+}
+
+#endif // SNOOZE_H
@@ -0,0 +1,59 @@
+// Stack high-water marks of the application tasks (clock side).
+// Include after the FreeRTOS headers.
+//
+// The kernel fills every task stack with 0xa5 when it creates the task, and
+// uxTaskGetStackHighWaterMark counts how much of the fill at the far end
+// has never been written. Tasks are registered with Stack_Watch as they are
+// created; Stack_Free reads a mark at run time and the USART1 report in
+// runstats.h lists them all. A task that is down to its last STACK_MARGIN
+// bytes is close to overflowing: give it more, or size them all from the
+// call graph with Host/stacksize.
+
+#ifndef STACKS_H
+#define STACKS_H
+
+#if INCLUDE_uxTaskGetStackHighWaterMark == 1
+
+#define STACK_MAX 10 // tasks that can register
+#define STACK_MARGIN 16 // bytes free below which a task is reported as low
+
+struct StackWatch {
+	const char *name;
+	xTaskHandle handle;
+	unsigned short depth; // as given to xTaskCreate
+};
+
+struct StackWatch stackTasks[STACK_MAX];
+unsigned char stackCount;
+
+void Stack_Watch(xTaskHandle handle, const char *name, unsigned short depth) {
+
+	if(handle && stackCount < STACK_MAX) {
+		stackTasks[stackCount].name = name;
+		stackTasks[stackCount].handle = handle;
+		stackTasks[stackCount].depth = depth;
+		stackCount++;
+	}
+}
+
+// Least free stack task n has had since it started
+unsigned short Stack_Free(unsigned char n) {
+
+	return uxTaskGetStackHighWaterMark(stackTasks[n].handle);
+}
+
+// 1 if any task has come within STACK_MARGIN of the end of its stack
+unsigned char Stack_Low() {
+
+	unsigned char n;
+	for(n = 0; n < stackCount; n++) {
+		if(Stack_Free(n) < STACK_MARGIN) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+#endif // INCLUDE_uxTaskGetStackHighWaterMark
+
+#endif // STACKS_H
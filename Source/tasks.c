@@ -77,10 +77,51 @@ task.h is included from an application file. */
 #include "FreeRTOS.h"
 #include "task.h"
 #include "timers.h"
+#include "listwheel.h"
 #include "StackMacros.h"
 
 #undef MPU_WRAPPERS_INCLUDED_FROM_API_FILE
 
+/*
+ * Tickless idle is not part of V7.1.1 and has been added for the AVR port.
+ * These defaults stand in for the FreeRTOSConfig.h entries.  With it enabled
+ * the idle task asks the port to sleep through the ticks until the next task
+ * unblocks, rather than waking for every one of them.
+ */
+#ifndef configUSE_TICKLESS_IDLE
+	#define configUSE_TICKLESS_IDLE					1
+#endif
+
+#ifndef configEXPECTED_IDLE_TIME_BEFORE_SLEEP
+	#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP	2
+#endif
+
+#if ( configUSE_TICKLESS_IDLE == 1 )
+	extern void vPortSuppressTicksAndSleep( portTickType xExpectedIdleTime );
+	#ifndef portSUPPRESS_TICKS_AND_SLEEP
+		#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) vPortSuppressTicksAndSleep( xExpectedIdleTime )
+	#endif
+#endif
+
+/*
+ * Optimised task selection is not part of V7.1.1 either.  With it enabled
+ * uxTopReadyPriority holds one bit for each priority that has a ready task,
+ * and the highest is found with a table rather than by walking down the
+ * empty ready lists one at a time.  The bits fit an unsigned portBASE_TYPE,
+ * a byte on the AVR, so it is only the default with up to 8 priorities.
+ */
+#ifndef configUSE_PORT_OPTIMISED_TASK_SELECTION
+	#if ( configMAX_PRIORITIES <= 8 )
+		#define configUSE_PORT_OPTIMISED_TASK_SELECTION	1
+	#else
+		#define configUSE_PORT_OPTIMISED_TASK_SELECTION	0
+	#endif
+#endif
+
+#if ( ( configUSE_PORT_OPTIMISED_TASK_SELECTION == 1 ) && ( configMAX_PRIORITIES > 8 ) )
+	#error configUSE_PORT_OPTIMISED_TASK_SELECTION can only be used with up to 8 priorities.
+#endif
+
 /*
  * Macro to define the amount of stack available to the idle task.
  */
@@ -146,10 +187,18 @@ PRIVILEGED_DATA tskTCB * volatile pxCurrentTCB = NULL;
 /* Lists for ready and blocked tasks. --------------------*/
 
 PRIVILEGED_DATA static xList pxReadyTasksLists[ configMAX_PRIORITIES ];	/*< Prioritised ready tasks. */
-PRIVILEGED_DATA static xList xDelayedTaskList1;							/*< Delayed tasks. */
-PRIVILEGED_DATA static xList xDelayedTaskList2;							/*< Delayed tasks (two lists are used - one for delays that have overflowed the current tick count. */
-PRIVILEGED_DATA static xList * volatile pxDelayedTaskList ;				/*< Points to the delayed task list currently being used. */
-PRIVILEGED_DATA static xList * volatile pxOverflowDelayedTaskList;		/*< Points to the delayed task list currently being used to hold tasks that have overflowed the current tick count. */
+#if ( configUSE_TIMER_WHEEL == 1 )
+
+	PRIVILEGED_DATA static xListWheel xDelayedTaskWheel;					/*< Delayed tasks, in the slot for their wake time.  Kept at xTickCount. */
+
+#else
+
+	PRIVILEGED_DATA static xList xDelayedTaskList1;							/*< Delayed tasks. */
+	PRIVILEGED_DATA static xList xDelayedTaskList2;							/*< Delayed tasks (two lists are used - one for delays that have overflowed the current tick count. */
+	PRIVILEGED_DATA static xList * volatile pxDelayedTaskList ;				/*< Points to the delayed task list currently being used. */
+	PRIVILEGED_DATA static xList * volatile pxOverflowDelayedTaskList;		/*< Points to the delayed task list currently being used to hold tasks that have overflowed the current tick count. */
+
+#endif
 PRIVILEGED_DATA static xList xPendingReadyList;							/*< Tasks that have been readied while the scheduler was suspended.  They will be moved to the ready queue when the scheduler is resumed. */
 
 #if ( INCLUDE_vTaskDelete == 1 )
@@ -188,7 +237,9 @@ PRIVILEGED_DATA static portTickType xNextTaskUnblockTime						= ( portTickType )
 
 	PRIVILEGED_DATA static char pcStatsString[ 50 ] ;
 	PRIVILEGED_DATA static unsigned long ulTaskSwitchedInTime = 0UL;	/*< Holds the value of a timer/counter the last time a task was switched in. */
+	PRIVILEGED_DATA static unsigned long ulRunTimeStatsStart = 0UL;	/*< Holds the value of the timer/counter when the stats were last cleared. */
 	static void prvGenerateRunTimeStatsForTasksInList( const signed char *pcWriteBuffer, xList *pxList, unsigned long ulTotalRunTime ) PRIVILEGED_FUNCTION;
+	static void prvClearRunTimeStatsForTasksInList( xList *pxList ) PRIVILEGED_FUNCTION;
 
 #endif
 
@@ -210,6 +261,78 @@ PRIVILEGED_DATA static portTickType xNextTaskUnblockTime						= ( portTickType )
 
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_PORT_OPTIMISED_TASK_SELECTION == 0 )
+
+	/* uxTopReadyPriority is the highest priority that might have a ready
+	task.  It is raised as tasks become ready and lowered as the scheduler
+	finds the lists above it empty. */
+	#define taskRECORD_READY_PRIORITY( uxPriority )														\
+		if( ( uxPriority ) > uxTopReadyPriority )														\
+		{																								\
+			uxTopReadyPriority = ( uxPriority );														\
+		}
+
+	#define taskRESET_READY_PRIORITY( uxPriority )
+
+	#define taskSELECT_HIGHEST_PRIORITY_TASK()															\
+	{																									\
+		/* Find the highest priority queue that contains ready tasks. */								\
+		while( listLIST_IS_EMPTY( &( pxReadyTasksLists[ uxTopReadyPriority ] ) ) )						\
+		{																								\
+			configASSERT( uxTopReadyPriority );															\
+			--uxTopReadyPriority;																		\
+		}																								\
+																										\
+		/* listGET_OWNER_OF_NEXT_ENTRY walks through the list, so the tasks of the						\
+		same priority get an equal share of the processor time. */										\
+		listGET_OWNER_OF_NEXT_ENTRY( pxCurrentTCB, &( pxReadyTasksLists[ uxTopReadyPriority ] ) );		\
+	}
+
+#else
+
+	/* The bit of each priority, and the highest bit set in each nibble.  The
+	AVR shifts one place per instruction, so a table beats 1 << uxPriority. */
+	static const unsigned char ucPriorityBit[ 8 ] = { 0x01U, 0x02U, 0x04U, 0x08U, 0x10U, 0x20U, 0x40U, 0x80U };
+	static const unsigned char ucTopBitOfNibble[ 16 ] = { 0U, 0U, 1U, 1U, 2U, 2U, 2U, 2U, 3U, 3U, 3U, 3U, 3U, 3U, 3U, 3U };
+
+	#ifndef portGET_HIGHEST_PRIORITY
+		#define portGET_HIGHEST_PRIORITY( uxTopPriority, uxReadyPriorities )							\
+			if( ( ( uxReadyPriorities ) & 0xf0U ) != 0U )												\
+			{																							\
+				uxTopPriority = ucTopBitOfNibble[ ( uxReadyPriorities ) >> 4 ] + 4U;					\
+			}																							\
+			else																						\
+			{																							\
+				uxTopPriority = ucTopBitOfNibble[ ( uxReadyPriorities ) ];								\
+			}
+	#endif
+
+	#define taskRECORD_READY_PRIORITY( uxPriority )														\
+		uxTopReadyPriority |= ucPriorityBit[ ( uxPriority ) ]
+
+	/* Called after a task has left the ready list of uxPriority; the bit goes
+	when the list is empty. */
+	#define taskRESET_READY_PRIORITY( uxPriority )														\
+	{																									\
+		if( listLIST_IS_EMPTY( &( pxReadyTasksLists[ ( uxPriority ) ] ) ) )								\
+		{																								\
+			uxTopReadyPriority &= ( unsigned portBASE_TYPE ) ~ucPriorityBit[ ( uxPriority ) ];			\
+		}																								\
+	}
+
+	#define taskSELECT_HIGHEST_PRIORITY_TASK()															\
+	{																									\
+	unsigned portBASE_TYPE uxTopPriority, uxReadyPriorities = uxTopReadyPriority;						\
+																										\
+		/* The idle task is always ready, so there is always a bit set. */								\
+		configASSERT( uxReadyPriorities );																\
+		portGET_HIGHEST_PRIORITY( uxTopPriority, uxReadyPriorities );									\
+		listGET_OWNER_OF_NEXT_ENTRY( pxCurrentTCB, &( pxReadyTasksLists[ uxTopPriority ] ) );			\
+	}
+
+#endif /* configUSE_PORT_OPTIMISED_TASK_SELECTION */
+/*-----------------------------------------------------------*/
+
 /*
  * Place the task represented by pxTCB into the appropriate ready queue for
  * the task.  It is inserted at the end of the list.  One quirk of this is
@@ -219,10 +342,7 @@ PRIVILEGED_DATA static portTickType xNextTaskUnblockTime						= ( portTickType )
  */
 #define prvAddTaskToReadyQueue( pxTCB )																					\
 	traceMOVED_TASK_TO_READY_STATE( pxTCB )																				\
-	if( ( pxTCB )->uxPriority > uxTopReadyPriority )																	\
-	{																													\
-		uxTopReadyPriority = ( pxTCB )->uxPriority;																		\
-	}																													\
+	taskRECORD_READY_PRIORITY( ( pxTCB )->uxPriority );																	\
 	vListInsertEnd( ( xList * ) &( pxReadyTasksLists[ ( pxTCB )->uxPriority ] ), &( ( pxTCB )->xGenericListItem ) )
 /*-----------------------------------------------------------*/
 
@@ -234,6 +354,40 @@ PRIVILEGED_DATA static portTickType xNextTaskUnblockTime						= ( portTickType )
  * once one tasks has been found whose timer has not expired we need not look
  * any further down the list.
  */
+#if ( configUSE_TIMER_WHEEL == 1 )
+
+/*
+ * With the timer wheel the wheel is moved on every tick, and the slot it
+ * comes to holds the tasks that wake now.  xNextTaskUnblockTime is the next
+ * tick at which the wheel fires or moves anything; it only matters to the
+ * tickless idle, and is worked out again each time it is reached.
+ */
+#define prvCheckDelayedTasks()															\
+{																						\
+xList *pxDueList;																		\
+																						\
+	pxDueList = pxListWheelAdvance( &xDelayedTaskWheel );								\
+	while( listLIST_IS_EMPTY( pxDueList ) == pdFALSE )									\
+	{																					\
+		pxTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY( pxDueList );					\
+		vListRemove( &( pxTCB->xGenericListItem ) );									\
+																						\
+		/* Is the task waiting on an event also? */										\
+		if( pxTCB->xEventListItem.pvContainer != NULL )									\
+		{																				\
+			vListRemove( &( pxTCB->xEventListItem ) );									\
+		}																				\
+		prvAddTaskToReadyQueue( pxTCB );												\
+	}																					\
+																						\
+	if( xTickCount == xNextTaskUnblockTime )											\
+	{																					\
+		xNextTaskUnblockTime = xTickCount + xListWheelNextEvent( &xDelayedTaskWheel );	\
+	}																					\
+}
+
+#else
+
 #define prvCheckDelayedTasks()															\
 {																						\
 portTickType xItemValue;																\
@@ -285,6 +439,8 @@ portTickType xItemValue;																\
 		}																				\
 	}																					\
 }
+
+#endif /* configUSE_TIMER_WHEEL */
 /*-----------------------------------------------------------*/
 
 /*
@@ -358,6 +514,17 @@ static void prvAddCurrentTaskToDelayedList( portTickType xTimeToWake ) PRIVILEGE
  */
 static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TYPE *puxStackBuffer ) PRIVILEGED_FUNCTION;
 
+/*
+ * Return the number of ticks the idle task can sleep for, which is zero if
+ * any other task is ready to run.  The result is only safe to act on while
+ * the scheduler is suspended.
+ */
+#if ( configUSE_TICKLESS_IDLE == 1 )
+
+	static portTickType prvGetExpectedIdleTime( void ) PRIVILEGED_FUNCTION;
+
+#endif
+
 /*
  * Called from vTaskList.  vListTasks details all the tasks currently under
  * control of the scheduler.  The tasks may be in one of a number of lists.
@@ -579,6 +746,7 @@ tskTCB * pxNewTCB;
 			the termination list and free up any memory allocated by the
 			scheduler for the TCB and stack. */
 			vListRemove( &( pxTCB->xGenericListItem ) );
+			taskRESET_READY_PRIORITY( pxTCB->uxPriority );
 
 			/* Is the task waiting on an event also? */
 			if( pxTCB->xEventListItem.pvContainer != NULL )
@@ -671,6 +839,7 @@ tskTCB * pxNewTCB;
 				ourselves to the blocked list as the same list item is used for
 				both lists. */
 				vListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+				taskRESET_READY_PRIORITY( pxCurrentTCB->uxPriority );
 				prvAddCurrentTaskToDelayedList( xTimeToWake );
 			}
 		}
@@ -717,6 +886,7 @@ tskTCB * pxNewTCB;
 				ourselves to the blocked list as the same list item is used for
 				both lists. */
 				vListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+				taskRESET_READY_PRIORITY( pxCurrentTCB->uxPriority );
 				prvAddCurrentTaskToDelayedList( xTimeToWake );
 			}
 			xAlreadyYielded = xTaskResumeAll();
@@ -848,6 +1018,7 @@ tskTCB * pxNewTCB;
 					it to it's new ready list.  As we are in a critical section we
 					can do this even if the scheduler is suspended. */
 					vListRemove( &( pxTCB->xGenericListItem ) );
+					taskRESET_READY_PRIORITY( uxCurrentPriority );
 					prvAddTaskToReadyQueue( pxTCB );
 				}
 
@@ -885,6 +1056,7 @@ tskTCB * pxNewTCB;
 
 			/* Remove task from the ready/delayed list and place in the	suspended list. */
 			vListRemove( &( pxTCB->xGenericListItem ) );
+			taskRESET_READY_PRIORITY( pxTCB->uxPriority );
 
 			/* Is the task waiting on an event also? */
 			if( pxTCB->xEventListItem.pvContainer != NULL )
@@ -1305,15 +1477,34 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void )
 				}
 			}while( uxQueue > ( unsigned short ) tskIDLE_PRIORITY );
 
-			if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+			#if ( configUSE_TIMER_WHEEL == 1 )
 			{
-				prvListTaskWithinSingleList( pcWriteBuffer, ( xList * ) pxDelayedTaskList, tskBLOCKED_CHAR );
-			}
+			unsigned portBASE_TYPE uxLevel, uxSlot;
 
-			if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				for( uxLevel = 0U; uxLevel < listWHEEL_LEVELS; uxLevel++ )
+				{
+					for( uxSlot = 0U; uxSlot < listWHEEL_SLOTS; uxSlot++ )
+					{
+						if( listLIST_IS_EMPTY( &( xDelayedTaskWheel.xSlots[ uxLevel ][ uxSlot ] ) ) == pdFALSE )
+						{
+							prvListTaskWithinSingleList( pcWriteBuffer, &( xDelayedTaskWheel.xSlots[ uxLevel ][ uxSlot ] ), tskBLOCKED_CHAR );
+						}
+					}
+				}
+			}
+			#else
 			{
-				prvListTaskWithinSingleList( pcWriteBuffer, ( xList * ) pxOverflowDelayedTaskList, tskBLOCKED_CHAR );
+				if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+				{
+					prvListTaskWithinSingleList( pcWriteBuffer, ( xList * ) pxDelayedTaskList, tskBLOCKED_CHAR );
+				}
+
+				if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				{
+					prvListTaskWithinSingleList( pcWriteBuffer, ( xList * ) pxOverflowDelayedTaskList, tskBLOCKED_CHAR );
+				}
 			}
+			#endif
 
 			#if( INCLUDE_vTaskDelete == 1 )
 			{
@@ -1357,6 +1548,10 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void )
 				ulTotalRunTime = portGET_RUN_TIME_COUNTER_VALUE();
 			#endif
 
+			/* Only the time since vTaskClearRunTimeStats() was last called is
+			in the task counters. */
+			ulTotalRunTime -= ulRunTimeStatsStart;
+
 			/* Divide ulTotalRunTime by 100 to make the percentage caluclations
 			simpler in the prvGenerateRunTimeStatsForTasksInList() function. */
 			ulTotalRunTime /= 100UL;
@@ -1380,15 +1575,34 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void )
 				}
 			}while( uxQueue > ( unsigned short ) tskIDLE_PRIORITY );
 
-			if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+			#if ( configUSE_TIMER_WHEEL == 1 )
 			{
-				prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, ( xList * ) pxDelayedTaskList, ulTotalRunTime );
-			}
+			unsigned portBASE_TYPE uxLevel, uxSlot;
 
-			if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				for( uxLevel = 0U; uxLevel < listWHEEL_LEVELS; uxLevel++ )
+				{
+					for( uxSlot = 0U; uxSlot < listWHEEL_SLOTS; uxSlot++ )
+					{
+						if( listLIST_IS_EMPTY( &( xDelayedTaskWheel.xSlots[ uxLevel ][ uxSlot ] ) ) == pdFALSE )
+						{
+							prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, &( xDelayedTaskWheel.xSlots[ uxLevel ][ uxSlot ] ), ulTotalRunTime );
+						}
+					}
+				}
+			}
+			#else
 			{
-				prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, ( xList * ) pxOverflowDelayedTaskList, ulTotalRunTime );
+				if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+				{
+					prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, ( xList * ) pxDelayedTaskList, ulTotalRunTime );
+				}
+
+				if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				{
+					prvGenerateRunTimeStatsForTasksInList( pcWriteBuffer, ( xList * ) pxOverflowDelayedTaskList, ulTotalRunTime );
+				}
 			}
+			#endif
 
 			#if ( INCLUDE_vTaskDelete == 1 )
 			{
@@ -1410,6 +1624,114 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void )
 		}
 		xTaskResumeAll();
 	}
+	/*----------------------------------------------------------*/
+
+	/*
+	 * Zeroes the run time of every task and starts the total again from now,
+	 * so vTaskGetRunTimeStats() reports a window rather than all the time
+	 * since the scheduler started.  Clearing before the counter has wrapped
+	 * also keeps the percentages valid on a system that runs for days.
+	 */
+	void vTaskClearRunTimeStats( void )
+	{
+	unsigned portBASE_TYPE uxQueue;
+	unsigned long ulNow;
+
+		vTaskSuspendAll();
+		{
+			uxQueue = uxTopUsedPriority + ( unsigned portBASE_TYPE ) 1U;
+
+			do
+			{
+				uxQueue--;
+
+				if( listLIST_IS_EMPTY( &( pxReadyTasksLists[ uxQueue ] ) ) == pdFALSE )
+				{
+					prvClearRunTimeStatsForTasksInList( ( xList * ) &( pxReadyTasksLists[ uxQueue ] ) );
+				}
+			}while( uxQueue > ( unsigned short ) tskIDLE_PRIORITY );
+
+			#if ( configUSE_TIMER_WHEEL == 1 )
+			{
+			unsigned portBASE_TYPE uxLevel, uxSlot;
+
+				for( uxLevel = 0U; uxLevel < listWHEEL_LEVELS; uxLevel++ )
+				{
+					for( uxSlot = 0U; uxSlot < listWHEEL_SLOTS; uxSlot++ )
+					{
+						if( listLIST_IS_EMPTY( &( xDelayedTaskWheel.xSlots[ uxLevel ][ uxSlot ] ) ) == pdFALSE )
+						{
+							prvClearRunTimeStatsForTasksInList( &( xDelayedTaskWheel.xSlots[ uxLevel ][ uxSlot ] ) );
+						}
+					}
+				}
+			}
+			#else
+			{
+				if( listLIST_IS_EMPTY( pxDelayedTaskList ) == pdFALSE )
+				{
+					prvClearRunTimeStatsForTasksInList( ( xList * ) pxDelayedTaskList );
+				}
+
+				if( listLIST_IS_EMPTY( pxOverflowDelayedTaskList ) == pdFALSE )
+				{
+					prvClearRunTimeStatsForTasksInList( ( xList * ) pxOverflowDelayedTaskList );
+				}
+			}
+			#endif
+
+			if( listLIST_IS_EMPTY( &xPendingReadyList ) == pdFALSE )
+			{
+				prvClearRunTimeStatsForTasksInList( ( xList * ) &xPendingReadyList );
+			}
+
+			#if ( INCLUDE_vTaskDelete == 1 )
+			{
+				if( listLIST_IS_EMPTY( &xTasksWaitingTermination ) == pdFALSE )
+				{
+					prvClearRunTimeStatsForTasksInList( &xTasksWaitingTermination );
+				}
+			}
+			#endif
+
+			#if ( INCLUDE_vTaskSuspend == 1 )
+			{
+				if( listLIST_IS_EMPTY( &xSuspendedTaskList ) == pdFALSE )
+				{
+					prvClearRunTimeStatsForTasksInList( &xSuspendedTaskList );
+				}
+			}
+			#endif
+
+			/* The calling task's time up to now is dropped along with the
+			rest.  A tick interrupt could switch tasks between the two reads
+			if they were not in a critical section. */
+			portENTER_CRITICAL();
+			{
+				#ifdef portALT_GET_RUN_TIME_COUNTER_VALUE
+					portALT_GET_RUN_TIME_COUNTER_VALUE( ulNow );
+				#else
+					ulNow = portGET_RUN_TIME_COUNTER_VALUE();
+				#endif
+				ulTaskSwitchedInTime = ulNow;
+				ulRunTimeStatsStart = ulNow;
+			}
+			portEXIT_CRITICAL();
+		}
+		xTaskResumeAll();
+	}
+	/*----------------------------------------------------------*/
+
+	unsigned long ulTaskGetIdleRunTimeCounter( void )
+	{
+		/* The idle task's share of the window is the time the CPU had
+		nothing else to do, sleeping included. */
+		if( xIdleTaskHandle == NULL )
+		{
+			return 0UL;
+		}
+		return ( ( tskTCB * ) xIdleTaskHandle )->ulRunTimeCounter;
+	}
 
 #endif
 /*----------------------------------------------------------*/
@@ -1443,36 +1765,46 @@ tskTCB * pxTCB;
 		++xTickCount;
 		if( xTickCount == ( portTickType ) 0U )
 		{
+			#if ( configUSE_TIMER_WHEEL == 1 )
+			{
+				/* The wheel compares wake times modulo the tick count, so
+				there are no lists to swap. */
+				xNumOfOverflows++;
+			}
+			#else
+			{
 			xList *pxTemp;
 
-			/* Tick count has overflowed so we need to swap the delay lists.
-			If there are any items in pxDelayedTaskList here then there is
-			an error! */
-			configASSERT( ( listLIST_IS_EMPTY( pxDelayedTaskList ) ) );
+				/* Tick count has overflowed so we need to swap the delay lists.
+				If there are any items in pxDelayedTaskList here then there is
+				an error! */
+				configASSERT( ( listLIST_IS_EMPTY( pxDelayedTaskList ) ) );
 			
-			pxTemp = pxDelayedTaskList;
-			pxDelayedTaskList = pxOverflowDelayedTaskList;
-			pxOverflowDelayedTaskList = pxTemp;
-			xNumOfOverflows++;
+				pxTemp = pxDelayedTaskList;
+				pxDelayedTaskList = pxOverflowDelayedTaskList;
+				pxOverflowDelayedTaskList = pxTemp;
+				xNumOfOverflows++;
 	
-			if( listLIST_IS_EMPTY( pxDelayedTaskList ) != pdFALSE )
-			{
-				/* The new current delayed list is empty.  Set
-				xNextTaskUnblockTime to the maximum possible value so it is
-				extremely unlikely that the	
-				if( xTickCount >= xNextTaskUnblockTime ) test will pass until
-				there is an item in the delayed list. */
-				xNextTaskUnblockTime = portMAX_DELAY;
-			}
-			else
-			{
-				/* The new current delayed list is not empty, get the value of
-				the item at the head of the delayed list.  This is the time at
-				which the task at the head of the delayed list should be removed
-				from the Blocked state. */
-				pxTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY( pxDelayedTaskList );
-				xNextTaskUnblockTime = listGET_LIST_ITEM_VALUE( &( pxTCB->xGenericListItem ) );
+				if( listLIST_IS_EMPTY( pxDelayedTaskList ) != pdFALSE )
+				{
+					/* The new current delayed list is empty.  Set
+					xNextTaskUnblockTime to the maximum possible value so it is
+					extremely unlikely that the	
+					if( xTickCount >= xNextTaskUnblockTime ) test will pass until
+					there is an item in the delayed list. */
+					xNextTaskUnblockTime = portMAX_DELAY;
+				}
+				else
+				{
+					/* The new current delayed list is not empty, get the value of
+					the item at the head of the delayed list.  This is the time at
+					which the task at the head of the delayed list should be removed
+					from the Blocked state. */
+					pxTCB = ( tskTCB * ) listGET_OWNER_OF_HEAD_ENTRY( pxDelayedTaskList );
+					xNextTaskUnblockTime = listGET_LIST_ITEM_VALUE( &( pxTCB->xGenericListItem ) );
+				}
 			}
+			#endif
 		}
 
 		/* See if this tick has made a timeout expire. */
@@ -1506,6 +1838,68 @@ tskTCB * pxTCB;
 }
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_TICKLESS_IDLE == 1 )
+
+	void vTaskStepTick( portTickType xTicksToJump )
+	{
+	portTickType xDirect;
+
+		/* Called by the port after sleeping through xTicksToJump tick periods,
+		with interrupts disabled and the scheduler suspended.  Ticks that
+		stop short of the next unblock time cannot wake anything, so they are
+		added to the tick count directly.  The rest are left as missed ticks
+		for xTaskResumeAll() to pass through vTaskIncrementTick(), which wakes
+		the tasks that are due and handles a tick count overflow. */
+		xDirect = xNextTaskUnblockTime - xTickCount;
+		if( xDirect > ( portTickType ) 0U )
+		{
+			--xDirect;
+		}
+
+		if( xDirect > xTicksToJump )
+		{
+			xDirect = xTicksToJump;
+		}
+
+		xTickCount += xDirect;
+		#if ( configUSE_TIMER_WHEEL == 1 )
+		{
+			/* Nothing is in the slots passed over. */
+			listWHEEL_SKIP( &xDelayedTaskWheel, xDirect );
+		}
+		#endif
+		uxMissedTicks += ( unsigned portBASE_TYPE ) ( xTicksToJump - xDirect );
+	}
+
+#endif /* configUSE_TICKLESS_IDLE */
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TICKLESS_IDLE == 1 )
+
+	portBASE_TYPE xTaskConfirmSleepModeStatus( void )
+	{
+	portBASE_TYPE xReturn = pdTRUE;
+
+		/* Called by the port with interrupts disabled, just before it sleeps.
+		An interrupt since the idle time was sampled may have readied a task,
+		which waits in xPendingReadyList while the scheduler is suspended,
+		asked for a yield, or been a tick that has not been counted yet.  Any
+		of these means the idle time is stale and the port must not sleep. */
+		if( listCURRENT_LIST_LENGTH( &xPendingReadyList ) != ( unsigned portBASE_TYPE ) 0U )
+		{
+			xReturn = pdFALSE;
+		}
+		else if( ( xMissedYield != pdFALSE ) || ( uxMissedTicks != ( unsigned portBASE_TYPE ) 0U ) )
+		{
+			xReturn = pdFALSE;
+		}
+
+		return xReturn;
+	}
+
+#endif /* configUSE_TICKLESS_IDLE */
+/*-----------------------------------------------------------*/
+
 #if ( configUSE_APPLICATION_TASK_TAG == 1 )
 
 	void vTaskSetApplicationTaskTag( xTaskHandle xTask, pdTASK_HOOK_CODE pxHookFunction )
@@ -1628,16 +2022,7 @@ void vTaskSwitchContext( void )
 		taskFIRST_CHECK_FOR_STACK_OVERFLOW();
 		taskSECOND_CHECK_FOR_STACK_OVERFLOW();
 	
-		/* Find the highest priority queue that contains ready tasks. */
-		while( listLIST_IS_EMPTY( &( pxReadyTasksLists[ uxTopReadyPriority ] ) ) )
-		{
-			configASSERT( uxTopReadyPriority );
-			--uxTopReadyPriority;
-		}
-	
-		/* listGET_OWNER_OF_NEXT_ENTRY walks through the list, so the tasks of the
-		same priority get an equal share of the processor time. */
-		listGET_OWNER_OF_NEXT_ENTRY( pxCurrentTCB, &( pxReadyTasksLists[ uxTopReadyPriority ] ) );
+		taskSELECT_HIGHEST_PRIORITY_TASK();
 	
 		traceTASK_SWITCHED_IN();
 	}
@@ -1662,6 +2047,7 @@ portTickType xTimeToWake;
 	to the blocked list as the same list item is used for both lists.  We have
 	exclusive access to the ready lists as the scheduler is locked. */
 	vListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+	taskRESET_READY_PRIORITY( pxCurrentTCB->uxPriority );
 
 
 	#if ( INCLUDE_vTaskSuspend == 1 )
@@ -1716,6 +2102,7 @@ portTickType xTimeToWake;
 		blocked list as the same list item is used for both lists.  This
 		function is called form a critical section. */
 		vListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+		taskRESET_READY_PRIORITY( pxCurrentTCB->uxPriority );
 
 		/* Calculate the time at which the task should be woken if the event does
 		not occur.  This may overflow but this doesn't matter. */
@@ -1930,7 +2317,34 @@ static portTASK_FUNCTION( prvIdleTask, pvParameters )
 			without the overhead of a separate task.
 			NOTE: vApplicationIdleHook() MUST NOT, UNDER ANY CIRCUMSTANCES,
 			CALL A FUNCTION THAT MIGHT BLOCK. */
-			//vApplicationIdleHookvApplicationIdleHook();
+			vApplicationIdleHook();
+		}
+		#endif
+
+		#if ( configUSE_TICKLESS_IDLE == 1 )
+		{
+		portTickType xExpectedIdleTime;
+
+			/* The first look is taken with the scheduler running so the idle
+			task does not suspend it on every pass through the loop. */
+			xExpectedIdleTime = prvGetExpectedIdleTime();
+
+			if( xExpectedIdleTime >= configEXPECTED_IDLE_TIME_BEFORE_SLEEP )
+			{
+				vTaskSuspendAll();
+				{
+					/* Now the scheduler is suspended the expected idle time
+					can be sampled again, and this time its value can be
+					used. */
+					xExpectedIdleTime = prvGetExpectedIdleTime();
+
+					if( xExpectedIdleTime >= configEXPECTED_IDLE_TIME_BEFORE_SLEEP )
+					{
+						portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime );
+					}
+				}
+				xTaskResumeAll();
+			}
 		}
 		#endif
 	}
@@ -2043,8 +2457,16 @@ unsigned portBASE_TYPE uxPriority;
 		vListInitialise( ( xList * ) &( pxReadyTasksLists[ uxPriority ] ) );
 	}
 
-	vListInitialise( ( xList * ) &xDelayedTaskList1 );
-	vListInitialise( ( xList * ) &xDelayedTaskList2 );
+	#if ( configUSE_TIMER_WHEEL == 1 )
+	{
+		vListWheelInitialise( &xDelayedTaskWheel, xTickCount );
+	}
+	#else
+	{
+		vListInitialise( ( xList * ) &xDelayedTaskList1 );
+		vListInitialise( ( xList * ) &xDelayedTaskList2 );
+	}
+	#endif
 	vListInitialise( ( xList * ) &xPendingReadyList );
 
 	#if ( INCLUDE_vTaskDelete == 1 )
@@ -2059,10 +2481,14 @@ unsigned portBASE_TYPE uxPriority;
 	}
 	#endif
 
-	/* Start with pxDelayedTaskList using list1 and the pxOverflowDelayedTaskList
-	using list2. */
-	pxDelayedTaskList = &xDelayedTaskList1;
-	pxOverflowDelayedTaskList = &xDelayedTaskList2;
+	#if ( configUSE_TIMER_WHEEL == 0 )
+	{
+		/* Start with pxDelayedTaskList using list1 and the pxOverflowDelayedTaskList
+		using list2. */
+		pxDelayedTaskList = &xDelayedTaskList1;
+		pxOverflowDelayedTaskList = &xDelayedTaskList2;
+	}
+	#endif
 }
 /*-----------------------------------------------------------*/
 
@@ -2106,27 +2532,85 @@ static void prvAddCurrentTaskToDelayedList( portTickType xTimeToWake )
 	/* The list item will be inserted in wake time order. */
 	listSET_LIST_ITEM_VALUE( &( pxCurrentTCB->xGenericListItem ), xTimeToWake );
 
-	if( xTimeToWake < xTickCount )
+	#if ( configUSE_TIMER_WHEEL == 1 )
 	{
-		/* Wake time has overflowed.  Place this item in the overflow list. */
-		vListInsert( ( xList * ) pxOverflowDelayedTaskList, ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+	portTickType xTicksToEvent;
+
+		/* The wheel says when it will next look at the task; if that is
+		before anything else it has to do then xNextTaskUnblockTime needs to
+		be brought forward. */
+		xTicksToEvent = xListWheelInsert( &xDelayedTaskWheel, ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+		if( xTicksToEvent < ( portTickType ) ( xNextTaskUnblockTime - xTickCount ) )
+		{
+			xNextTaskUnblockTime = xTickCount + xTicksToEvent;
+		}
 	}
-	else
+	#else
 	{
-		/* The wake time has not overflowed, so we can use the current block list. */
-		vListInsert( ( xList * ) pxDelayedTaskList, ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
-
-		/* If the task entering the blocked state was placed at the head of the
-		list of blocked tasks then xNextTaskUnblockTime needs to be updated
-		too. */
-		if( xTimeToWake < xNextTaskUnblockTime )
+		if( xTimeToWake < xTickCount )
+		{
+			/* Wake time has overflowed.  Place this item in the overflow list. */
+			vListInsert( ( xList * ) pxOverflowDelayedTaskList, ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+		}
+		else
 		{
-			xNextTaskUnblockTime = xTimeToWake;
+			/* The wake time has not overflowed, so we can use the current block list. */
+			vListInsert( ( xList * ) pxDelayedTaskList, ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+
+			/* If the task entering the blocked state was placed at the head of the
+			list of blocked tasks then xNextTaskUnblockTime needs to be updated
+			too. */
+			if( xTimeToWake < xNextTaskUnblockTime )
+			{
+				xNextTaskUnblockTime = xTimeToWake;
+			}
 		}
 	}
+	#endif
 }
 /*-----------------------------------------------------------*/
 
+#if ( configUSE_TICKLESS_IDLE == 1 )
+
+	static portTickType prvGetExpectedIdleTime( void )
+	{
+	portTickType xReturn;
+
+		if( pxCurrentTCB->uxPriority > tskIDLE_PRIORITY )
+		{
+			xReturn = 0;
+		}
+		else if( listCURRENT_LIST_LENGTH( &( pxReadyTasksLists[ tskIDLE_PRIORITY ] ) ) > ( unsigned portBASE_TYPE ) 1 )
+		{
+			/* Another task shares the idle priority and is ready. */
+			xReturn = 0;
+		}
+		else
+		{
+			xReturn = xNextTaskUnblockTime - xTickCount;
+		}
+
+		#if ( configUSE_CO_ROUTINES == 1 )
+		{
+		extern portTickType xCoRoutineGetExpectedIdleTime( void );
+		portTickType xCoRoutineIdleTime;
+
+			/* Co-routines run from the idle hook, so their delays are not in
+			xNextTaskUnblockTime. */
+			xCoRoutineIdleTime = xCoRoutineGetExpectedIdleTime();
+			if( xCoRoutineIdleTime < xReturn )
+			{
+				xReturn = xCoRoutineIdleTime;
+			}
+		}
+		#endif
+
+		return xReturn;
+	}
+
+#endif /* configUSE_TICKLESS_IDLE */
+/*-----------------------------------------------------------*/
+
 static tskTCB *prvAllocateTCBAndStack( unsigned short usStackDepth, portSTACK_TYPE *puxStackBuffer )
 {
 tskTCB *pxNewTCB;
@@ -2258,6 +2742,19 @@ tskTCB *pxNewTCB;
 
 		} while( pxNextTCB != pxFirstTCB );
 	}
+	/*-----------------------------------------------------------*/
+
+	static void prvClearRunTimeStatsForTasksInList( xList *pxList )
+	{
+	volatile tskTCB *pxNextTCB, *pxFirstTCB;
+
+		listGET_OWNER_OF_NEXT_ENTRY( pxFirstTCB, pxList );
+		do
+		{
+			listGET_OWNER_OF_NEXT_ENTRY( pxNextTCB, pxList );
+			pxNextTCB->ulRunTimeCounter = 0UL;
+		} while( pxNextTCB != pxFirstTCB );
+	}
 
 #endif
 /*-----------------------------------------------------------*/
@@ -2394,6 +2891,7 @@ tskTCB *pxNewTCB;
 			if( listIS_CONTAINED_WITHIN( &( pxReadyTasksLists[ pxTCB->uxPriority ] ), &( pxTCB->xGenericListItem ) ) != pdFALSE )
 			{
 				vListRemove( &( pxTCB->xGenericListItem ) );
+				taskRESET_READY_PRIORITY( pxTCB->uxPriority );
 
 				/* Inherit the priority before being moved into the new list. */
 				pxTCB->uxPriority = pxCurrentTCB->uxPriority;
@@ -2425,6 +2923,7 @@ tskTCB *pxNewTCB;
 				/* We must be the running task to be able to give the mutex back.
 				Remove ourselves from the ready list we currently appear in. */
 				vListRemove( &( pxTCB->xGenericListItem ) );
+				taskRESET_READY_PRIORITY( pxTCB->uxPriority );
 
 				/* Disinherit the priority before adding the task into the new
 				ready list. */
@@ -0,0 +1,140 @@
+// The DS3231's temperature, read now and then and kept (clock side).
+// Include after i2cbus.h, and before console.h.
+//
+// The DS3231 measures its own temperature every 64 s, to a quarter of a
+// degree: whole degrees in 0x11 and quarters in 0x12. Temp_Poll, run from
+// DT_Display, reads both in one transaction once every TEMP_REFRESH and
+// keeps the result in tempQuarters. The LCD shows it on every redraw and
+// the console sends it for CONSOLE_TEMP, and neither costs an I2C
+// transaction. Built with TEMP_CONVERT 1 it first sets CONV, so the chip
+// converts there and then, and it reads the result on a later poll, at
+// least TEMP_CONVERT_MS on.
+
+#ifndef TEMPERATURE_H
+#define TEMPERATURE_H
+
+#ifndef TEMP_REFRESH
+#define TEMP_REFRESH 64000UL // ms between reads, the chip's own conversion period
+#endif
+#ifndef TEMP_CONVERT
+#define TEMP_CONVERT 0 // 1 starts a conversion for each read
+#endif
+#ifndef TEMP_CONSOLE
+#define TEMP_CONSOLE 1 // 1 sends the temperature for CONSOLE_TEMP on USART1
+#endif
+#define TEMP_CONVERT_MS 200 // longest a conversion takes
+#define TEMP_NONE 0x7FFF // tempQuarters before the first read
+#define TEMP_TEXT 7 // "-12.25" or "23.25C" and the 0
+
+static struct I2CClient i2cTemp;
+volatile int16_t tempQuarters = TEMP_NONE; // quarters of a degree C
+unsigned int tempReads; // reads since boot
+static unsigned long tempElapsed = TEMP_REFRESH; // ms since the last read, so the first poll reads
+static portTickType tempLast;
+static unsigned char tempConverting;
+
+void Temp_Poll() {
+
+	portTickType now = xTaskGetTickCount();
+	int16_t quarters;
+	tempElapsed += (portTickType)(now - tempLast) * portTICK_RATE_MS;
+	tempLast = now;
+#if TEMP_CONVERT
+	if(!tempConverting) {
+		if(tempElapsed < TEMP_REFRESH || !I2CBus_Acquire(&i2cTemp)) {
+			return;
+		}
+		ds3231_convert();
+		I2CBus_Release(&i2cTemp);
+		tempConverting = 1;
+		tempElapsed = 0; // The period runs from the conversion
+		return;
+	}
+	if(tempElapsed < TEMP_CONVERT_MS) {
+		return;
+	}
+#else
+	if(tempElapsed < TEMP_REFRESH) {
+		return;
+	}
+#endif
+	if(!I2CBus_Acquire(&i2cTemp)) {
+		return; // Tried again on the next poll
+	}
+	ds3231_getT(&quarters);
+	I2CBus_Release(&i2cTemp);
+	taskENTER_CRITICAL(); // Two bytes, read from other tasks
+	tempQuarters = quarters;
+	taskEXIT_CRITICAL();
+	tempReads++;
+	tempConverting = 0;
+#if !TEMP_CONVERT
+	tempElapsed = 0;
+#endif
+}
+
+int16_t Temp_Get() {
+
+	int16_t quarters;
+	taskENTER_CRITICAL();
+	quarters = tempQuarters;
+	taskEXIT_CRITICAL();
+	return quarters;
+}
+
+// Writes quarters as degrees C, right aligned in TEMP_TEXT - 1 characters.
+// Below -9.75 the C makes room for the sign.
+void Temp_Format(int16_t quarters, char *text) {
+
+	unsigned int q = (quarters < 0) ? -quarters : quarters;
+	unsigned int whole = q / 4, hundredths = (q % 4) * 25;
+	char digits[TEMP_TEXT + 2];
+	unsigned char n = 0, k;
+	if(quarters < 0) {
+		digits[n++] = '-';
+	}
+	if(whole >= 100) {
+		digits[n++] = whole / 100 + '0';
+	}
+	if(whole >= 10) {
+		digits[n++] = whole / 10 % 10 + '0';
+	}
+	digits[n++] = whole % 10 + '0';
+	digits[n++] = '.';
+	digits[n++] = hundredths / 10 + '0';
+	digits[n++] = hundredths % 10 + '0';
+	if(n < TEMP_TEXT - 1) {
+		digits[n++] = 'C';
+	}
+	for(k = 0; k < TEMP_TEXT - 1; k++) {
+		text[k] = (k + n < TEMP_TEXT - 1) ? ' ' : digits[k + n - (TEMP_TEXT - 1)];
+	}
+	text[TEMP_TEXT - 1] = 0;
+}
+
+#if TEMP_CONSOLE
+// Sends the temperature as one line, "--" before the first read
+unsigned char Temp_Send() {
+
+	char text[TEMP_TEXT];
+	int16_t quarters = Temp_Get();
+	unsigned char k;
+	if(quarters == TEMP_NONE) {
+		USART_Send('-', 1);
+		USART_Send('-', 1);
+	}
+	else {
+		Temp_Format(quarters, text);
+		for(k = 0; text[k]; k++) {
+			if(text[k] != ' ') {
+				USART_Send(text[k], 1);
+			}
+		}
+	}
+	USART_Send('\r', 1);
+	USART_Send('\n', 1);
+	return 1;
+}
+#endif
+
+#endif // TEMPERATURE_H
@@ -0,0 +1,177 @@
+// Kernel trace recorder (clock side). The hooks that feed it are in
+// tracehooks.h. Include after the FreeRTOS headers.
+//
+// Each hook stores a 6 byte record in a RAM ring: type, argument, tick
+// count, and how far timer 1 (the kernel tick, port.c) has counted into
+// that tick, 8us a count. When the ring is full the oldest record goes, so
+// it always holds the last TRACE_RECORDS events. The console (console.h)
+// sends the ring out of USART1 in binary on a 't' and starts a new one;
+// Host/tracedump turns a capture into a Chrome trace. Nothing is recorded
+// while a dump is going out.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#if configUSE_TRACE_RECORDER == 1
+
+#define TRACE_RECORDS 128 // 768 bytes
+#define TRACE_OBJECTS 16 // tasks and queues that get a number
+#define TRACE_NAME 8 // characters of a name that are kept
+#define TRACE_CHUNK 32 // bytes sent per Trace_Send
+#define TRACE_TICK_COUNTS 125 // timer 1 counts per tick, as in port.c
+#define TRACE_COUNT_US 8
+#define TRACE_MASK ~(1U << TR_TICK) // The tick alone would fill the ring in 0.13 s
+
+struct TraceRecord {
+	uint8_t type; // enum TraceType
+	uint8_t arg;
+	uint16_t tick;
+	uint16_t count; // timer 1; past TRACE_TICK_COUNTS while the tick is suppressed
+};
+
+/* Sent ahead of the names and the records, little endian as the AVR
+   stores it */
+struct TraceHeader {
+	char magic[4]; // "TRC1"
+	uint8_t tickCounts;
+	uint8_t countUs;
+	uint8_t objects; // TRACE_NAME bytes of name each, object 1 first
+	uint8_t recordSize;
+	uint16_t records; // oldest first
+	uint16_t lost; // overwritten since the last dump
+};
+
+struct TraceObject {
+	const void *object;
+	char name[TRACE_NAME]; // Not terminated when it is full
+};
+
+static struct TraceRecord traceRing[TRACE_RECORDS];
+static unsigned char traceHead; // next record written
+static unsigned char traceCount;
+static unsigned int traceLost;
+static volatile unsigned char traceFrozen;
+static unsigned char traceLastTask;
+static struct TraceObject traceObjects[TRACE_OBJECTS];
+static unsigned char traceObjectCount;
+static struct TraceHeader traceHeader;
+static unsigned int traceSent; // bytes of the dump sent so far
+
+void vTraceRecord(unsigned char type, unsigned char arg) {
+
+	struct TraceRecord *r;
+	if(traceFrozen || !(TRACE_MASK & (1U << type))) {
+		return;
+	}
+	portENTER_CRITICAL(); // Hooks run from tasks and interrupts alike
+	r = &traceRing[traceHead];
+	r->type = type;
+	r->arg = arg;
+	r->count = TCNT1;
+	r->tick = (uint16_t)xTaskGetTickCountFromISR();
+	if((TIFR1 & (1 << OCF1A)) && r->count < TRACE_TICK_COUNTS / 2) {
+		r->tick++; // The counter has started the next tick, the kernel has not
+	}
+	traceHead = (traceHead + 1) % TRACE_RECORDS;
+	if(traceCount < TRACE_RECORDS) {
+		traceCount++;
+	}
+	else {
+		traceLost++;
+	}
+	portEXIT_CRITICAL();
+}
+
+// Number of a task or queue, 1 up, given out the first time it is seen.
+// A name replaces the one it has. 0 once the table is full.
+unsigned char ucTraceObject(const void *object, const char *name) {
+
+	unsigned char n;
+	for(n = 0; n < traceObjectCount; n++) {
+		if(traceObjects[n].object == object) {
+			break;
+		}
+	}
+	if(n == traceObjectCount) {
+		portENTER_CRITICAL();
+		n = traceObjectCount;
+		if(n == TRACE_OBJECTS) {
+			portEXIT_CRITICAL();
+			return 0;
+		}
+		traceObjects[n].object = object;
+		traceObjects[n].name[0] = '\0';
+		traceObjectCount++;
+		portEXIT_CRITICAL();
+	}
+	if(name) {
+		strncpy(traceObjects[n].name, name, TRACE_NAME);
+	}
+	return n + 1;
+}
+
+// The kernel picks a task on every tick; only a change is recorded
+void vTraceSwitch(const void *task) {
+
+	unsigned char id = ucTraceObject(task, 0);
+	if(id != traceLastTask) {
+		traceLastTask = id;
+		vTraceRecord(TR_SWITCH, id);
+	}
+}
+
+// Freezes the ring and starts the dump
+void Trace_Request() {
+
+	traceFrozen = 1;
+	memcpy(traceHeader.magic, "TRC1", 4);
+	traceHeader.tickCounts = TRACE_TICK_COUNTS;
+	traceHeader.countUs = TRACE_COUNT_US;
+	traceHeader.objects = traceObjectCount;
+	traceHeader.recordSize = sizeof(struct TraceRecord);
+	traceHeader.records = traceCount;
+	traceHeader.lost = traceLost;
+	traceSent = 0;
+}
+
+// Byte at of the dump: header, names, then the records oldest first
+static unsigned char Trace_Byte(unsigned int at) {
+
+	unsigned int names = sizeof(traceHeader) + traceHeader.objects * TRACE_NAME;
+	unsigned char first = (traceHead + TRACE_RECORDS - traceCount) % TRACE_RECORDS;
+	unsigned char n;
+	if(at < sizeof(traceHeader)) {
+		return ((const unsigned char *)&traceHeader)[at];
+	}
+	if(at < names) {
+		at -= sizeof(traceHeader);
+		return traceObjects[at / TRACE_NAME].name[at % TRACE_NAME];
+	}
+	at -= names;
+	n = (first + at / sizeof(struct TraceRecord)) % TRACE_RECORDS;
+	return ((const unsigned char *)&traceRing[n])[at % sizeof(struct TraceRecord)];
+}
+
+// Sends the next TRACE_CHUNK bytes. Returns 1 once the dump is out and a
+// new ring has started.
+unsigned char Trace_Send() {
+
+	unsigned int size = sizeof(traceHeader) + traceHeader.objects * TRACE_NAME +
+		traceHeader.records * sizeof(struct TraceRecord);
+	unsigned char n;
+	for(n = 0; n < TRACE_CHUNK && traceSent < size; n++) {
+		USART_Send(Trace_Byte(traceSent++), 1);
+	}
+	if(traceSent < size) {
+		return 0;
+	}
+	traceCount = 0;
+	traceLost = 0;
+	traceLastTask = 0; // So the next switch is recorded whoever it is
+	traceFrozen = 0;
+	return 1;
+}
+
+#endif // configUSE_TRACE_RECORDER
+
+#endif // TRACE_H